@@ -0,0 +1,61 @@
+#!/usr/bin/env python3
+"""
+Generate multigeiger/dashboard.h from the web dashboard (misc/dashboard/index.html).
+
+The dashboard is stored gzip compressed in the firmware and served as is (with
+"Content-Encoding: gzip"), so the MultiGeiger does not spend CPU time on it. Its ETag is
+a hash of the compressed data, so browsers can revalidate their cached copy cheaply
+(304 Not Modified) and pick up a changed dashboard after a firmware update.
+
+Run this after changing the dashboard and commit the generated header, too:
+
+    python3 misc/build_dashboard.py
+"""
+
+import argparse
+import gzip
+import hashlib
+import os
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+
+
+def build(html):
+    """return the gzip compressed html (reproducible: no file name / time in the header)"""
+    return gzip.compress(html, compresslevel=9, mtime=0)
+
+
+def render_header(data, source):
+    etag = hashlib.sha1(data).hexdigest()[:16]
+    lines = [
+        '// web dashboard, gzip compressed - generated by misc/build_dashboard.py from %s, do not edit!' % source,
+        '',
+        '#ifndef _DASHBOARD_H_',
+        '#define _DASHBOARD_H_',
+        '',
+        '#define DASHBOARD_ETAG "\\"%s\\""' % etag,
+        '',
+        'static const uint8_t dashboard_html_gz[] PROGMEM = {',
+    ]
+    for i in range(0, len(data), 16):
+        lines.append('  ' + ' '.join('0x%02x,' % b for b in data[i:i + 16]))
+    lines += ['};', '', '#endif // _DASHBOARD_H_', '']
+    return '\n'.join(lines)
+
+
+def main():
+    parser = argparse.ArgumentParser(description='generate the compressed web dashboard header')
+    parser.add_argument('--input', default=os.path.join(HERE, 'dashboard', 'index.html'), help='dashboard html file')
+    parser.add_argument('--output', default=os.path.normpath(os.path.join(HERE, '..', 'multigeiger', 'dashboard.h')), help='generated header')
+    args = parser.parse_args()
+
+    with open(args.input, 'rb') as f:
+        html = f.read()
+    data = build(html)
+    with open(args.output, 'w') as f:
+        f.write(render_header(data, 'misc/dashboard/' + os.path.basename(args.input)))
+    print('%s: %d bytes, %d bytes compressed' % (args.output, len(html), len(data)))
+
+
+if __name__ == '__main__':
+    main()
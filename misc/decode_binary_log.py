@@ -0,0 +1,220 @@
+#!/usr/bin/env python3
+"""
+Decode the binary serial output of a MultiGeiger (SERIAL_DEBUG Serial_Binary_Log).
+
+Every record is a frame [type u8][seq u8][payload][crc16 u16], COBS encoded and terminated
+by a 0 byte. The CRC is CRC-16/CCITT-FALSE over type, seq and payload. All values are
+little endian. Record types:
+
+    0 info:     u8 format version, u8 tube nbr, char[] firmware version
+    1 interval: u32 uptime [ms], u32 dt [ms], u32 counts, u32 hv pulses, u8 flags (bit 0: hv error)
+    2 pulses:   u16 dropped pulses, u32[] pulse timestamps [us] (micros(), wraps around)
+    3 thp:      u32 uptime [ms], f32 temperature [C], f32 humidity [%], f32 pressure [Pa]
+    4 time:     u32 uptime [ms], u64 UTC [us] since epoch (every minute, if the clock is set)
+
+Corrupted frames (e.g. the boot messages of the ESP32) are skipped, lost frames are
+detected via the sequence number. Each row also gets the host time it was received at.
+
+Input is a serial device (needs pyserial) or a file (e.g. recorded with
+"cat /dev/ttyUSB0 > data.bin"). Output goes to PREFIX_intervals, PREFIX_pulses,
+PREFIX_thp and PREFIX_time as CSV (default) or Parquet (needs pyarrow).
+
+Example:
+
+    python3 decode_binary_log.py /dev/ttyUSB0 --prefix run1 --format parquet
+"""
+
+import argparse
+import csv
+import os
+import stat
+import struct
+import sys
+import time
+
+FORMAT_VERSION = 1
+REC_INFO, REC_INTERVAL, REC_PULSES, REC_THP, REC_TIME = range(5)
+
+COLUMNS = {
+    'intervals': ['host_time', 'uptime_ms', 'dt_ms', 'counts', 'hv_pulses', 'hv_error'],
+    'pulses': ['host_time', 'timestamp_us', 'dropped_before'],
+    'thp': ['host_time', 'uptime_ms', 'temperature', 'humidity', 'pressure'],
+    'time': ['host_time', 'uptime_ms', 'utc_us'],
+}
+
+
+def crc16(data):
+    crc = 0xFFFF
+    for byte in data:
+        crc ^= byte << 8
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x1021) if crc & 0x8000 else crc << 1
+            crc &= 0xFFFF
+    return crc
+
+
+def cobs_decode(data):
+    """decode a COBS encoded frame (without the 0 delimiter), return None if invalid"""
+    out = bytearray()
+    i = 0
+    while i < len(data):
+        code = data[i]
+        if code == 0 or i + code > len(data) + 1:
+            return None
+        out += data[i + 1:i + code]
+        i += code
+        if code < 0xFF and i < len(data):
+            out.append(0)
+    return bytes(out)
+
+
+def parse_frame(frame):
+    """return (type, seq, payload) or None if the frame is corrupted"""
+    data = cobs_decode(frame)
+    if data is None or len(data) < 4:
+        return None
+    body, crc = data[:-2], struct.unpack('<H', data[-2:])[0]
+    if crc16(body) != crc:
+        return None
+    return body[0], body[1], body[2:]
+
+
+class CsvWriter:
+    def __init__(self, prefix, name):
+        self.file = open('%s_%s.csv' % (prefix, name), 'w', newline='')
+        self.writer = csv.writer(self.file)
+        self.writer.writerow(COLUMNS[name])
+
+    def write(self, row):
+        self.writer.writerow(row)
+
+    def flush(self):
+        self.file.flush()
+
+    def close(self):
+        self.file.close()
+
+
+class ParquetWriter:
+    BATCH = 10000
+
+    def __init__(self, prefix, name):
+        import pyarrow as pa
+        import pyarrow.parquet as pq
+        self.pa = pa
+        self.columns = COLUMNS[name]
+        self.rows = []
+        self.writer = None
+        self.open = lambda schema: pq.ParquetWriter('%s_%s.parquet' % (prefix, name), schema)
+
+    def write(self, row):
+        self.rows.append(row)
+        if len(self.rows) >= self.BATCH:
+            self.flush()
+
+    def flush(self):
+        if not self.rows:
+            return
+        table = self.pa.Table.from_pydict({c: [r[i] for r in self.rows] for i, c in enumerate(self.columns)})
+        if self.writer is None:
+            self.writer = self.open(table.schema)
+        self.writer.write_table(table)
+        self.rows = []
+
+    def close(self):
+        self.flush()
+        if self.writer is not None:
+            self.writer.close()
+
+
+class Decoder:
+    def __init__(self, writers):
+        self.writers = writers
+        self.last_seq = None
+        self.frames = self.corrupted = self.lost = 0
+
+    def feed(self, frame, host_time):
+        record = parse_frame(frame)
+        if record is None:
+            self.corrupted += 1
+            return
+        rtype, seq, payload = record
+        self.frames += 1
+        if self.last_seq is not None and seq != (self.last_seq + 1) & 0xFF:
+            self.lost += (seq - self.last_seq - 1) & 0xFF
+        self.last_seq = seq
+        try:
+            self.record(rtype, payload, host_time)
+        except (struct.error, IndexError):
+            self.corrupted += 1
+
+    def record(self, rtype, payload, host_time):
+        if rtype == REC_INFO:
+            version, tube = payload[0], payload[1]
+            firmware = payload[2:].decode('ascii', 'replace')
+            if version != FORMAT_VERSION:
+                print('warning: unknown format version %d' % version, file=sys.stderr)
+            print('MultiGeiger %s, tube nbr %d' % (firmware, tube), file=sys.stderr)
+            self.last_seq = None  # device rebooted
+        elif rtype == REC_INTERVAL:
+            uptime, dt, counts, hv_pulses, flags = struct.unpack('<IIIIB', payload)
+            self.writers['intervals'].write([host_time, uptime, dt, counts, hv_pulses, bool(flags & 1)])
+        elif rtype == REC_PULSES:
+            dropped = struct.unpack('<H', payload[:2])[0]
+            for timestamp, in struct.iter_unpack('<I', payload[2:]):
+                self.writers['pulses'].write([host_time, timestamp, dropped])
+                dropped = 0
+        elif rtype == REC_THP:
+            uptime, t, h, p = struct.unpack('<Ifff', payload)
+            self.writers['thp'].write([host_time, uptime, t, h, p])
+        elif rtype == REC_TIME:
+            uptime, utc_us = struct.unpack('<IQ', payload)
+            self.writers['time'].write([host_time, uptime, utc_us])
+
+
+def open_input(path, baudrate):
+    if stat.S_ISCHR(os.stat(path).st_mode):
+        import serial
+        return serial.Serial(path, baudrate, timeout=1)
+    return open(path, 'rb')
+
+
+def main():
+    parser = argparse.ArgumentParser(description='decode MultiGeiger binary serial data')
+    parser.add_argument('input', help='serial device (e.g. /dev/ttyUSB0) or recorded file')
+    parser.add_argument('--baudrate', type=int, default=115200, help='serial baudrate')
+    parser.add_argument('--prefix', default='multigeiger', help='prefix of the output file names')
+    parser.add_argument('--format', choices=['csv', 'parquet'], default='csv', help='output file format')
+    args = parser.parse_args()
+
+    writer = CsvWriter if args.format == 'csv' else ParquetWriter
+    writers = {name: writer(args.prefix, name) for name in COLUMNS}
+    decoder = Decoder(writers)
+    source = open_input(args.input, args.baudrate)
+    buffer = bytearray()
+    try:
+        while True:
+            data = source.read(4096)
+            if not data:
+                if not hasattr(source, 'in_waiting'):
+                    break  # end of file
+                for w in writers.values():
+                    w.flush()
+                continue
+            buffer += data
+            host_time = time.time()
+            *frames, buffer = buffer.split(b'\0')
+            for frame in frames:
+                if frame:
+                    decoder.feed(frame, host_time)
+            buffer = bytearray(buffer)
+    except KeyboardInterrupt:
+        pass
+    finally:
+        for w in writers.values():
+            w.close()
+    print('%d records, %d corrupted, %d lost' % (decoder.frames, decoder.corrupted, decoder.lost), file=sys.stderr)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,69 @@
+#!/usr/bin/env python3
+"""
+Estimate the battery life of a MultiGeiger in low power mode (see LOW_POWER_MODE).
+
+In low power mode, the ESP32 light-sleeps while the ULP counts the GM pulses. It wakes
+up once per loop (default 1s) to recharge the HV capacitor and to run the main loop,
+and every measurement interval it sends an uplink via LoRa.
+
+The defaults are typical values from the ESP32 / SX1276 datasheets and rough
+measurements, adjust them to your hardware. All currents are at the battery.
+
+Example:
+
+    python3 energy_model.py --battery-mah 2500 --interval 300 --spreading-factor 9
+"""
+
+import argparse
+
+# LoRa airtime [ms] of a ~10 byte uplink (EU868, 125kHz) per spreading factor
+AIRTIME_MS = {7: 46, 8: 82, 9: 164, 10: 330, 11: 660, 12: 1320}
+
+
+def average_current(args):
+    """return the average current [mA] and a breakdown {part: mA}"""
+    parts = {}
+    # sleeping (incl. ULP running continuously and the GM tube circuit)
+    awake_s_per_wake = (args.wake_ms + args.hv_charge_ms) / 1000.0
+    sleep_fraction = max(0.0, 1.0 - awake_s_per_wake / args.wake_period)
+    parts['sleep'] = sleep_fraction * (args.sleep_ma + args.ulp_ma + args.base_ma)
+    # periodic wakeups: main loop and HV recharge
+    parts['wakeups'] = (awake_s_per_wake / args.wake_period) * (args.awake_ma + args.base_ma)
+    # uplinks: TX airtime (2 uplinks: counts + THP, if a sensor is present), RX windows
+    uplinks = 2 if args.thp else 1
+    tx_s = uplinks * AIRTIME_MS[args.spreading_factor] / 1000.0
+    rx_s = uplinks * args.rx_ms / 1000.0
+    parts['lora tx'] = tx_s * args.tx_ma / args.interval
+    parts['lora rx'] = rx_s * args.rx_ma / args.interval
+    return sum(parts.values()), parts
+
+
+def main():
+    parser = argparse.ArgumentParser(description='MultiGeiger low power mode battery life estimation')
+    parser.add_argument('--battery-mah', type=float, default=2500, help='battery capacity [mAh]')
+    parser.add_argument('--usable', type=float, default=0.8, help='usable fraction of the capacity (self discharge, cut-off voltage)')
+    parser.add_argument('--interval', type=float, default=150, help='measurement / uplink interval [s]')
+    parser.add_argument('--spreading-factor', type=int, default=7, choices=sorted(AIRTIME_MS), help='LoRa spreading factor')
+    parser.add_argument('--no-thp', dest='thp', action='store_false', help='no THP sensor (only 1 uplink per interval)')
+    parser.add_argument('--wake-period', type=float, default=1.0, help='time between wakeups [s] (LOOP_DURATION)')
+    parser.add_argument('--wake-ms', type=float, default=8, help='awake time per wakeup for the main loop [ms]')
+    parser.add_argument('--hv-charge-ms', type=float, default=5, help='awake time per wakeup for HV recharging [ms]')
+    parser.add_argument('--awake-ma', type=float, default=45, help='current while awake, radios off [mA]')
+    parser.add_argument('--sleep-ma', type=float, default=0.8, help='current while light-sleeping [mA]')
+    parser.add_argument('--ulp-ma', type=float, default=0.15, help='additional current of the running ULP [mA]')
+    parser.add_argument('--base-ma', type=float, default=0.5, help='always present current: HV circuit, regulator, ... [mA]')
+    parser.add_argument('--tx-ma', type=float, default=120, help='current while transmitting via LoRa [mA]')
+    parser.add_argument('--rx-ma', type=float, default=55, help='current during the LoRa RX windows (CPU awake) [mA]')
+    parser.add_argument('--rx-ms', type=float, default=2100, help='time spent in / waiting for the RX windows per uplink [ms]')
+    args = parser.parse_args()
+
+    total, parts = average_current(args)
+    hours = args.battery_mah * args.usable / total
+    for part, ma in parts.items():
+        print('%-10s %8.3f mA  (%4.1f%%)' % (part, ma, 100.0 * ma / total))
+    print('%-10s %8.3f mA' % ('average', total))
+    print('battery life: %.0f h = %.1f days' % (hours, hours / 24))
+
+
+if __name__ == '__main__':
+    main()
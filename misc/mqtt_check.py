@@ -0,0 +1,189 @@
+#!/usr/bin/env python3
+"""
+Check the MQTT messages of a MultiGeiger against a local mosquitto broker.
+
+Starts mosquitto (unless --host is given, then that broker is used), subscribes to the data
+topic with mosquitto_sub and checks every message:
+
+- valid JSON with software_version, tube and a list of records
+- batching: each message has between --batch and 10 records (more than --batch only when
+  queued records get published after the broker was not reachable)
+- every record has the expected fields and types, t/h/p values all or none
+- counts_per_minute matches counts / sample_time_ms, hv_state is 0..2
+- the timestamps increase from record to record, also across messages (QoS 1 may deliver
+  a message twice: duplicates are reported, but are no error)
+
+Needs the mosquitto and mosquitto_sub programs (e.g. apt install mosquitto mosquitto-clients).
+Configure the MultiGeiger with the broker URI printed at the start (mqtt://<this host>:PORT)
+and "Publish every N measurements" = --batch, then wait for --messages messages:
+
+    python3 misc/mqtt_check.py --batch 3 --messages 5
+
+The exit code is 1 if a check failed or not enough messages arrived within --timeout seconds.
+"""
+
+import argparse
+import json
+import os
+import select
+import socket
+import subprocess
+import sys
+import tempfile
+import time
+
+MAX_BATCH = 10  # MQTT_MAX_BATCH in transmission.cpp
+
+RECORD_FIELDS = {
+    'ts': int, 'sample_time_ms': int, 'counts': int, 'counts_per_minute': int, 'hv_pulses': int,
+    'hv_state': int, 'hv_leak_ratio': (int, float),
+}
+THP_FIELDS = [
+    'temperature', 'humidity', 'pressure', 'temperature_min', 'temperature_max',
+    'humidity_min', 'humidity_max', 'pressure_min', 'pressure_max', 'thp_samples',
+]
+
+
+class Checker:
+    def __init__(self, batch):
+        self.batch = batch
+        self.last_ts = None
+        self.seen = set()
+        self.messages = self.records = self.duplicates = 0
+        self.errors = []
+
+    def error(self, msg):
+        self.errors.append('message %d: %s' % (self.messages, msg))
+        print('  ERROR: ' + msg)
+
+    def check_record(self, i, r):
+        for name, types in RECORD_FIELDS.items():
+            if not isinstance(r.get(name), types) or isinstance(r.get(name), bool):
+                self.error('record %d: %s missing or of wrong type' % (i, name))
+                return
+        thp = [name for name in THP_FIELDS if name in r]
+        if thp and len(thp) != len(THP_FIELDS):
+            self.error('record %d: incomplete t/h/p values: %s' % (i, ', '.join(thp)))
+        unknown = set(r) - set(RECORD_FIELDS) - set(THP_FIELDS)
+        if unknown:
+            self.error('record %d: unknown fields %s' % (i, ', '.join(sorted(unknown))))
+        if not 0 <= r['hv_state'] <= 2:
+            self.error('record %d: hv_state %d' % (i, r['hv_state']))
+        if r['sample_time_ms'] > 0:
+            cpm = r['counts'] * 60000 / r['sample_time_ms']
+            if abs(cpm - r['counts_per_minute']) > 1:
+                self.error('record %d: counts_per_minute %d, expected %.1f' % (i, r['counts_per_minute'], cpm))
+        if thp and not r['temperature_min'] <= r['temperature'] <= r['temperature_max']:
+            self.error('record %d: temperature not within its min / max' % i)
+
+    def check_message(self, payload):
+        self.messages += 1
+        try:
+            msg = json.loads(payload)
+        except ValueError as e:
+            self.error('invalid JSON (%s): %r' % (e, payload[:80]))
+            return
+        for name in ('software_version', 'tube'):
+            if not isinstance(msg.get(name), str):
+                self.error('%s missing' % name)
+        records = msg.get('records')
+        if not isinstance(records, list) or not records:
+            self.error('no records')
+            return
+        print('message %d: %d records, %d bytes' % (self.messages, len(records), len(payload)))
+        if not self.batch <= len(records) <= MAX_BATCH:
+            self.error('%d records, expected %d .. %d' % (len(records), self.batch, MAX_BATCH))
+        for i, r in enumerate(records):
+            if not isinstance(r, dict):
+                self.error('record %d is no object' % i)
+                continue
+            self.records += 1
+            self.check_record(i, r)
+            ts = r.get('ts')
+            if not isinstance(ts, int):
+                continue
+            if ts in self.seen:
+                self.duplicates += 1
+                print('  duplicate record ts=%d (redelivered message?)' % ts)
+                continue
+            if self.last_ts is not None and ts <= self.last_ts:
+                self.error('record %d: ts %d not after %d' % (i, ts, self.last_ts))
+            self.seen.add(ts)
+            self.last_ts = ts
+
+
+def local_ip():
+    s = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    try:
+        s.connect(('192.0.2.1', 9))  # no packets are sent, just selects the interface
+        return s.getsockname()[0]
+    except OSError:
+        return '127.0.0.1'
+    finally:
+        s.close()
+
+
+def start_broker(port):
+    # mosquitto 2.x only listens on localhost and needs allow_anonymous without a config
+    conf = tempfile.NamedTemporaryFile('w', suffix='.conf', delete=False)
+    conf.write('listener %d\nallow_anonymous true\n' % port)
+    conf.close()
+    broker = subprocess.Popen(['mosquitto', '-c', conf.name], stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL)
+    for _ in range(50):
+        try:
+            socket.create_connection(('127.0.0.1', port), 0.1).close()
+            break
+        except OSError:
+            time.sleep(0.1)
+    os.unlink(conf.name)
+    return broker
+
+
+def main():
+    parser = argparse.ArgumentParser(description='check the MQTT messages of a MultiGeiger')
+    parser.add_argument('--host', help='use this broker instead of starting mosquitto')
+    parser.add_argument('--port', type=int, default=1883, help='broker port')
+    parser.add_argument('--topic', default='multigeiger/+/data', help='topic to subscribe to')
+    parser.add_argument('--batch', type=int, default=1, help='configured records per message (1 .. 10)')
+    parser.add_argument('--messages', type=int, default=3, help='stop after this many messages')
+    parser.add_argument('--timeout', type=float, default=3600, help='max. time to wait [s]')
+    args = parser.parse_args()
+
+    broker = None
+    host = args.host
+    if not host:
+        broker = start_broker(args.port)
+        host = '127.0.0.1'
+        print('mosquitto started, broker URI for the MultiGeiger: mqtt://%s:%d' % (local_ip(), args.port))
+    sub = subprocess.Popen(['mosquitto_sub', '-h', host, '-p', str(args.port), '-t', args.topic, '-q', '1', '-v'],
+                           stdout=subprocess.PIPE, universal_newlines=True)
+    checker = Checker(args.batch)
+    deadline = time.time() + args.timeout
+    try:
+        while checker.messages < args.messages and time.time() < deadline:
+            ready, _, _ = select.select([sub.stdout], [], [], 1.0)
+            if not ready:
+                continue
+            line = sub.stdout.readline()
+            if not line:
+                break  # mosquitto_sub ended (e.g. the broker is not reachable)
+            topic, _, payload = line.rstrip('\n').partition(' ')
+            print('%s %s' % (time.strftime('%H:%M:%S'), topic))
+            checker.check_message(payload)
+    except KeyboardInterrupt:
+        pass
+    finally:
+        sub.terminate()
+        if broker:
+            broker.terminate()
+
+    print('%d messages, %d records (%d duplicates), %d errors' % (
+        checker.messages, checker.records, checker.duplicates, len(checker.errors)))
+    if checker.messages < args.messages:
+        print('only %d of %d messages received' % (checker.messages, args.messages))
+        return 1
+    return 1 if checker.errors else 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,587 @@
+// pulse trace replay simulator for the MultiGeiger counting logic.
+//
+// Feeds synthetic or recorded GM pulse trains through the real firmware code (isr_GMC_count,
+// read_GMC and the rate / local alarm computation of publish(), see rates.cpp) and the HV
+// charging ISR, running in virtual time (see platform_linux.cpp), much faster than real time.
+// Reports counting loss, rate error and alarm behaviour.
+//
+// Build (from the repo root):
+//
+//   g++ -std=gnu++11 -O2 -DISR_PROFILE=0 -Imultigeiger -o pulsesim misc/pulsesim.cpp
+//       multigeiger/tube.cpp multigeiger/timers.cpp multigeiger/rates.cpp multigeiger/platform_linux.cpp
+//
+// (ISR_PROFILE=0: reading the host clock in every ISR call would make the simulation 10x slower)
+//
+// Usage:
+//
+//   pulsesim SCENARIO [key=value ...]     simulate one scenario, print the results
+//   pulsesim sweep [key=value ...]        Poisson pulses from 0.1 to 100000 cps
+//   pulsesim check FILE                   regression check against a threshold file
+//                                         (e.g. misc/pulsesim_thresholds.txt), exit code 1 on failure
+//
+// Scenarios (rates in cps, times in s):
+//
+//   poisson   rate
+//   burst     rate, burst_rate, burst_start, burst_len: poisson, but burst_rate during the burst
+//   emi       rate, emi_rate, emi_spikes, emi_gap_us: poisson, plus EMI events with emi_spikes
+//             short spikes emi_gap_us apart each (spikes are not counted as true pulses)
+//   trace     file: recorded pulse timestamps [us], one per line, or the pulses CSV written
+//             by decode_binary_log.py (32bit timestamps, wraparounds get undone)
+//
+// Common keys: duration, seed, width_us (low time of the GM input pin per pulse), tube (TUBE_TYPE),
+// threshold [uSv/h] and factor (local alarm), min_counts, refresh_ms and loop_ms (main loop).
+//
+// Results:
+//
+//   loss         counting loss: 1 - counted / true pulses [%] (negative if noise got counted)
+//   rate_err     error of the accumulated count rate computed by the firmware [%]
+//   corr_err     like rate_err, after correcting the rate for GMC_DEAD_TIME (non-paralyzable) [%]
+//   alarms       count of rate computations that raised the local alarm
+//   first_alarm  time of the first alarm [s], -1 = none
+//   latency      time from burst_start to the first alarm after it [s], -1 = none
+//   false_alarms alarms before burst_start (only meaningful for the burst scenario)
+//   hv_error     1 if the HV charging reported an error
+//
+// Threshold file: one scenario per line, scenario name and key=value pairs like on the
+// command line, plus limits like "loss<=5", "alarms=0" or "latency<=30". Limits for
+// rate_err and corr_err apply to the absolute value. "#" starts a comment.
+
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <string>
+#include <vector>
+
+#include "platform.h"
+#include "tube.h"
+#include "rates.h"
+
+typedef struct {
+  std::string type;
+  std::string file;
+  double rate;
+  double burst_rate, burst_start, burst_len;
+  double emi_rate, emi_spikes, emi_gap_us;
+  double duration, seed, width_us;
+  double tube, threshold, factor;
+  double min_counts, refresh_ms, loop_ms;
+} Scenario;
+
+typedef struct {
+  unsigned long true_pulses, noise_pulses, counted;
+  double duration;
+  double true_rate, acc_rate;
+  double loss, rate_err, corr_err;
+  unsigned long updates, alarms, false_alarms;
+  double first_alarm, latency;
+  bool hv_error;
+  unsigned long fet_pulses;
+  double speed;  // virtual time / real time
+} Result;
+
+static void default_scenario(Scenario *s) {
+  s->type = "poisson";
+  s->file = "";
+  s->rate = 1.0;
+  s->burst_rate = 0.0;
+  s->burst_start = 0.0;
+  s->burst_len = 0.0;
+  s->emi_rate = 0.0;
+  s->emi_spikes = 5;
+  s->emi_gap_us = 20;
+  s->duration = 0.0;  // 0 = default, depends on the rate
+  s->seed = 1;
+  s->width_us = 20;
+  s->tube = 3;  // Si22G
+  s->threshold = 0.5;
+  s->factor = 3;
+  s->min_counts = 100;  // same as in multigeiger.ino
+  s->refresh_ms = 10000;
+  s->loop_ms = 1000;
+}
+
+static double *scenario_value(Scenario *s, const char *key) {
+  static const struct {
+    const char *key;
+    size_t offset;
+  } keys[] = {
+    {"rate", offsetof(Scenario, rate)},
+    {"burst_rate", offsetof(Scenario, burst_rate)},
+    {"burst_start", offsetof(Scenario, burst_start)},
+    {"burst_len", offsetof(Scenario, burst_len)},
+    {"emi_rate", offsetof(Scenario, emi_rate)},
+    {"emi_spikes", offsetof(Scenario, emi_spikes)},
+    {"emi_gap_us", offsetof(Scenario, emi_gap_us)},
+    {"duration", offsetof(Scenario, duration)},
+    {"seed", offsetof(Scenario, seed)},
+    {"width_us", offsetof(Scenario, width_us)},
+    {"tube", offsetof(Scenario, tube)},
+    {"threshold", offsetof(Scenario, threshold)},
+    {"factor", offsetof(Scenario, factor)},
+    {"min_counts", offsetof(Scenario, min_counts)},
+    {"refresh_ms", offsetof(Scenario, refresh_ms)},
+    {"loop_ms", offsetof(Scenario, loop_ms)},
+  };
+  for (size_t i = 0; i < sizeof(keys) / sizeof(keys[0]); i++)
+    if (strcmp(keys[i].key, key) == 0)
+      return (double *)((char *)s + keys[i].offset);
+  return NULL;
+}
+
+// set key=value, return false if unknown
+static bool set_scenario(Scenario *s, const char *arg) {
+  const char *eq = strchr(arg, '=');
+  if (!eq)
+    return false;
+  std::string key(arg, eq - arg);
+  if (key == "file") {
+    s->file = eq + 1;
+    return true;
+  }
+  double *value = scenario_value(s, key.c_str());
+  if (!value)
+    return false;
+  *value = atof(eq + 1);
+  return true;
+}
+
+// ----- pulse sources -----
+
+static uint64_t rng_state;
+
+static double uniform(void) {
+  // splitmix64, so results are the same everywhere
+  uint64_t z = (rng_state += 0x9E3779B97F4A7C15ULL);
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  z ^= z >> 31;
+  return ((z >> 11) + 0.5) * (1.0 / 9007199254740992.0);
+}
+
+static double true_rate_at(const Scenario *s, double t) {
+  if ((s->type == "burst") && (t >= s->burst_start) && (t < s->burst_start + s->burst_len))
+    return s->burst_rate;
+  return s->rate;
+}
+
+static double next_rate_change(const Scenario *s, double t) {
+  if (s->type == "burst") {
+    if (t < s->burst_start)
+      return s->burst_start;
+    if (t < s->burst_start + s->burst_len)
+      return s->burst_start + s->burst_len;
+  }
+  return INFINITY;
+}
+
+// next pulse of a (piecewise constant rate) Poisson process after t [s]
+static double next_poisson(const Scenario *s, double t) {
+  for (;;) {
+    double rate = true_rate_at(s, t);
+    double change = next_rate_change(s, t);
+    if (rate > 0) {
+      double next = t - log(uniform()) / rate;
+      if (next < change)
+        return next;
+    }
+    if (change == INFINITY)
+      return INFINITY;
+    t = change;  // memoryless, so just start over at the rate change
+  }
+}
+
+typedef struct {
+  const Scenario *s;
+  double next_true;  // [s]
+  double next_emi;  // [s], next EMI event
+  double spike;  // [s], next spike of the current EMI event
+  int spikes_left;
+  std::vector<double> trace;  // [s]
+  size_t trace_pos;
+} Source;
+
+static bool load_trace(Source *src, const char *fname) {
+  FILE *f = fopen(fname, "r");
+  if (!f) {
+    perror(fname);
+    return false;
+  }
+  char line[256];
+  int column = 0;  // column with the timestamps
+  bool first = true;
+  uint64_t offset = 0, last = 0;
+  while (fgets(line, sizeof(line), f)) {
+    if (first && strstr(line, "timestamp_us")) {
+      // CSV header of decode_binary_log.py
+      for (char *p = line; (p = strchr(p, ',')) && (p < strstr(line, "timestamp_us")); p++)
+        column++;
+      first = false;
+      continue;
+    }
+    first = false;
+    char *p = line;
+    for (int i = 0; (i < column) && p; i++)
+      if ((p = strchr(p, ',')))
+        p++;
+    if (!p || (*p < '0') || (*p > '9'))
+      continue;
+    uint64_t ts = strtoull(p, NULL, 10) + offset;
+    if (src->trace.size() && (ts < last) && (last - ts > 0x80000000ULL)) {
+      offset += 0x100000000ULL;  // micros() wrapped around
+      ts += 0x100000000ULL;
+    }
+    last = ts;
+    src->trace.push_back(ts / 1e6);
+  }
+  fclose(f);
+  if (!src->trace.size()) {
+    fprintf(stderr, "%s: no pulses found\n", fname);
+    return false;
+  }
+  double start = src->trace[0];
+  for (size_t i = 0; i < src->trace.size(); i++)
+    src->trace[i] -= start;
+  return true;
+}
+
+static bool init_source(Source *src, const Scenario *s) {
+  src->s = s;
+  src->trace_pos = 0;
+  src->trace.clear();
+  if (s->type == "trace")
+    return load_trace(src, s->file.c_str());
+  src->next_true = next_poisson(s, 0.0);
+  src->next_emi = (s->emi_rate > 0) ? -log(uniform()) / s->emi_rate : INFINITY;
+  src->spikes_left = 0;
+  return true;
+}
+
+// next pulse [s], INFINITY if none. *noise: not a true GM pulse.
+static double next_pulse(Source *src, bool *noise) {
+  const Scenario *s = src->s;
+  *noise = false;
+  if (s->type == "trace")
+    return (src->trace_pos < src->trace.size()) ? src->trace[src->trace_pos++] : INFINITY;
+  if (!src->spikes_left && (src->next_emi < src->next_true)) {
+    src->spike = src->next_emi;
+    src->spikes_left = (int)s->emi_spikes;
+    src->next_emi += -log(uniform()) / s->emi_rate;
+  }
+  if (src->spikes_left && (src->spike < src->next_true)) {
+    double t = src->spike;
+    src->spike += s->emi_gap_us / 1e6;
+    src->spikes_left--;
+    *noise = true;
+    return t;
+  }
+  double t = src->next_true;
+  src->next_true = next_poisson(s, t);
+  return t;
+}
+
+// ----- simulated device -----
+
+static const Scenario *cur;
+static Result *res;
+static Rates rates;
+static unsigned long total_counts;
+static uint64_t next_loop_us;
+static bool pin_low;
+static uint64_t pin_release_us;
+
+static void hw_model(int pin, int level) {
+  // the HV capacitor is full after each charge pulse
+  if (pin == PIN_HV_FET_OUTPUT) {
+    if (level)
+      res->fet_pulses++;
+    hal_sim_set_pin(PIN_HV_CAP_FULL_INPUT, level);
+  }
+}
+
+static void main_loop(void) {
+  // what loop() / publish() do with the counts
+  unsigned long timestamp;
+  unsigned int between;
+  read_GMC(&total_counts, &timestamp, &between);
+  if (update_rates(&rates, hal_millis(), total_counts, timestamp) != RATES_UPDATED)
+    return;
+  res->updates++;
+  if (check_alarm(&rates, cur->threshold, (int)cur->factor) == ALARM_NONE)
+    return;
+  double t = hal_sim_time_us() / 1e6;
+  res->alarms++;
+  if (res->first_alarm < 0)
+    res->first_alarm = t;
+  if (t < cur->burst_start)
+    res->false_alarms++;
+  else if (res->latency < 0)
+    res->latency = t - cur->burst_start;
+}
+
+// advance the virtual time to t_us, running the main loop and releasing the input pin on the way
+static void run_until(uint64_t t_us) {
+  for (;;) {
+    uint64_t now = hal_sim_time_us();
+    uint64_t next = (next_loop_us < t_us) ? next_loop_us : t_us;
+    if (pin_low && (pin_release_us < next))
+      next = pin_release_us;
+    if (next > now)
+      hal_sim_advance(next - now);
+    if (pin_low && (pin_release_us <= next)) {
+      hal_sim_set_pin(PIN_GMC_COUNT_INPUT, HIGH);
+      pin_low = false;
+    }
+    if (next_loop_us <= next) {
+      main_loop();
+      next_loop_us += (uint64_t)(cur->loop_ms * 1000);
+    }
+    if (next >= t_us)
+      return;
+  }
+}
+
+static double default_duration(const Scenario *s) {
+  // enough for ~10000 counts, but not more than 10h of virtual time
+  double d = 10000.0 / ((s->rate > 0) ? s->rate : 1.0);
+  if (d < 60)
+    d = 60;
+  if (d > 36000)
+    d = 36000;
+  if (s->type == "burst" && (d < s->burst_start + s->burst_len + 60))
+    d = s->burst_start + s->burst_len + 60;
+  return d;
+}
+
+static bool simulate(const Scenario *s, Result *r) {
+  Source src;
+  if ((s->tube < 0) || (s->tube >= TUBE_TYPES) || (s->tube != (int)s->tube)) {
+    fprintf(stderr, "invalid tube %g, must be 0 .. %d\n", s->tube, TUBE_TYPES - 1);
+    return false;
+  }
+  memset(r, 0, sizeof(*r));
+  r->first_alarm = r->latency = -1;
+  rng_state = (uint64_t)s->seed;
+  if (!init_source(&src, s))
+    return false;
+  double duration = s->duration;
+  if (duration <= 0)
+    duration = (s->type == "trace") ? src.trace.back() + 1.0 : default_duration(s);
+
+  // power on
+  cur = s;
+  res = r;
+  hal_sim_reset();
+  hal_sim_write_hook(hw_model);
+  hal_sim_set_pin(PIN_GMC_COUNT_INPUT, HIGH);  // idle level
+  setup_tube();
+  init_rates(&rates, hal_millis(), (unsigned int)s->min_counts, (unsigned long)s->refresh_ms, tubes[(int)s->tube].cps_to_uSvph);
+  total_counts = 0;
+  next_loop_us = (uint64_t)(s->loop_ms * 1000);
+  pin_low = false;
+
+  clock_t started = clock();
+  uint64_t end_us = (uint64_t)(duration * 1e6);
+  uint64_t width_us = (s->width_us >= 1) ? (uint64_t)s->width_us : 1;
+  for (;;) {
+    bool noise;
+    double t = next_pulse(&src, &noise);
+    if (t >= duration)
+      break;
+    uint64_t t_us = (uint64_t)(t * 1e6);
+    run_until(t_us);
+    if (noise)
+      r->noise_pulses++;
+    else
+      r->true_pulses++;
+    if (!pin_low) {
+      hal_sim_set_pin(PIN_GMC_COUNT_INPUT, LOW);  // falling edge: isr_GMC_count
+      pin_low = true;
+      pin_release_us = t_us + width_us;
+    } else if (t_us + width_us > pin_release_us) {
+      pin_release_us = t_us + width_us;  // overlapping pulses: pin stays low
+    }
+  }
+  run_until(end_us);
+  double cpu = (double)(clock() - started) / CLOCKS_PER_SEC;
+
+  unsigned long timestamp;
+  unsigned int between;
+  read_GMC(&total_counts, &timestamp, &between);
+  unsigned long hv_pulses;
+  read_hv(&r->hv_error, &hv_pulses);
+  r->counted = total_counts;
+  r->duration = duration;
+  r->true_rate = r->true_pulses / duration;
+  r->acc_rate = rates.accumulated_count_rate;
+  r->loss = r->true_pulses ? 100.0 * (1.0 - (double)r->counted / r->true_pulses) : 0.0;
+  if (r->true_rate > 0) {
+    r->rate_err = 100.0 * (r->acc_rate / r->true_rate - 1.0);
+    double tau = GMC_DEAD_TIME / 1e6;
+    double corrected = (r->acc_rate * tau < 1.0) ? r->acc_rate / (1.0 - r->acc_rate * tau) : INFINITY;
+    r->corr_err = 100.0 * (corrected / r->true_rate - 1.0);
+  }
+  r->speed = (cpu > 0) ? duration / cpu : 0;
+  return true;
+}
+
+// ----- output / regression check -----
+
+static void print_header(void) {
+  printf("%-10s %10s %9s %10s %10s %7s %9s %9s %7s %7s %6s %3s %8s\n",
+         "scenario", "true_cps", "duration", "counted", "acc_cps", "loss%", "rate_err%", "corr_err%",
+         "alarms", "first", "lat", "hv", "speed");
+}
+
+static void print_result(const Scenario *s, const Result *r) {
+  printf("%-10s %10.1f %9.0f %10lu %10.2f %7.2f %9.2f %9.2f %7lu %7.0f %6.0f %3d %7.0fx\n",
+         s->type.c_str(), r->true_rate, r->duration, r->counted, r->acc_rate, r->loss, r->rate_err, r->corr_err,
+         r->alarms, r->first_alarm, r->latency, r->hv_error, r->speed);
+}
+
+static bool result_value(const Result *r, const char *name, double *value) {
+  if (strcmp(name, "loss") == 0)
+    *value = r->loss;
+  else if (strcmp(name, "rate_err") == 0)
+    *value = fabs(r->rate_err);
+  else if (strcmp(name, "corr_err") == 0)
+    *value = fabs(r->corr_err);
+  else if (strcmp(name, "alarms") == 0)
+    *value = r->alarms;
+  else if (strcmp(name, "false_alarms") == 0)
+    *value = r->false_alarms;
+  else if (strcmp(name, "first_alarm") == 0)
+    *value = r->first_alarm;
+  else if (strcmp(name, "latency") == 0)
+    *value = r->latency;
+  else if (strcmp(name, "hv_error") == 0)
+    *value = r->hv_error;
+  else
+    return false;
+  return true;
+}
+
+// check a limit like "loss<=5", return false if violated (or invalid)
+static bool check_limit(const Result *r, const char *limit) {
+  const char *op = strpbrk(limit, "<>=");
+  if (!op) {
+    printf("  invalid limit: %s\n", limit);
+    return false;
+  }
+  std::string name(limit, op - limit);
+  double value;
+  if (!result_value(r, name.c_str(), &value)) {
+    printf("  unknown result: %s\n", name.c_str());
+    return false;
+  }
+  bool ok;
+  if (strncmp(op, "<=", 2) == 0)
+    ok = value <= atof(op + 2);
+  else if (strncmp(op, ">=", 2) == 0)
+    ok = value >= atof(op + 2);
+  else if (*op == '=')
+    ok = value == atof(op + 1);
+  else {
+    printf("  invalid limit: %s\n", limit);
+    return false;
+  }
+  if (!ok)
+    printf("  FAILED: %s (is %.3f)\n", limit, value);
+  return ok;
+}
+
+static int check(const char *fname) {
+  FILE *f = fopen(fname, "r");
+  if (!f) {
+    perror(fname);
+    return 2;
+  }
+  char line[512];
+  int lineno = 0, failed = 0, total = 0;
+  print_header();
+  while (fgets(line, sizeof(line), f)) {
+    lineno++;
+    char *comment = strchr(line, '#');
+    if (comment)
+      *comment = 0;
+    std::vector<std::string> limits;
+    Scenario s;
+    default_scenario(&s);
+    bool have_type = false, ok = true;
+    for (char *tok = strtok(line, " \t\r\n"); tok; tok = strtok(NULL, " \t\r\n")) {
+      if (!have_type) {
+        s.type = tok;
+        have_type = true;
+      } else if (strpbrk(tok, "<>") || !set_scenario(&s, tok)) {
+        limits.push_back(tok);
+      }
+    }
+    if (!have_type)
+      continue;
+    Result r;
+    total++;
+    if (!simulate(&s, &r)) {
+      printf("%s:%d: simulation failed\n", fname, lineno);
+      failed++;
+      continue;
+    }
+    print_result(&s, &r);
+    for (size_t i = 0; i < limits.size(); i++)
+      ok = check_limit(&r, limits[i].c_str()) && ok;
+    if (!ok) {
+      printf("  (%s:%d)\n", fname, lineno);
+      failed++;
+    }
+  }
+  fclose(f);
+  printf("%d of %d scenarios failed\n", failed, total);
+  return failed ? 1 : 0;
+}
+
+static int usage(void) {
+  fprintf(stderr, "usage: pulsesim poisson|burst|emi|trace [key=value ...]\n"
+          "       pulsesim sweep [key=value ...]\n"
+          "       pulsesim check THRESHOLD_FILE\n");
+  return 2;
+}
+
+int main(int argc, char *argv[]) {
+  if (argc < 2)
+    return usage();
+  if (strcmp(argv[1], "check") == 0)
+    return (argc == 3) ? check(argv[2]) : usage();
+
+  Scenario s;
+  default_scenario(&s);
+  s.type = argv[1];
+  for (int i = 2; i < argc; i++)
+    if (!set_scenario(&s, argv[i])) {
+      fprintf(stderr, "invalid argument: %s\n", argv[i]);
+      return usage();
+    }
+  if (s.type == "sweep") {
+    static const double sweep_rates[] = {0.1, 0.3, 1, 3, 10, 30, 100, 300, 1000, 3000, 10000, 30000, 100000};
+    s.type = "poisson";
+    print_header();
+    for (size_t i = 0; i < sizeof(sweep_rates) / sizeof(sweep_rates[0]); i++) {
+      Result r;
+      s.rate = sweep_rates[i];
+      if (!simulate(&s, &r))
+        return 1;
+      print_result(&s, &r);
+    }
+    return 0;
+  }
+  if ((s.type != "poisson") && (s.type != "burst") && (s.type != "emi") && (s.type != "trace"))
+    return usage();
+  Result r;
+  if (!simulate(&s, &r))
+    return 1;
+  print_header();
+  print_result(&s, &r);
+  return 0;
+}
@@ -3,6 +3,10 @@
 //
 // Heart Rate Measurement = Radiation CPM, Energy Expense = Rolling Packet Counter
 //
+// Additionally, there is a custom MultiGeiger Telemetry Service, which notifies all
+// the measured data in one packet, with a notification interval set by the client.
+// It also offers a download of the history (seconds / minutes / hours tier), see history.h.
+//
 // Based on Neil Kolban's example file: https://github.com/nkolban/ESP32_BLE_Arduino
 // Based on Andreas Spiess' example file: https://github.com/SensorsIot/Bluetooth-BLE-on-Arduino-IDE/blob/master/Polar_H7_Sensor/Polar_H7_Sensor.ino
 
@@ -13,6 +17,9 @@
 #include "utils.h"
 #include "ble.h"
 #include "display.h"
+#include "tube.h"
+#include "history.h"
+#include "boot.h"
 
 #include <NimBLEDevice.h>
 
@@ -24,8 +31,14 @@ static NimBLEServer *bleServer;
 #define BLE_CHAR_HR_CONTROLPOINT  BLEUUID((uint16_t)0x2A39)  // 16 bit UUID of Heart Rate Control Point Characteristic
 #define BLE_DESCR_UUID            BLEUUID((uint16_t)0x2901)  // 16 bit UUID of BLE Descriptor
 
-static bool ble_enabled = false;
+#define BLE_SERVICE_TELEMETRY     BLEUUID("5f6d4f53-5f47-4549-4745-520000000001")  // MultiGeiger Telemetry Service
+#define BLE_CHAR_TELEMETRY        BLEUUID("5f6d4f53-5f47-4549-4745-520000000002")  // Telemetry Characteristic
+#define BLE_CHAR_TELEMETRY_INTVL  BLEUUID("5f6d4f53-5f47-4549-4745-520000000003")  // Notification Interval Characteristic
+#define BLE_CHAR_HISTORY          BLEUUID("5f6d4f53-5f47-4549-4745-520000000004")  // History Transfer Characteristic
+
+static volatile bool ble_enabled = false;  // true when the (deferred) init is done
 static bool device_connected = false;
+static uint16_t conn_handle;
 
 uint8_t flags_HRS = 0b00001001; // bit 0 --> 1 = HR (cpm) as UINT16, bit 3 --> add UINT16 Energy Expended (rolling update counter)
 uint8_t txBuffer_HRM[5]; // transmit buffer, byte[0] = flags, [1, 2] = cpm, [3, 4] = rolling update counter
@@ -33,6 +46,38 @@ uint8_t txBuffer_HRPOS[1] = {TUBE_TYPE};
 unsigned int status_HRCP = 0;
 unsigned int cpm_update_counter = 0;
 
+// characteristics we notify, cached at setup
+static NimBLECharacteristic *bleCharHRM;
+static NimBLECharacteristic *bleCharTelemetry;
+
+// telemetry packet (little endian), fits into the default ATT MTU (20 bytes payload):
+// [0] flags: bit 0 = HV error, bit 1 = THP valid
+// [1..3] cpm (current, since last notification), [4..6] cpm (accumulated since start)
+// [7..9] dose rate [nSv/h] (current), [10..13] counts (accumulated since start)
+// [14..15] temperature [0.1 C] (signed), [16] humidity [0.5 %], [17..18] pressure [10 Pa]
+// [19] rolling packet counter
+#define TELEMETRY_LEN 20
+#define TELEMETRY_INTERVAL_MIN 1  // [s]
+#define TELEMETRY_INTERVAL_MAX 3600  // [s]
+uint8_t txBuffer_telemetry[TELEMETRY_LEN];
+static volatile unsigned int telemetry_interval = 10;  // [s], set by the client
+
+// history transfer: the client writes the (uint32) sequence number to start with and
+// optionally the (uint8) tier (default: minutes), we notify chunks of
+// [uint32 seq of 1st record][records: uint32 time, uint32 counts]...
+// as large as the negotiated MTU allows. a chunk without records marks the end, its seq
+// is the one to request next time. a transfer can be resumed or restarted any time by
+// writing a new start seq. reading the characteristic gives [uint32 first][uint32 next]
+// of the minutes, seconds and hours tier.
+#define BLE_MTU 247  // we ask for this, the client might negotiate less
+#define HISTORY_RECORD_LEN 8
+#define HISTORY_CHUNK_RECORDS ((BLE_MTU - 3 - 4) / HISTORY_RECORD_LEN)
+#define HISTORY_CHUNK_DELAY 20  // [ms] between notifications, so we do not run out of buffers
+static NimBLECharacteristic *bleCharHistory;
+static TaskHandle_t history_task;
+static volatile uint32_t history_request_seq;
+static volatile int history_request_tier;
+
 bool is_ble_connected(void) {
   return ble_enabled && device_connected;
 }
@@ -40,6 +85,7 @@ bool is_ble_connected(void) {
 class MyServerCallbacks: public NimBLEServerCallbacks {
   void onConnect(NimBLEServer *pServer, ble_gap_conn_desc *desc) {
     log(INFO, "BLE device connected, remote MAC: %s", NimBLEAddress(desc->peer_ota_addr).toString().c_str());
+    conn_handle = desc->conn_handle;
     device_connected = true;
   };
 
@@ -57,6 +103,93 @@ class MyCharacteristicCallbacks: public NimBLECharacteristicCallbacks {
   }
 };
 
+// Callback allowing the client to set the telemetry notification interval (uint16 [s])
+class TelemetryIntervalCallbacks: public NimBLECharacteristicCallbacks {
+  void onWrite(NimBLECharacteristic *pCharacteristic) {
+    std::string rxValue = pCharacteristic->getValue();
+    if (rxValue.length() < 2)
+      return;
+    unsigned int interval = (uint8_t)rxValue[0] + ((uint8_t)rxValue[1] << 8);
+    if (interval < TELEMETRY_INTERVAL_MIN)
+      interval = TELEMETRY_INTERVAL_MIN;
+    else if (interval > TELEMETRY_INTERVAL_MAX)
+      interval = TELEMETRY_INTERVAL_MAX;
+    telemetry_interval = interval;
+  }
+};
+
+static void put_le(uint8_t *buf, unsigned long value, int len) {
+  for (int i = 0; i < len; i++)
+    buf[i] = (value >> (8 * i)) & 0xFF;
+}
+
+// Callbacks for the History Transfer Characteristic: read gives the available range, write starts a transfer
+class HistoryCallbacks: public NimBLECharacteristicCallbacks {
+  void onRead(NimBLECharacteristic *pCharacteristic) {
+    static const int tiers[] = {HISTORY_MINUTES, HISTORY_SECONDS, HISTORY_HOURS};  // minutes first, as before
+    uint8_t range[8 * HISTORY_TIERS];
+    for (int i = 0; i < HISTORY_TIERS; i++) {
+      put_le(range + 8 * i, history_first_seq(tiers[i]), 4);
+      put_le(range + 8 * i + 4, history_next_seq(tiers[i]), 4);
+    }
+    pCharacteristic->setValue(range, sizeof(range));
+  }
+
+  void onWrite(NimBLECharacteristic *pCharacteristic) {
+    std::string rxValue = pCharacteristic->getValue();
+    if (rxValue.length() < 4)
+      return;
+    history_request_seq = (uint8_t)rxValue[0] + ((uint8_t)rxValue[1] << 8) +
+                          ((uint8_t)rxValue[2] << 16) + ((uint32_t)(uint8_t)rxValue[3] << 24);
+    history_request_tier = ((rxValue.length() >= 5) && ((uint8_t)rxValue[4] < HISTORY_TIERS)) ? (uint8_t)rxValue[4] : HISTORY_MINUTES;
+    xTaskNotifyGive(history_task);
+  }
+};
+
+// streams the history to the client, runs in its own task so neither the BLE host
+// nor loop() gets blocked while a week of records is sent.
+static void history_transfer(void *arg) {
+  uint8_t chunk[4 + HISTORY_CHUNK_RECORDS * HISTORY_RECORD_LEN];
+  HistoryRecord records[HISTORY_CHUNK_RECORDS];
+  for (;;) {
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    uint32_t seq = history_request_seq;
+    int tier = history_request_tier;
+    int max_count = (bleServer->getPeerMTU(conn_handle) - 3 - 4) / HISTORY_RECORD_LEN;
+    if (max_count > HISTORY_CHUNK_RECORDS)
+      max_count = HISTORY_CHUNK_RECORDS;
+    else if (max_count < 1)
+      max_count = 1;
+    log(INFO, "BLE history transfer of tier %d from seq %u, %d records per chunk", tier, seq, max_count);
+    int count;
+    do {
+      if (!device_connected)
+        break;
+      count = history_read(tier, &seq, records, max_count);
+      put_le(chunk, seq, 4);
+      for (int i = 0; i < count; i++) {
+        put_le(chunk + 4 + i * HISTORY_RECORD_LEN, records[i].time, 4);
+        put_le(chunk + 8 + i * HISTORY_RECORD_LEN, records[i].counts, 4);
+      }
+      bleCharHistory->setValue(chunk, 4 + count * HISTORY_RECORD_LEN);
+      bleCharHistory->notify();
+      seq += count;
+      vTaskDelay(pdMS_TO_TICKS(HISTORY_CHUNK_DELAY));
+      if (ulTaskNotifyTake(pdTRUE, 0)) {  // new request while sending, restart there
+        seq = history_request_seq;
+        tier = history_request_tier;
+        count = 1;
+      }
+    } while (count > 0);
+  }
+}
+
+static unsigned long saturate(float value, unsigned long max) {
+  if (value <= 0)
+    return 0;
+  return (value >= max) ? max : (unsigned long)(value + 0.5);
+}
+
 void update_bledata(unsigned int cpm) {
   if (!ble_enabled)
     return;
@@ -73,34 +206,54 @@ void update_bledata(unsigned int cpm) {
   txBuffer_HRM[3] = cpm_update_counter & 0xFF;
   txBuffer_HRM[4] = (cpm_update_counter >> 8) & 0xFF;
   if (bleServer->getConnectedCount()) {
-    NimBLEService *bleSvc = bleServer->getServiceByUUID(BLE_SERVICE_HEART_RATE);
-    if (bleSvc) {
-      NimBLECharacteristic *bleChr = bleSvc->getCharacteristic(BLE_CHAR_HR_MEASUREMENT);
-      if (bleChr) {
-        bleChr->setValue(txBuffer_HRM, 5);
-        bleChr->notify();
-      }
-    }
+    bleCharHRM->setValue(txBuffer_HRM, 5);
+    bleCharHRM->notify();
   }
 }
 
-void setup_ble(char *device_name, bool ble_on) {
-  if (!ble_on) {
-    set_status(STATUS_BLE, ST_BLE_OFF);
-    ble_enabled = false;
+void update_ble_telemetry(unsigned long current_ms, unsigned long counts, bool hv_error,
+                          bool have_thp, float temperature, float humidity, float pressure) {
+  static unsigned long start_ms = current_ms, start_counts = counts;
+  static unsigned long last_ms = current_ms, last_counts = counts;
+  static uint8_t packet_counter = 0;
+  if (!ble_enabled)
     return;
-  }
-  ble_enabled = true;
+  unsigned long dt = current_ms - last_ms;
+  if (dt < telemetry_interval * 1000)
+    return;
+  float cpm = (counts - last_counts) * 60000.0 / dt;
+  float accumulated_cpm = (current_ms != start_ms) ? (counts - start_counts) * 60000.0 / (current_ms - start_ms) : 0.0;
+  float dose_nSvph = cpm / 60.0 * tubes[TUBE_TYPE].cps_to_uSvph * 1000.0;
+  last_ms = current_ms;
+  last_counts = counts;
 
-  set_status(STATUS_BLE, ST_BLE_INIT);
+  uint8_t *p = txBuffer_telemetry;
+  p[0] = (hv_error ? 0x01 : 0) | (have_thp ? 0x02 : 0);
+  put_le(p + 1, saturate(cpm, 0xFFFFFF), 3);
+  put_le(p + 4, saturate(accumulated_cpm, 0xFFFFFF), 3);
+  put_le(p + 7, saturate(dose_nSvph, 0xFFFFFF), 3);
+  put_le(p + 10, counts - start_counts, 4);
+  put_le(p + 14, (uint16_t)(int16_t)(have_thp ? temperature * 10 : 0), 2);
+  p[16] = have_thp ? saturate(humidity * 2, 0xFF) : 0;
+  put_le(p + 17, have_thp ? saturate(pressure / 10, 0xFFFF) : 0, 2);
+  p[19] = packet_counter++;
+
+  bleCharTelemetry->setValue(txBuffer_telemetry, TELEMETRY_LEN);
+  if (bleServer->getConnectedCount())
+    bleCharTelemetry->notify();
+}
+
+static void init_ble(void *arg) {
+  char *device_name = (char *)arg;
   NimBLEDevice::init(device_name);
+  NimBLEDevice::setMTU(BLE_MTU);
 
   bleServer = NimBLEDevice::createServer();
   bleServer->setCallbacks(new MyServerCallbacks());
 
   NimBLEService *bleService = bleServer->createService(BLE_SERVICE_HEART_RATE);
 
-  NimBLECharacteristic *bleCharHRM = bleService->createCharacteristic(BLE_CHAR_HR_MEASUREMENT, NIMBLE_PROPERTY::NOTIFY);
+  bleCharHRM = bleService->createCharacteristic(BLE_CHAR_HR_MEASUREMENT, NIMBLE_PROPERTY::NOTIFY);
   NimBLEDescriptor *bleDescriptorHRM = bleCharHRM->createDescriptor(BLE_DESCR_UUID, NIMBLE_PROPERTY::READ, 20);
   bleDescriptorHRM->setValue("Radiation rate CPM");
 //  bleCharHRM.addDescriptor(new BLE2902());  // required for notification management of the service; automatically added by NimBLE lib
@@ -115,16 +268,50 @@ void setup_ble(char *device_name, bool ble_on) {
 
   bleCharHRPOS->setValue(txBuffer_HRPOS, 1);
 
+  NimBLEService *bleServiceTelemetry = bleServer->createService(BLE_SERVICE_TELEMETRY);
+  bleCharTelemetry = bleServiceTelemetry->createCharacteristic(BLE_CHAR_TELEMETRY, NIMBLE_PROPERTY::READ | NIMBLE_PROPERTY::NOTIFY);
+  NimBLEDescriptor *bleDescriptorTelemetry = bleCharTelemetry->createDescriptor(BLE_DESCR_UUID, NIMBLE_PROPERTY::READ, 30);
+  bleDescriptorTelemetry->setValue("MultiGeiger telemetry");
+  NimBLECharacteristic *bleCharTelemetryInterval = bleServiceTelemetry->createCharacteristic(BLE_CHAR_TELEMETRY_INTVL,
+      NIMBLE_PROPERTY::READ | NIMBLE_PROPERTY::WRITE);
+  NimBLEDescriptor *bleDescriptorTelemetryInterval = bleCharTelemetryInterval->createDescriptor(BLE_DESCR_UUID, NIMBLE_PROPERTY::READ, 40);
+  bleDescriptorTelemetryInterval->setValue("Notification interval [s], uint16");
+  bleCharTelemetryInterval->setCallbacks(new TelemetryIntervalCallbacks());
+  uint8_t interval[2] = {(uint8_t)(telemetry_interval & 0xFF), (uint8_t)(telemetry_interval >> 8)};
+  bleCharTelemetryInterval->setValue(interval, 2);
+  bleCharHistory = bleServiceTelemetry->createCharacteristic(BLE_CHAR_HISTORY,
+                   NIMBLE_PROPERTY::READ | NIMBLE_PROPERTY::WRITE | NIMBLE_PROPERTY::NOTIFY);
+  NimBLEDescriptor *bleDescriptorHistory = bleCharHistory->createDescriptor(BLE_DESCR_UUID, NIMBLE_PROPERTY::READ, 40);
+  bleDescriptorHistory->setValue("History transfer");
+  bleCharHistory->setCallbacks(new HistoryCallbacks());
+  xTaskCreate(history_transfer, "ble_history", 6144, NULL, 1, &history_task);  // flash access needs some stack
+
   bleServer->getAdvertising()->addServiceUUID(BLE_SERVICE_HEART_RATE);
   bleServer->getAdvertising()->setScanResponse(true);
   bleServer->getAdvertising()->setMinPreferred(0x06);
   bleServer->getAdvertising()->setMinPreferred(0x12);
 
   bleService->start();
+  bleServiceTelemetry->start();
   bleServer->getAdvertising()->start();
 
+  ble_enabled = true;
   set_status(STATUS_BLE, ST_BLE_CONNECTABLE);
   log(INFO, "BLE service advertising started, device name: %s, MAC: %s", device_name, BLEDevice::getAddress().toString().c_str());
+  boot_stage("ble");
+  vTaskDelete(NULL);
+}
+
+void setup_ble(char *device_name, bool ble_on) {
+  if (!ble_on) {
+    set_status(STATUS_BLE, ST_BLE_OFF);
+    ble_enabled = false;
+    return;
+  }
+  // NimBLE init takes a while, do it in parallel to the rest of the setup.
+  // until it is done, ble_enabled is false, so the update functions do nothing.
+  set_status(STATUS_BLE, ST_BLE_INIT);
+  xTaskCreate(init_ble, "ble_init", 8192, device_name, 1, NULL);
 }
 
 void disable_ble(void) {
@@ -1,11 +1,14 @@
 // Code related to the transmission of the measured data via Bluetooth Low Energy,
-// uses GATT Heart Rate Measurement Service for notifications with CPM update.
+// uses GATT Heart Rate Measurement Service for notifications with CPM update
+// and a custom MultiGeiger Telemetry Service with all the measured data.
 
 #ifndef _BLE_H_
 #define _BLE_H_
 
-void setup_ble(char *device_name, bool ble_enabled);
+void setup_ble(char *device_name, bool ble_enabled);  // device_name must stay valid, init runs in a task
 void update_bledata(unsigned int cpm);
+void update_ble_telemetry(unsigned long current_ms, unsigned long counts, bool hv_error,
+                          bool have_thp, float temperature, float humidity, float pressure);
 bool is_ble_connected(void);
 void disable_ble(void);
 
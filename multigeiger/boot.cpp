@@ -0,0 +1,50 @@
+// boot time profiling: timeline of the setup stages, time to first count
+
+#include <Arduino.h>
+
+#include "log.h"
+#include "boot.h"
+
+static BootStage stages[BOOT_STAGES_MAX];
+static int stage_count = 0;
+static bool timeline_logged = false;
+
+// stages get recorded by the loop task and by deferred init tasks (e.g. BLE)
+static portMUX_TYPE mux_boot = portMUX_INITIALIZER_UNLOCKED;
+
+void boot_stage(const char *name) {
+  unsigned long us = micros();  // [us] since boot
+  bool log_now;
+  portENTER_CRITICAL(&mux_boot);
+  if (stage_count < BOOT_STAGES_MAX) {
+    stages[stage_count].name = name;
+    stages[stage_count].us = us;
+    stage_count++;
+  }
+  log_now = timeline_logged;
+  portEXIT_CRITICAL(&mux_boot);
+  if (log_now)
+    log(INFO, "Boot: %-12s done at %8lu us", name, us);
+}
+
+void log_boot_timeline(void) {
+  BootStage copy[BOOT_STAGES_MAX];
+  portENTER_CRITICAL(&mux_boot);
+  int count = stage_count;
+  memcpy(copy, stages, count * sizeof(BootStage));
+  timeline_logged = true;  // from now on, boot_stage() logs
+  portEXIT_CRITICAL(&mux_boot);
+  unsigned long last_us = 0;
+  for (int i = 0; i < count; i++) {
+    log(INFO, "Boot: %-12s done at %8lu us (+%lu us)", copy[i].name, copy[i].us, copy[i].us - last_us);
+    last_us = copy[i].us;
+  }
+}
+
+int get_boot_stages(BootStage *copy, int max_count) {
+  portENTER_CRITICAL(&mux_boot);
+  int count = (stage_count < max_count) ? stage_count : max_count;
+  memcpy(copy, stages, count * sizeof(BootStage));
+  portEXIT_CRITICAL(&mux_boot);
+  return count;
+}
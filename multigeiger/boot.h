@@ -0,0 +1,23 @@
+// boot time profiling: timeline of the setup stages, time to first count
+
+#ifndef _BOOT_H_
+#define _BOOT_H_
+
+#define BOOT_STAGES_MAX 16
+
+typedef struct {
+  const char *name;
+  unsigned long us;  // [us] since boot, when the stage was done
+} BootStage;
+
+// record that a setup stage is done. name must be a static string.
+// can be called from any task, also before logging is set up.
+void boot_stage(const char *name);
+
+// log the timeline recorded so far, stages done later are logged immediately.
+void log_boot_timeline(void);
+
+// copy up to max_count stages into stages, returns the amount copied.
+int get_boot_stages(BootStage *stages, int max_count);
+
+#endif // _BOOT_H_
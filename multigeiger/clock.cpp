@@ -1,14 +1,32 @@
+
 #include <Arduino.h>
 #include <sys/time.h>
+#include <esp_timer.h>
 
 #include "clock.h"
 
+// UTC [us] = monotonic esp_timer [us] + offset_us.
+// sync_clock() runs in the loop task, epoch_us() might be called from any task
+// and 64bit values are not atomic on the esp32, thus the mux.
+static int64_t offset_us = 0;
+static bool offset_valid = false;
+static portMUX_TYPE mux_clock = portMUX_INITIALIZER_UNLOCKED;
+
+// corrections bigger than this are stepped, smaller ones are slewed [us]
+#define CLOCK_STEP_US 1000000
+// max. slew per sync_clock() call, at 1 call/s this is 500ppm [us]
+#define CLOCK_SLEW_US 500
+
+// anything before this is not a valid (NTP) time: 2020-01-01T00:00:00
+#define CLOCK_VALID_AFTER 1577836800
 
 void config_time(time_t timestamp) {
   if (timestamp > 0) {
     // a specific timestamp was given, e.g. for testing purposes, set time:
     struct timeval tv = {timestamp, 0};
     settimeofday(&tv, nullptr);
+    offset_valid = false;  // step to the new time
+    sync_clock();
   } else {
     // timestamp == 0 means we shall use NTP to get the time:
     configTime(TZ_OFFSET, DST_OFFSET, NTP_SRV_1, NTP_SRV_2);
@@ -16,16 +34,52 @@ void config_time(time_t timestamp) {
   }
 }
 
+void sync_clock(void) {
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  int64_t target = (int64_t)tv.tv_sec * 1000000 + tv.tv_usec - esp_timer_get_time();
+  int64_t error = target - offset_us;
+  int64_t offset;
+  if (!offset_valid || (error > CLOCK_STEP_US) || (error < -CLOCK_STEP_US)) {
+    offset = target;  // initial setup or NTP did a big correction
+  } else {
+    // slew, so timestamps stay monotonic
+    if (error > CLOCK_SLEW_US)
+      error = CLOCK_SLEW_US;
+    else if (error < -CLOCK_SLEW_US)
+      error = -CLOCK_SLEW_US;
+    offset = offset_us + error;
+  }
+  portENTER_CRITICAL(&mux_clock);
+  offset_us = offset;
+  portEXIT_CRITICAL(&mux_clock);
+  offset_valid = true;
+}
+
+int64_t epoch_us(void) {
+  portENTER_CRITICAL(&mux_clock);
+  int64_t offset = offset_us;
+  portEXIT_CRITICAL(&mux_clock);
+  return esp_timer_get_time() + offset;
+}
+
+bool clock_is_set(void) {
+  return epoch_us() / 1000000 > CLOCK_VALID_AFTER;
+}
 
 char *utctime(void) {
   // return a pointer to a timestamp string like 2019-12-31T23:59:59
-  time_t t;
-  struct tm *ti;
+  // formatting is rather slow, so only do it when the second changed.
+  static time_t rendered = -1;
   static char buffer[20];
 
-  time(&t);
-  ti = gmtime(&t);
-  strftime(buffer, 20, "%Y-%m-%dT%H:%M:%S", ti);
+  time_t t = epoch_us() / 1000000;
+  if (t != rendered) {
+    struct tm ti;
+    gmtime_r(&t, &ti);
+    strftime(buffer, 20, "%Y-%m-%dT%H:%M:%S", &ti);
+    rendered = t;
+  }
   return buffer;
 }
 
@@ -33,4 +87,3 @@ char *utctime(void) {
 void setup_clock(time_t timestamp) {
   config_time(timestamp);
 }
-
@@ -1,6 +1,9 @@
 #ifndef CLOCK_H
 #define CLOCK_H
 
+#include <stdint.h>
+#include <time.h>
+
 #define NTP_SRV_1 "pool.ntp.org"
 #define NTP_SRV_2 "time.nist.gov"
 
@@ -10,8 +13,18 @@
 // timestamp == 0 -> NTP wanted, otherwise just set the clock.
 void setup_clock(time_t timestamp);
 
+// call regularly from loop(): follows the system time (set by NTP) with the
+// monotonic -> UTC mapping. small corrections are slewed, big ones are stepped.
+void sync_clock(void);
+
+// cheap UTC timestamp [us] since epoch (since boot if the clock is not set yet),
+// can be called from any task.
+int64_t epoch_us(void);
+
+// true if the clock was set (by NTP or setup_clock)
+bool clock_is_set(void);
+
 // return a iso-8601-like utc timestamp
 char *utctime(void);
 
 #endif
-
@@ -0,0 +1,202 @@
+// web dashboard, gzip compressed - generated by misc/build_dashboard.py from misc/dashboard/index.html, do not edit!
+
+#ifndef _DASHBOARD_H_
+#define _DASHBOARD_H_
+
+#define DASHBOARD_ETAG "\"2ca5dd6ca45bbccb\""
+
+static const uint8_t dashboard_html_gz[] PROGMEM = {
+  0x1f, 0x8b, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x03, 0x95, 0x59, 0xeb, 0x92, 0xdb, 0xb6,
+  0x15, 0xfe, 0xaf, 0xa7, 0x80, 0x99, 0x34, 0x4b, 0xd5, 0x12, 0x75, 0xf1, 0xee, 0xc6, 0x5e, 0x5d,
+  0x32, 0x89, 0xe3, 0x34, 0xee, 0xd8, 0x71, 0xc6, 0x76, 0xa7, 0xd3, 0xd9, 0xd9, 0xd9, 0xe1, 0x92,
+  0x90, 0x88, 0x2c, 0x45, 0x32, 0x04, 0x24, 0xad, 0x92, 0xb8, 0x6f, 0xd5, 0x17, 0xe8, 0x93, 0xf5,
+  0x3b, 0x07, 0xa0, 0x48, 0x4a, 0xb2, 0x9d, 0xfa, 0x22, 0x91, 0x07, 0xe7, 0x86, 0x73, 0x07, 0x34,
+  0x7d, 0xf4, 0xfd, 0x9b, 0xe7, 0xef, 0xff, 0xf5, 0xf3, 0x0b, 0x91, 0x98, 0x55, 0x3a, 0xef, 0x4c,
+  0x1f, 0xf5, 0xfb, 0x9d, 0xd7, 0xeb, 0xd4, 0xa8, 0xbf, 0x49, 0xb5, 0x94, 0xa5, 0x48, 0xf3, 0x28,
+  0x4c, 0xc5, 0x56, 0xde, 0x89, 0x38, 0xd4, 0xc9, 0x5d, 0x1e, 0x96, 0x71, 0xd0, 0xe9, 0xbc, 0x93,
+  0xe5, 0x46, 0xc6, 0x62, 0xf9, 0x9b, 0x2a, 0x44, 0x94, 0xaf, 0x8a, 0x52, 0x6a, 0x8d, 0xf7, 0x45,
+  0x99, 0xaf, 0xc4, 0x22, 0x05, 0xa2, 0xb8, 0xdb, 0x09, 0x93, 0x48, 0xd1, 0x64, 0xa5, 0x8c, 0x96,
+  0xe9, 0x42, 0xf8, 0x5a, 0x4a, 0xb1, 0x52, 0x3a, 0x1a, 0xdc, 0xad, 0x55, 0x1a, 0xdf, 0xd6, 0x7c,
+  0x8b, 0x5d, 0xb7, 0xd7, 0xd1, 0x39, 0x10, 0xc5, 0x6a, 0xad, 0x8d, 0xc8, 0x72, 0x03, 0xf9, 0x61,
+  0x2c, 0xc2, 0x6c, 0x67, 0x12, 0x95, 0x2d, 0xad, 0x00, 0xe2, 0xab, 0x32, 0x23, 0xcb, 0x4c, 0x1a,
+  0xe1, 0x03, 0x39, 0x4c, 0x41, 0x94, 0x84, 0x5a, 0x98, 0x5c, 0x6c, 0xf3, 0xf2, 0x5e, 0xe4, 0x19,
+  0x23, 0x85, 0x51, 0x04, 0xbd, 0x44, 0x91, 0x03, 0xbb, 0x1b, 0x74, 0xbe, 0x5d, 0x18, 0xde, 0x50,
+  0x18, 0x83, 0x55, 0x8f, 0xa4, 0xe4, 0x59, 0xba, 0xc3, 0x72, 0x9a, 0x6a, 0xa1, 0x57, 0x61, 0x9a,
+  0x8a, 0xbf, 0xbf, 0x7b, 0xf3, 0xd3, 0x95, 0x18, 0x68, 0x13, 0x9a, 0xb5, 0x86, 0xd8, 0x98, 0xf9,
+  0x64, 0x72, 0x2b, 0x06, 0x89, 0xd2, 0x26, 0x2f, 0x77, 0xa2, 0x94, 0x51, 0x5e, 0xc6, 0x3a, 0xe8,
+  0xf4, 0xfb, 0x30, 0x17, 0x59, 0x4d, 0xa4, 0x61, 0xb6, 0x9c, 0x79, 0x32, 0xf3, 0x08, 0x20, 0xc3,
+  0x18, 0x5f, 0x2b, 0x69, 0x42, 0x11, 0x25, 0x61, 0xa9, 0xa5, 0x99, 0x79, 0x6b, 0xb3, 0xe8, 0x3f,
+  0xf5, 0x2a, 0x70, 0x16, 0xae, 0xe4, 0xcc, 0xdb, 0x28, 0xb9, 0x2d, 0xf2, 0xd2, 0x78, 0x30, 0x20,
+  0x36, 0x93, 0x01, 0x6d, 0xab, 0x62, 0x93, 0xcc, 0x62, 0xb9, 0x51, 0x91, 0xec, 0xf3, 0x0b, 0xb4,
+  0xcc, 0x94, 0x51, 0x61, 0xda, 0xd7, 0x70, 0x83, 0x9c, 0x8d, 0x88, 0x89, 0x51, 0x26, 0x95, 0xf3,
+  0x86, 0x65, 0xa7, 0x03, 0x0b, 0xea, 0x4c, 0xb5, 0xd9, 0xd1, 0xf7, 0x5d, 0x1e, 0xef, 0xc4, 0xef,
+  0x62, 0x01, 0xc6, 0xfd, 0x45, 0xb8, 0x52, 0xe9, 0xee, 0x4a, 0xe8, 0x30, 0xd3, 0x7d, 0x2d, 0x4b,
+  0xb5, 0x98, 0x88, 0x55, 0x58, 0x2e, 0x55, 0x76, 0x25, 0x86, 0x22, 0x5c, 0x9b, 0x9c, 0xde, 0x1f,
+  0xac, 0xbc, 0x2b, 0x71, 0x71, 0x29, 0x57, 0x13, 0x51, 0x84, 0x31, 0x19, 0x09, 0x18, 0xc1, 0x05,
+  0xbd, 0x47, 0x79, 0x9a, 0x97, 0x57, 0xe2, 0x8b, 0xf1, 0x78, 0x3c, 0x11, 0x1f, 0x3a, 0xc9, 0xa8,
+  0xe2, 0xae, 0xd5, 0x6f, 0xf2, 0x4a, 0x8c, 0x82, 0x73, 0xc2, 0xfa, 0xd0, 0xc9, 0xc2, 0x8d, 0x08,
+  0xb1, 0x66, 0x05, 0xf4, 0x4b, 0xb5, 0x4c, 0x0c, 0x96, 0xed, 0x62, 0x10, 0xc1, 0xc9, 0x1a, 0xab,
+  0xb1, 0xd2, 0x45, 0x1a, 0x42, 0xa7, 0x45, 0x2a, 0x1f, 0x26, 0xfc, 0xd9, 0xdf, 0x96, 0x61, 0x71,
+  0x25, 0xe8, 0x73, 0x22, 0x96, 0xf4, 0xe8, 0x24, 0x3b, 0x32, 0x92, 0x07, 0x34, 0xf0, 0xa2, 0xbf,
+  0x63, 0x5a, 0xb9, 0x83, 0x1b, 0x24, 0x94, 0x1a, 0x15, 0x0f, 0x42, 0xe7, 0xa9, 0x8a, 0xc5, 0x17,
+  0x51, 0x14, 0x55, 0xf0, 0x7e, 0x09, 0x37, 0xaf, 0xf5, 0x95, 0x38, 0x2f, 0x1e, 0x8e, 0xf7, 0x53,
+  0x71, 0x4d, 0xc6, 0xed, 0x8d, 0x0c, 0x83, 0x67, 0xb4, 0xcc, 0x90, 0xad, 0xb4, 0xda, 0x67, 0x79,
+  0x89, 0xd8, 0xa8, 0x6d, 0x70, 0x79, 0x79, 0xd9, 0xb4, 0x20, 0xfe, 0x06, 0x4f, 0xe4, 0x4a, 0x0c,
+  0x99, 0xeb, 0x26, 0x4c, 0xd7, 0xf2, 0xd0, 0x38, 0x97, 0x4e, 0xa4, 0x8d, 0xb1, 0x03, 0x81, 0x4f,
+  0x5b, 0x06, 0x66, 0xe6, 0x40, 0xcd, 0xef, 0x81, 0x57, 0x01, 0x87, 0x4f, 0x2d, 0xf3, 0x6d, 0x58,
+  0x66, 0x0d, 0xf0, 0xdd, 0xa5, 0x05, 0xdf, 0x85, 0x71, 0x03, 0x1a, 0x0d, 0x19, 0xfa, 0x05, 0x05,
+  0x9f, 0x01, 0xdc, 0xf9, 0x75, 0x34, 0x1c, 0xfe, 0x65, 0x22, 0x12, 0xb7, 0xa7, 0xd1, 0xf9, 0xff,
+  0x6b, 0x41, 0xe7, 0x51, 0x93, 0x37, 0x5d, 0xe3, 0x84, 0x20, 0x83, 0x76, 0xa9, 0xca, 0x78, 0xdf,
+  0x2a, 0x4d, 0xc9, 0x64, 0x99, 0x9c, 0x08, 0x6d, 0xca, 0xfc, 0x5e, 0x92, 0xfe, 0x97, 0x51, 0xf5,
+  0x56, 0x85, 0xd9, 0x28, 0xb8, 0x98, 0x88, 0x8d, 0x8c, 0x90, 0x52, 0x7d, 0xb9, 0x58, 0xe0, 0x81,
+  0xa9, 0x38, 0xcc, 0xe1, 0xa8, 0xbe, 0xc5, 0x6e, 0xc8, 0x30, 0xf2, 0xc1, 0x1c, 0xd8, 0x75, 0x44,
+  0x7a, 0x59, 0x81, 0x95, 0xdd, 0x1c, 0xb2, 0x53, 0x66, 0xaf, 0x40, 0x1c, 0xc7, 0x7f, 0x52, 0x9a,
+  0x09, 0xef, 0x52, 0x22, 0x75, 0x26, 0x80, 0x51, 0xd3, 0xb0, 0xd0, 0xe0, 0x51, 0x3d, 0x4d, 0xda,
+  0x06, 0x05, 0x45, 0xdc, 0x43, 0x91, 0x00, 0x09, 0x69, 0xd8, 0x07, 0xbf, 0x25, 0xc2, 0x22, 0x95,
+  0x0b, 0xd3, 0x8a, 0xba, 0x31, 0x45, 0x08, 0x99, 0xad, 0x7a, 0x26, 0xd2, 0xe9, 0xc0, 0xe5, 0xeb,
+  0x74, 0xe0, 0xca, 0x06, 0x25, 0x2e, 0x15, 0x91, 0x51, 0x3b, 0xbd, 0xf1, 0xde, 0x99, 0x22, 0xb7,
+  0xe6, 0xd3, 0x50, 0x24, 0xa5, 0x5c, 0xcc, 0x3c, 0xd4, 0x8c, 0x85, 0x5a, 0x7a, 0xf3, 0xe7, 0xfc,
+  0xbd, 0x2e, 0x43, 0xa3, 0xf2, 0x6c, 0x3a, 0x08, 0x6b, 0x0c, 0x94, 0x9a, 0x52, 0x45, 0xda, 0x9b,
+  0xbf, 0xb6, 0x0f, 0xad, 0x45, 0x57, 0xcc, 0xbc, 0xf9, 0x8f, 0xae, 0xaa, 0xf9, 0x54, 0xf9, 0xba,
+  0x8c, 0x33, 0x20, 0x41, 0x9d, 0xce, 0x34, 0x56, 0x1b, 0x11, 0xa1, 0x96, 0x6b, 0x48, 0xa3, 0xc4,
+  0x45, 0xe9, 0x11, 0xe2, 0x10, 0xea, 0xcd, 0xa7, 0xc9, 0x18, 0x5a, 0xac, 0x33, 0x23, 0xa0, 0x84,
+  0x14, 0x3e, 0xd6, 0x50, 0xbe, 0x55, 0xb6, 0x36, 0x12, 0xfc, 0xb0, 0xd8, 0x24, 0xe1, 0xf4, 0xf0,
+  0x84, 0x8a, 0x41, 0x5d, 0xac, 0xbc, 0x79, 0x7f, 0x3a, 0xc0, 0x6a, 0x0b, 0x85, 0x93, 0xa4, 0x42,
+  0x81, 0x50, 0x87, 0xc1, 0x9f, 0x1f, 0x55, 0xe0, 0xfb, 0x5c, 0xcb, 0xa6, 0x7c, 0x6e, 0x0f, 0x10,
+  0xf6, 0x49, 0x0d, 0x62, 0x10, 0x7d, 0x4e, 0x05, 0xb4, 0x90, 0x3f, 0xa9, 0xc2, 0x8f, 0xc8, 0x2c,
+  0xb1, 0xc9, 0x53, 0x13, 0x2e, 0xe5, 0xa7, 0xa4, 0x26, 0x9b, 0xcf, 0xc9, 0x4c, 0x36, 0x2a, 0x5b,
+  0xe4, 0x7f, 0x76, 0xe7, 0xdc, 0x2d, 0x8e, 0x04, 0x36, 0xd8, 0xad, 0x0b, 0xa3, 0x56, 0x72, 0xcf,
+  0xee, 0x34, 0x52, 0xa9, 0xb5, 0x3a, 0x90, 0xe8, 0xbe, 0x3a, 0xd3, 0x82, 0xa4, 0xbf, 0x2f, 0x25,
+  0xba, 0xa1, 0xff, 0xfc, 0xe7, 0xd7, 0xdd, 0x2b, 0x52, 0x06, 0xad, 0x1c, 0x69, 0x64, 0x69, 0xd1,
+  0xfe, 0x24, 0x47, 0x07, 0xe0, 0x79, 0x41, 0x91, 0x28, 0x78, 0xc3, 0x33, 0x6f, 0xd4, 0xbb, 0x1c,
+  0x7a, 0x73, 0x76, 0x49, 0x92, 0xaf, 0x11, 0xc9, 0x76, 0xf9, 0x23, 0xb8, 0xa3, 0xf3, 0xf3, 0xa1,
+  0x27, 0x2c, 0x67, 0x19, 0x5b, 0xb2, 0xf1, 0x39, 0x53, 0xea, 0xcf, 0x91, 0x0e, 0x51, 0x24, 0x9d,
+  0xa4, 0xad, 0x94, 0xf7, 0x9f, 0x44, 0x1f, 0xf7, 0xbe, 0x1e, 0x57, 0xc8, 0x4f, 0x86, 0x18, 0x6c,
+  0x76, 0x2d, 0xf6, 0x48, 0x4b, 0x56, 0x81, 0x9f, 0x75, 0x11, 0x66, 0xa7, 0x42, 0x93, 0xea, 0x4c,
+  0xe5, 0x26, 0xc2, 0x21, 0x7b, 0x15, 0xd4, 0x81, 0x37, 0xcb, 0x1a, 0xc1, 0x13, 0xd4, 0xe5, 0xbf,
+  0xcb, 0x1f, 0x66, 0x1e, 0x35, 0x0a, 0x28, 0x39, 0x14, 0xe3, 0x21, 0xf6, 0x48, 0x03, 0x13, 0x8d,
+  0x50, 0xdf, 0xea, 0x02, 0x82, 0xde, 0x52, 0xf6, 0xce, 0x3c, 0xaa, 0x9a, 0xcc, 0x6e, 0xb3, 0x24,
+  0xb3, 0xa3, 0x37, 0x71, 0x79, 0x98, 0x79, 0xcd, 0xa2, 0x27, 0x91, 0x35, 0xff, 0x28, 0x50, 0xb5,
+  0xee, 0x35, 0x3b, 0x1d, 0xe3, 0x00, 0x95, 0x2c, 0xd6, 0xd5, 0x70, 0x15, 0x99, 0x9a, 0x12, 0xff,
+  0x13, 0x44, 0x86, 0x86, 0x86, 0xae, 0x30, 0xe0, 0x9d, 0x60, 0x6f, 0xee, 0xf7, 0x8f, 0x2f, 0xca,
+  0x32, 0x27, 0xb3, 0xba, 0xd7, 0x57, 0x64, 0x0c, 0xbd, 0xe6, 0x89, 0xc9, 0x02, 0x07, 0xc4, 0x67,
+  0x60, 0x79, 0x32, 0x77, 0x9e, 0x2a, 0x6c, 0x44, 0xb1, 0x7c, 0xd2, 0xd5, 0xb8, 0x8a, 0x35, 0x70,
+  0x5a, 0xc0, 0x00, 0x51, 0xa9, 0x0a, 0xd8, 0xce, 0x5b, 0x23, 0x25, 0x35, 0x95, 0x1e, 0xe3, 0x4d,
+  0x3a, 0x9b, 0xb0, 0x14, 0x3f, 0xbf, 0x79, 0xf5, 0xea, 0xf6, 0xf5, 0x3b, 0x31, 0x13, 0x17, 0x30,
+  0x84, 0x85, 0xbd, 0x7f, 0xf9, 0xe2, 0x2d, 0x41, 0xae, 0x3d, 0x8d, 0xb9, 0x2a, 0x43, 0x95, 0xe9,
+  0x09, 0xcf, 0x56, 0x0f, 0x7e, 0x64, 0xdf, 0x7b, 0x37, 0x16, 0xd9, 0x16, 0xf7, 0x99, 0xf8, 0xdd,
+  0x28, 0x6e, 0x5b, 0x3d, 0x54, 0x65, 0x14, 0x1e, 0x6a, 0x67, 0xe7, 0xc3, 0x1e, 0xc6, 0xb4, 0x07,
+  0xaa, 0xeb, 0xeb, 0x34, 0xed, 0x55, 0x53, 0xda, 0x95, 0xb8, 0xbe, 0xe9, 0x55, 0x23, 0x1f, 0xe6,
+  0x0d, 0x4c, 0x8a, 0xb2, 0x27, 0x96, 0x32, 0x93, 0xb6, 0x62, 0xa2, 0x34, 0x7f, 0xb0, 0xbc, 0x75,
+  0xb8, 0x2a, 0x52, 0xa9, 0x49, 0x95, 0x9b, 0x89, 0x10, 0x83, 0x81, 0xb8, 0xb6, 0x89, 0x73, 0xbb,
+  0xd2, 0x4e, 0x8e, 0xbe, 0x11, 0xf9, 0x82, 0x07, 0x42, 0x8e, 0x1c, 0x9e, 0x1b, 0x7b, 0xe8, 0x48,
+  0xa5, 0x85, 0xa9, 0x8d, 0xb4, 0x78, 0x5c, 0x88, 0xac, 0xc2, 0xeb, 0x12, 0x69, 0x43, 0x2a, 0x93,
+  0x56, 0x96, 0x2d, 0xd3, 0xba, 0x09, 0xb3, 0xd3, 0x59, 0xac, 0xb3, 0x88, 0x43, 0xf3, 0x4b, 0x5f,
+  0xc5, 0x5d, 0x74, 0x91, 0x52, 0x9a, 0x35, 0xba, 0x7c, 0x9c, 0x47, 0xeb, 0x15, 0x48, 0x83, 0xa5,
+  0x34, 0x2f, 0x52, 0x49, 0x8f, 0xdf, 0xed, 0x5e, 0xc6, 0x84, 0x44, 0x9d, 0xa3, 0xa6, 0xc3, 0x3a,
+  0x95, 0x6e, 0x7f, 0x5d, 0xa6, 0x20, 0x87, 0x9f, 0x1c, 0x83, 0x85, 0x34, 0x51, 0x42, 0xd0, 0x9e,
+  0xf8, 0x3d, 0x0a, 0xa3, 0x04, 0xb1, 0x83, 0x00, 0xeb, 0x53, 0xb5, 0x97, 0xde, 0x87, 0x6e, 0x00,
+  0x95, 0x33, 0x7f, 0xcf, 0xc5, 0x2f, 0x2d, 0xb1, 0x10, 0x0a, 0x03, 0xfa, 0xa3, 0x12, 0xf3, 0x47,
+  0x17, 0xbb, 0x2a, 0xf3, 0x2d, 0x0f, 0xbf, 0x1c, 0x2b, 0xc4, 0x4c, 0x3c, 0x16, 0x1e, 0x18, 0xe1,
+  0xab, 0x0c, 0xec, 0x16, 0xba, 0x13, 0x26, 0x73, 0x52, 0xcb, 0xe0, 0x17, 0x9d, 0x67, 0x3e, 0x03,
+  0x3f, 0xe0, 0xb3, 0xa9, 0x69, 0xec, 0xba, 0x94, 0xaf, 0xad, 0x2c, 0x92, 0xa4, 0xc5, 0x14, 0xd3,
+  0xdc, 0xb0, 0x5b, 0xd1, 0xbf, 0x0e, 0x4d, 0x12, 0x94, 0x30, 0x62, 0x4c, 0x58, 0x10, 0x26, 0xb4,
+  0x37, 0x69, 0xe0, 0x22, 0x6f, 0x4f, 0x23, 0x8b, 0x81, 0xb8, 0x1c, 0x5a, 0x0a, 0x44, 0x4f, 0x8b,
+  0x66, 0xf4, 0xf5, 0xf8, 0xe9, 0xc7, 0xa9, 0x9e, 0x5c, 0x0e, 0x1d, 0x5d, 0xc2, 0x54, 0xa7, 0xb1,
+  0x9e, 0x5e, 0x9e, 0x57, 0x68, 0x54, 0x2d, 0xbc, 0xf6, 0xce, 0x30, 0xe3, 0x3f, 0xa7, 0x0a, 0xe1,
+  0x4b, 0x58, 0x3b, 0x4a, 0x69, 0x7f, 0x42, 0xa6, 0x01, 0x57, 0x8d, 0x9f, 0x30, 0xec, 0xc3, 0xff,
+  0xb6, 0x03, 0xb0, 0xe5, 0x80, 0xd0, 0x76, 0xa1, 0x4e, 0xf2, 0xed, 0x3b, 0x36, 0xa6, 0xaf, 0x8d,
+  0xb5, 0x8d, 0x8b, 0xc6, 0xa0, 0x58, 0xeb, 0xc4, 0xbf, 0xd6, 0x26, 0x68, 0xc4, 0x22, 0xde, 0x5c,
+  0x38, 0xb2, 0x99, 0xb7, 0x89, 0xc2, 0xc4, 0xe2, 0x57, 0x14, 0xa9, 0xcc, 0x96, 0x18, 0x47, 0xe6,
+  0x18, 0x93, 0xbf, 0xfa, 0x4a, 0x34, 0x29, 0x45, 0xbf, 0x62, 0x7b, 0x3d, 0xbc, 0xc1, 0x3f, 0xe0,
+  0x60, 0xef, 0xb4, 0xad, 0x8a, 0x56, 0x27, 0x6a, 0x61, 0xac, 0xf3, 0xd8, 0x78, 0x47, 0x2c, 0xab,
+  0x20, 0xa1, 0xd8, 0x8e, 0x29, 0xac, 0xfd, 0x4f, 0x09, 0xe8, 0xc2, 0x70, 0x54, 0xf2, 0x60, 0x93,
+  0x42, 0x3b, 0x64, 0xab, 0x79, 0x1b, 0x73, 0xc4, 0x98, 0xb1, 0xb1, 0x91, 0xf4, 0xa5, 0xcf, 0xa3,
+  0x01, 0x22, 0x14, 0xe9, 0xfc, 0xdc, 0x1e, 0x8d, 0x40, 0xdc, 0x70, 0x08, 0x71, 0xfb, 0xeb, 0xde,
+  0xdd, 0xe8, 0x48, 0x5e, 0x83, 0x52, 0x1f, 0x51, 0x02, 0x16, 0x98, 0xfc, 0x07, 0xf5, 0x20, 0x63,
+  0x7f, 0x6c, 0x69, 0x88, 0x43, 0xbe, 0xc1, 0x61, 0x90, 0xfc, 0xd1, 0xe0, 0x1c, 0x9b, 0x66, 0xd0,
+  0x7d, 0xe8, 0x30, 0x4f, 0x1e, 0x13, 0x0e, 0x99, 0x62, 0x2b, 0x94, 0xe5, 0x3a, 0x58, 0xeb, 0x4d,
+  0x91, 0xec, 0xf9, 0x3f, 0xb1, 0xf4, 0xff, 0xfd, 0xcf, 0xbb, 0xcd, 0xc0, 0xc6, 0x13, 0x18, 0xd0,
+  0x0c, 0x71, 0x48, 0xef, 0x69, 0x95, 0x45, 0x54, 0x1f, 0x51, 0xd1, 0x6c, 0x42, 0xed, 0x39, 0x02,
+  0xfd, 0xf6, 0x13, 0x5c, 0x7b, 0x84, 0xcd, 0xfb, 0x3d, 0xf9, 0xa7, 0x19, 0xb8, 0x4d, 0x8e, 0xa7,
+  0x8d, 0x46, 0x8e, 0x4c, 0x36, 0xd0, 0x07, 0x6a, 0x62, 0x30, 0xa9, 0x5d, 0x6f, 0x82, 0x64, 0x13,
+  0x48, 0x4a, 0x7b, 0x0a, 0x66, 0x3c, 0x1f, 0xa8, 0xcf, 0x4b, 0xde, 0xa4, 0x0e, 0xfd, 0x64, 0x03,
+  0xc5, 0x70, 0x12, 0xf1, 0xb8, 0x3e, 0x09, 0xc4, 0x3f, 0xca, 0x7f, 0xcd, 0x2a, 0x96, 0x4b, 0x1c,
+  0x27, 0x64, 0x7c, 0x9a, 0x5b, 0xb5, 0x7a, 0xc4, 0x90, 0x4e, 0x3c, 0x2d, 0x8e, 0xa7, 0xa8, 0xf3,
+  0xfb, 0x23, 0x3a, 0x80, 0x1c, 0x15, 0xed, 0x90, 0xfa, 0xb4, 0xf5, 0x19, 0x88, 0x8b, 0x35, 0xf8,
+  0xe8, 0xdb, 0x42, 0x96, 0xb7, 0xd4, 0x5c, 0x6c, 0x3c, 0xa0, 0xb1, 0x2c, 0xa5, 0xb0, 0x4b, 0x88,
+  0xc5, 0xc4, 0x6b, 0x1b, 0x82, 0x72, 0xfe, 0xd6, 0xe4, 0xb7, 0x95, 0x9e, 0x62, 0x3e, 0x13, 0xb0,
+  0x24, 0xf3, 0x7d, 0x0c, 0x0d, 0x7a, 0x62, 0xbf, 0xa2, 0x32, 0xf1, 0xef, 0x83, 0xa8, 0x3a, 0xcd,
+  0xa3, 0x55, 0x4d, 0x84, 0x75, 0x00, 0x0f, 0x14, 0x87, 0xa1, 0x42, 0x40, 0x87, 0xe1, 0x46, 0xb9,
+  0xa3, 0x60, 0xb2, 0x70, 0x1b, 0x47, 0x75, 0x99, 0x6d, 0xa6, 0xa6, 0xcd, 0xc4, 0xae, 0xe3, 0xc3,
+  0xd3, 0xde, 0xa9, 0x90, 0x06, 0x5c, 0x7c, 0x23, 0xbc, 0x7f, 0xaa, 0x1f, 0x54, 0x1d, 0x95, 0x04,
+  0x64, 0x5d, 0xbf, 0x5b, 0x79, 0xe2, 0xaa, 0x5a, 0xa5, 0xcb, 0x19, 0x74, 0xec, 0x8c, 0x67, 0xb5,
+  0x7d, 0x30, 0xa1, 0x63, 0x50, 0xaa, 0x7b, 0x0c, 0xa0, 0xd6, 0xe8, 0x73, 0x73, 0xc5, 0xb8, 0x40,
+  0x96, 0x61, 0x95, 0x78, 0x76, 0x68, 0x56, 0x92, 0xb5, 0x15, 0xee, 0x56, 0xae, 0x09, 0xf9, 0x66,
+  0x52, 0x37, 0xa3, 0x35, 0x1d, 0x86, 0x51, 0xcb, 0xf0, 0xe0, 0x02, 0x92, 0x2e, 0x4c, 0x30, 0x22,
+  0x48, 0xdb, 0x50, 0x49, 0x11, 0x99, 0xd1, 0xf8, 0x11, 0xef, 0x59, 0xa2, 0xc6, 0x52, 0xc1, 0x59,
+  0x07, 0xd4, 0x6d, 0x6f, 0xf3, 0xfb, 0x5b, 0xbc, 0xce, 0x6c, 0x17, 0xee, 0xd2, 0x06, 0x29, 0x50,
+  0xb1, 0x15, 0xdf, 0xb1, 0x44, 0x6d, 0x1b, 0x92, 0x88, 0x26, 0xfe, 0xdc, 0xb5, 0x86, 0x6f, 0x5c,
+  0x14, 0xd2, 0xce, 0x29, 0xd2, 0x6c, 0xbb, 0xa3, 0x6d, 0x92, 0xe7, 0xed, 0xb0, 0x15, 0xcf, 0xd9,
+  0x56, 0xb4, 0x4b, 0x18, 0x0a, 0xc3, 0x50, 0xbc, 0x07, 0xb2, 0xf6, 0xc7, 0x40, 0x2b, 0xb6, 0x01,
+  0x77, 0x33, 0xe6, 0x99, 0xeb, 0x10, 0xb4, 0x74, 0x36, 0x3f, 0xcc, 0x74, 0xff, 0xe3, 0x3b, 0xca,
+  0x24, 0xea, 0x19, 0x29, 0xb9, 0xf7, 0x7f, 0x03, 0xd5, 0xc6, 0x5a, 0xb8, 0x44, 0x70, 0xd5, 0x32,
+  0x69, 0xbe, 0x6b, 0xd6, 0xb9, 0x6a, 0xaa, 0xeb, 0x06, 0x0a, 0x5e, 0x2d, 0x7f, 0x7c, 0xff, 0xfa,
+  0x15, 0x6c, 0xc8, 0x3b, 0xfd, 0xe3, 0x8f, 0xfd, 0x4e, 0xe9, 0x20, 0x4c, 0xf3, 0xee, 0xec, 0xec,
+  0xfc, 0xac, 0xd2, 0x99, 0xe7, 0xe2, 0xb3, 0x79, 0x96, 0x0b, 0xc7, 0x43, 0xec, 0xa4, 0x69, 0x09,
+  0x69, 0xcd, 0x01, 0x65, 0xb8, 0x7d, 0x4e, 0x93, 0x9c, 0x6f, 0x83, 0x80, 0x03, 0x04, 0x53, 0x33,
+  0x17, 0x21, 0x3b, 0x36, 0x77, 0x79, 0x80, 0x23, 0x17, 0xf2, 0x7b, 0xe0, 0xa6, 0xb9, 0x1e, 0x5d,
+  0x54, 0x01, 0x88, 0xc1, 0x8f, 0xaf, 0xc3, 0xc8, 0xc5, 0x16, 0x81, 0x06, 0x42, 0xb6, 0xc7, 0x98,
+  0x8c, 0x31, 0xe2, 0x69, 0x00, 0xb6, 0x18, 0x55, 0x61, 0x59, 0x18, 0x37, 0xd9, 0x35, 0xa3, 0x52,
+  0x01, 0x84, 0x73, 0xb8, 0xc2, 0x8c, 0x40, 0xd2, 0x5c, 0x9f, 0x03, 0xe0, 0xf1, 0xe3, 0x2e, 0x9b,
+  0xdd, 0x4a, 0xe3, 0x4c, 0xc6, 0xa3, 0x8f, 0xff, 0x56, 0xaf, 0x6b, 0x45, 0x4d, 0x0b, 0xe5, 0x94,
+  0xb5, 0xe8, 0xee, 0x99, 0x7e, 0x96, 0x21, 0xd4, 0xb0, 0x2d, 0xdd, 0x77, 0x7a, 0xdb, 0x79, 0xb1,
+  0xdf, 0x44, 0x87, 0x83, 0x54, 0x17, 0xbc, 0xf9, 0xb0, 0x30, 0xa8, 0xa5, 0xd3, 0xb4, 0xdb, 0xa2,
+  0x19, 0x75, 0xbb, 0xfb, 0x0e, 0x31, 0x62, 0xbf, 0xf6, 0x8e, 0x3a, 0x83, 0x3f, 0x7a, 0x76, 0xe1,
+  0xd8, 0xb7, 0x95, 0x26, 0x01, 0x4f, 0x89, 0x3f, 0x58, 0x37, 0xd9, 0xf0, 0x66, 0xe0, 0x8d, 0x56,
+  0x0c, 0x78, 0x53, 0xbe, 0x50, 0x79, 0x18, 0xcd, 0xce, 0x86, 0x67, 0x62, 0x87, 0xaf, 0xd1, 0xc5,
+  0x99, 0x78, 0x18, 0xe3, 0x1b, 0x4a, 0x02, 0x32, 0x66, 0x08, 0xbc, 0x4d, 0x78, 0xf3, 0x63, 0xec,
+  0x67, 0xc7, 0xe8, 0xcf, 0x6a, 0xfc, 0xd3, 0xfd, 0xcc, 0x9b, 0xee, 0xaf, 0x95, 0xf8, 0x02, 0xd7,
+  0xe5, 0x06, 0x99, 0xf0, 0x17, 0xbc, 0xfb, 0x9e, 0xb0, 0xc1, 0x4c, 0x6c, 0x2a, 0xcc, 0xf9, 0xbe,
+  0x0e, 0x51, 0x41, 0x6b, 0x1a, 0x15, 0xc9, 0xcd, 0x46, 0x68, 0xc2, 0x60, 0x42, 0x1a, 0x53, 0x5c,
+  0x4d, 0xac, 0x4f, 0x74, 0x87, 0x85, 0xb1, 0x49, 0x83, 0x4c, 0xa3, 0xa8, 0x38, 0xa8, 0xf0, 0x64,
+  0xc4, 0xaa, 0xaf, 0xf6, 0xec, 0x78, 0xdc, 0x72, 0xa8, 0x67, 0x4f, 0x9e, 0xfa, 0x93, 0x9d, 0xdb,
+  0x79, 0xcc, 0x90, 0x8c, 0x1e, 0x1f, 0x13, 0x6c, 0x09, 0xa6, 0x01, 0xfc, 0x7b, 0xf4, 0x71, 0xac,
+  0xd8, 0xa8, 0x20, 0x7f, 0xbd, 0xa2, 0x6b, 0x79, 0xf9, 0x0e, 0xc7, 0xab, 0x6c, 0x89, 0x3c, 0x02,
+  0xa6, 0xc7, 0x9f, 0xc8, 0xc1, 0x38, 0x34, 0x21, 0x25, 0xa0, 0x4d, 0x3b, 0x14, 0x48, 0x3e, 0x0a,
+  0xf0, 0x19, 0xc5, 0xe5, 0x51, 0x75, 0x8c, 0x71, 0x37, 0x6b, 0x94, 0x3b, 0x7c, 0xb1, 0xae, 0xe5,
+  0xaf, 0x74, 0x75, 0xee, 0xd3, 0x9a, 0xbd, 0x85, 0x06, 0x08, 0x67, 0x32, 0x11, 0x1a, 0xb1, 0xca,
+  0xe9, 0x30, 0x7e, 0x71, 0x29, 0xd0, 0x38, 0xc1, 0xe7, 0x57, 0xec, 0xc6, 0x74, 0xeb, 0xa4, 0x66,
+  0x19, 0x6f, 0x2d, 0x7b, 0xbf, 0x3e, 0x5f, 0xf5, 0x88, 0x67, 0xeb, 0x5c, 0x52, 0x9d, 0x57, 0xaa,
+  0x2b, 0xa8, 0x6f, 0x48, 0xfc, 0x8c, 0xf6, 0xc9, 0x47, 0xc1, 0xeb, 0x3a, 0x9f, 0x6f, 0xc8, 0x70,
+  0x5f, 0x81, 0x9e, 0x57, 0x89, 0xcf, 0xe1, 0xa1, 0x25, 0x69, 0x1e, 0x5a, 0x6a, 0xa1, 0xe2, 0xd1,
+  0xac, 0x2a, 0x1c, 0x35, 0xb0, 0x9a, 0xff, 0x6d, 0xcf, 0xe0, 0x2b, 0x0b, 0xc2, 0xc1, 0x57, 0x2c,
+  0x56, 0x32, 0xcc, 0x78, 0x8c, 0x66, 0x66, 0xad, 0x92, 0x73, 0x58, 0x82, 0x90, 0x7d, 0x59, 0x14,
+  0x1a, 0x3f, 0xa9, 0x00, 0xdd, 0x40, 0xa7, 0x30, 0x94, 0xdf, 0x6f, 0x24, 0xa7, 0x3b, 0x13, 0x59,
+  0x08, 0x9d, 0x4a, 0xc1, 0x25, 0xe1, 0x87, 0xba, 0xad, 0x25, 0x41, 0xd5, 0xc5, 0x58, 0x5d, 0x5b,
+  0xc7, 0x9b, 0x67, 0xb7, 0x53, 0xc6, 0xac, 0x89, 0x4e, 0x9e, 0xb0, 0xe8, 0x9c, 0x5b, 0x91, 0xed,
+  0xed, 0x6e, 0xb5, 0x70, 0x47, 0x60, 0x28, 0x62, 0x4a, 0x34, 0x4e, 0xaa, 0x58, 0x4d, 0x21, 0x87,
+  0xd6, 0xea, 0x35, 0xec, 0xbd, 0xaf, 0xd7, 0xdd, 0x00, 0x3b, 0xc7, 0xa1, 0x12, 0x3a, 0xe8, 0x3c,
+  0x95, 0xe0, 0xb9, 0x3c, 0x72, 0x09, 0xcd, 0x77, 0x87, 0x12, 0xf9, 0xd4, 0x3d, 0x39, 0xd2, 0xd6,
+  0x5e, 0xb2, 0xbc, 0x25, 0x17, 0x34, 0x3a, 0x81, 0x1b, 0x46, 0xed, 0x9d, 0x52, 0xd7, 0xde, 0xa7,
+  0x07, 0x1a, 0x6d, 0xc5, 0xf8, 0xa8, 0x6f, 0xbc, 0xed, 0x66, 0xc9, 0x17, 0x05, 0xfd, 0xc4, 0xf2,
+  0x32, 0x33, 0xfe, 0x86, 0x4e, 0x1c, 0xf5, 0xb2, 0xad, 0x92, 0xad, 0xf5, 0x51, 0x73, 0xbd, 0xf6,
+  0xaf, 0xed, 0x0a, 0x2d, 0x67, 0xf1, 0x69, 0x7d, 0x0f, 0xac, 0xcd, 0xf2, 0xf8, 0x71, 0x35, 0x17,
+  0xba, 0x93, 0xbd, 0x2d, 0xeb, 0x4d, 0xbb, 0xef, 0xeb, 0x35, 0x1d, 0x7b, 0x2c, 0x52, 0xe0, 0x42,
+  0xbd, 0x15, 0xdb, 0xfd, 0xa6, 0x9e, 0xdd, 0x03, 0xd3, 0xd0, 0xd5, 0x82, 0x5f, 0x9f, 0x92, 0xf7,
+  0x97, 0x01, 0x89, 0x8a, 0x63, 0x79, 0x10, 0xca, 0xc8, 0x78, 0xfe, 0x8d, 0xcc, 0xfd, 0xe6, 0xe5,
+  0xf2, 0x96, 0xf3, 0xf9, 0x2e, 0x8c, 0xee, 0x97, 0x5c, 0xa1, 0x84, 0x09, 0xef, 0x34, 0xb8, 0xed,
+  0xb3, 0xcf, 0x1e, 0xde, 0xbd, 0x23, 0xff, 0x55, 0x07, 0x50, 0xeb, 0x8c, 0x85, 0x2a, 0x35, 0xd9,
+  0xe3, 0x91, 0xdb, 0x89, 0x8b, 0xeb, 0xfd, 0xad, 0x86, 0x76, 0x90, 0xf6, 0x09, 0xb6, 0x0e, 0x72,
+  0xa6, 0xef, 0xb6, 0x3d, 0x6d, 0x57, 0xf7, 0xc7, 0x83, 0x47, 0xed, 0x68, 0x41, 0x9d, 0x6e, 0x78,
+  0xa2, 0xca, 0x0c, 0x77, 0x94, 0x3d, 0x65, 0xc7, 0x79, 0x03, 0xbf, 0xeb, 0x8a, 0x6b, 0xd3, 0x1f,
+  0x8d, 0x55, 0x6b, 0x2f, 0xfe, 0xcd, 0xaf, 0xfa, 0x55, 0xcf, 0x45, 0x01, 0xe7, 0xd2, 0x89, 0xe8,
+  0x66, 0xaf, 0x34, 0xa2, 0x11, 0xb9, 0xcf, 0x25, 0x83, 0xb6, 0x5e, 0xef, 0x69, 0xd2, 0xd9, 0x3b,
+  0x28, 0x8c, 0xe3, 0x17, 0x1b, 0x3c, 0xbc, 0x82, 0xa6, 0x14, 0x35, 0xbe, 0xb7, 0x51, 0x5a, 0xdd,
+  0x29, 0x84, 0xef, 0xce, 0x92, 0xa2, 0xb4, 0x93, 0x77, 0xc1, 0xda, 0x3a, 0x79, 0xd2, 0xc1, 0xc9,
+  0xe5, 0xa5, 0xbb, 0xae, 0xf6, 0x09, 0xd6, 0xab, 0x2e, 0xca, 0xb0, 0x36, 0x1d, 0x54, 0xd7, 0x69,
+  0xd3, 0x41, 0x75, 0xd3, 0x66, 0x7f, 0xa8, 0xfd, 0x1f, 0x89, 0x81, 0x53, 0x18, 0xb9, 0x1d, 0x00,
+  0x00,
+};
+
+#endif // _DASHBOARD_H_
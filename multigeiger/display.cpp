@@ -1,4 +1,7 @@
 // OLED display related code
+//
+// we do not draw directly to the display, but compose a frame of 8x8 pixel tiles in RAM.
+// when flushing, only the tiles that differ from what is on the display are sent via I2C.
 
 #include <Arduino.h>
 #include <U8x8lib.h>
@@ -6,6 +9,9 @@
 #include "version.h"
 #include "log.h"
 #include "userdefines.h"
+#include "metrics.h"
+#include "history.h"
+#include "sparkline.h"
 
 #include "display.h"
 
@@ -22,27 +28,98 @@ U8X8 *pu8x8;
 bool displayIsClear;
 static bool isLoraBoard;
 
+// frame being composed and what is currently shown on the display, in tiles
+#define TILE_COLS 16
+#define TILE_ROWS 8
+static uint8_t frame[TILE_ROWS][TILE_COLS][8];
+static uint8_t shown[TILE_ROWS][TILE_COLS][8];
+
+// render a string into the frame, same as U8X8::drawString does on the display.
+// u8x8 fonts: first char, last char, glyph width and height [tiles], then 8 bytes per tile.
+static void draw_text(int x, int y, const uint8_t *font, const char *s) {
+  uint8_t first = pgm_read_byte(font), last = pgm_read_byte(font + 1);
+  uint8_t tw = pgm_read_byte(font + 2), th = pgm_read_byte(font + 3);
+  for (; *s; s++, x += tw) {
+    uint8_t c = *s;
+    for (int ty = 0; ty < th; ty++) {
+      for (int tx = 0; tx < tw; tx++) {
+        if ((x + tx >= TILE_COLS) || (y + ty >= TILE_ROWS))
+          continue;
+        uint8_t *tile = frame[y + ty][x + tx];
+        if ((c < first) || (c > last)) {
+          memset(tile, 0, 8);
+          continue;
+        }
+        const uint8_t *src = font + 4 + ((c - first) * tw * th + ty * tw + tx) * 8;
+        for (int i = 0; i < 8; i++)
+          tile[i] = pgm_read_byte(src + i);
+      }
+    }
+  }
+}
+
+// sparkline of the per-minute count history, right of the CPM digits (128x64 display only)
+#define SPARKLINE_COL 10
+#define SPARKLINE_ROW 2
+#define SPARKLINE_WIDTH ((TILE_COLS - SPARKLINE_COL) * 8)  // [pixels] == minutes shown
+#define SPARKLINE_PAGES 5
+
+#if SPARKLINE_WIDTH > HISTORY_RECENT_MINUTES
+#error "the sparkline needs more minutes than history.cpp keeps in RAM"
+#endif
+
+static void draw_sparkline(void) {
+  static uint32_t values[SPARKLINE_WIDTH];
+  int count = history_recent_minutes(values, SPARKLINE_WIDTH);
+  render_sparkline(values, count, frame[SPARKLINE_ROW][SPARKLINE_COL], SPARKLINE_WIDTH, SPARKLINE_PAGES,
+                   sizeof(frame[0]));
+}
+
+static void clear_frame(void) {
+  memset(frame, 0, sizeof(frame));
+}
+
+// send the changed tiles to the display, adjacent ones with a single transfer.
+static void flush_display(void) {
+  // a partial refresh takes only a few ms, so measure it in us
+  unsigned long start_us = micros();
+  int tiles = 0;
+  for (int y = 0; y < TILE_ROWS; y++) {
+    int x = 0;
+    while (x < TILE_COLS) {
+      if (memcmp(frame[y][x], shown[y][x], 8) == 0) {
+        x++;
+        continue;
+      }
+      int start = x;
+      while ((x < TILE_COLS) && (memcmp(frame[y][x], shown[y][x], 8) != 0))
+        x++;
+      pu8x8->drawTile(start, y, x - start, frame[y][start]);
+      memcpy(shown[y][start], frame[y][start], (x - start) * 8);
+      tiles += x - start;
+    }
+  }
+  metrics_display(tiles * 8, micros() - start_us);
+}
+
 void display_start_screen(void) {
   char line[20];
 
-  pu8x8->clear();
+  clear_frame();
 
   if (isLoraBoard) {
-    pu8x8->setFont(u8x8_font_amstrad_cpc_extended_f);
-    pu8x8->drawString(0, 2, " Multi-");
-    pu8x8->drawString(0, 3, " Geiger");
-    pu8x8->setFont(u8x8_font_victoriamedium8_r);
+    draw_text(0, 2, u8x8_font_amstrad_cpc_extended_f, " Multi-");
+    draw_text(0, 3, u8x8_font_amstrad_cpc_extended_f, " Geiger");
     snprintf(line, 9, "%s", VERSION_STR);  // 8 chars + \0 termination
-    pu8x8->drawString(0, 4, line);
+    draw_text(0, 4, u8x8_font_victoriamedium8_r, line);
   } else {
-    pu8x8->setFont(u8x8_font_amstrad_cpc_extended_f);
-    pu8x8->drawString(0, 0, "  Multi-Geiger");
-    pu8x8->setFont(u8x8_font_victoriamedium8_r);
-    pu8x8->drawString(0, 1, "________________");
-    pu8x8->drawString(0, 3, "Info:boehri.de");
+    draw_text(0, 0, u8x8_font_amstrad_cpc_extended_f, "  Multi-Geiger");
+    draw_text(0, 1, u8x8_font_victoriamedium8_r, "________________");
+    draw_text(0, 3, u8x8_font_victoriamedium8_r, "Info:boehri.de");
     snprintf(line, 15, "%s", VERSION_STR);  // 14 chars + \0 termination
-    pu8x8->drawString(0, 5, line);
+    draw_text(0, 5, u8x8_font_victoriamedium8_r, line);
   }
+  flush_display();
   displayIsClear = false;
 };
 
@@ -57,28 +134,36 @@ void setup_display(bool loraHardware) {
   } else {
     pu8x8 = &u8x8;
   }
-  pu8x8->begin();
+  pu8x8->begin();  // this also clears the display, so it matches our (empty) shown tiles
   display_start_screen();
 }
 
+void display_power(bool on) {
+  pu8x8->setPowerSave(on ? 0 : 1);
+}
+
 void clear_displayline(int line) {
-  const char *blanks;
-  blanks = isLoraBoard ? "        " : "                ";  // 8 / 16
-  pu8x8->drawString(0, line, blanks);
+  if ((line >= 0) && (line < TILE_ROWS))
+    memset(frame[line], 0, sizeof(frame[line]));
+}
+
+static void draw_statusline(const char *txt) {
+  int line = isLoraBoard ? 5 : 7;
+  clear_displayline(line);
+  draw_text(0, line, u8x8_font_victoriamedium8_r, txt);
 }
 
 void display_statusline(String txt) {
   if (txt.length() == 0)
     return;
-  int line = isLoraBoard ? 5 : 7;
-  pu8x8->setFont(u8x8_font_victoriamedium8_r);
-  clear_displayline(line);
-  pu8x8->drawString(0, line, txt.c_str());
+  draw_statusline(txt.c_str());
+  flush_display();
 }
 
 static int status[STATUS_MAX] = {ST_NODISPLAY, ST_NODISPLAY, ST_NODISPLAY, ST_NODISPLAY,
                                  ST_NODISPLAY, ST_NODISPLAY, ST_NODISPLAY, ST_NODISPLAY
                                 };  // current status of misc. subsystems
+static bool status_dirty = false;  // status changed, but not yet shown on the display
 
 static const char *status_chars[STATUS_MAX] = {
   // group WiFi and transmission to internet servers
@@ -89,17 +174,18 @@ static const char *status_chars[STATUS_MAX] = {
   ".t3T?",  // ST_TTN_OFF, ST_TTN_IDLE, ST_TTN_ERROR, ST_TTN_SENDING, ST_TTN_INIT
   // group BlueTooth
   ".B4b?",  // ST_BLE_OFF, ST_BLE_CONNECTED, ST_BLE_ERROR, ST_BLE_CONNECTABLE, ST_BLE_INIT
+  // group MQTT
+  ".q5Q?",  // ST_MQTT_OFF, ST_MQTT_IDLE, ST_MQTT_ERROR, ST_MQTT_SENDING, ST_MQTT_INIT
   // group other
   ".",      // ST_NODISPLAY
-  ".",      // ST_NODISPLAY
-  ".H7",    // ST_NODISPLAY, ST_HV_OK, ST_HV_ERROR
+  ".H7h",   // ST_NODISPLAY, ST_HV_OK, ST_HV_ERROR, ST_HV_DEGRADED
 };
 
 void set_status(int index, int value) {
   if ((index >= 0) && (index < STATUS_MAX)) {
     if (status[index] != value) {
       status[index] = value;
-      display_status();
+      status_dirty = true;
     }
   } else
     log(ERROR, "invalid parameters: set_status(%d, %d)", index, value);
@@ -121,6 +207,11 @@ char get_status_char(int index) {
   return '?';  // some error happened
 }
 
+void flush_status(void) {
+  if (status_dirty)
+    display_status();
+}
+
 void display_status(void) {
   char output[17];  // max. 16 chars wide display + \0 terminator
   const char *format = isLoraBoard ? "%c%c%c%c%c%c%c%c" : "%c %c %c %c %c %c %c %c";  // 8 or 16 chars wide
@@ -129,6 +220,7 @@ void display_status(void) {
            get_status_char(4), get_status_char(5), get_status_char(6), get_status_char(7)
           );
   display_statusline(output);
+  status_dirty = false;
 }
 
 char *format_time(unsigned int secs) {
@@ -149,34 +241,34 @@ char *format_time(unsigned int secs) {
   return result;
 }
 
-void display_GMC(unsigned int TimeSec, int RadNSvph, int CPM, bool use_display) {
+void display_GMC(unsigned int TimeSec, int RadNSvph, int CPM, bool use_display, bool show_sparkline) {
   if (!use_display) {
     if (!displayIsClear) {
-      pu8x8->clear();
-      clear_displayline(4);
-      clear_displayline(5);
+      clear_frame();
+      flush_display();
       displayIsClear = true;
     }
     return;
   }
 
-  pu8x8->clear();
+  clear_frame();
 
   char output[40];
   if (!isLoraBoard) {
-    pu8x8->setFont(u8x8_font_7x14_1x2_f);
     sprintf(output, "%3s%7d nSv/h", format_time(TimeSec), RadNSvph);
-    pu8x8->drawString(0, 0, output);
-    pu8x8->setFont(u8x8_font_inb33_3x6_n);
+    draw_text(0, 0, u8x8_font_7x14_1x2_f, output);
     sprintf(output, "%5d", CPM);
-    pu8x8->drawString(0, 2, output);
+    if (show_sparkline) {
+      draw_text(0, 3, u8x8_font_px437wyse700b_2x2_f, output);
+      draw_text(7, 5, u8x8_font_victoriamedium8_r, "cpm");
+      draw_sparkline();
+    } else
+      draw_text(0, 2, u8x8_font_inb33_3x6_n, output);
   } else {
-    pu8x8->setFont(u8x8_font_amstrad_cpc_extended_f);
     sprintf(output, " %7d", RadNSvph);
-    pu8x8->drawString(0, 2, output);
-    pu8x8->setFont(u8x8_font_px437wyse700b_2x2_f);
+    draw_text(0, 2, u8x8_font_amstrad_cpc_extended_f, output);
     sprintf(output, "%4d", CPM);
-    pu8x8->drawString(0, 3, output);
+    draw_text(0, 3, u8x8_font_px437wyse700b_2x2_f, output);
   }
   display_status();
   displayIsClear = false;
@@ -4,8 +4,10 @@
 #define _DISPLAY_H_
 
 void setup_display(bool loraHardware);
-void display_GMC(unsigned int TimeSec, int RadNSvph, int CPM, bool use_display);
+// show_sparkline: smaller digits and a sparkline of the count history (128x64 display only)
+void display_GMC(unsigned int TimeSec, int RadNSvph, int CPM, bool use_display, bool show_sparkline);
 void clear_displayline(int line);
+void display_power(bool on);
 void display_statusline(String txt);
 
 // supported status indexes and values:
@@ -51,18 +53,27 @@ void display_statusline(String txt);
 #define ST_BLE_CONNECTABLE 3
 #define ST_BLE_INIT 4
 
-// status index 5 is still free
+#define STATUS_MQTT 5
+#define ST_MQTT_OFF 0
+#define ST_MQTT_IDLE 1
+#define ST_MQTT_ERROR 2
+#define ST_MQTT_SENDING 3
+#define ST_MQTT_INIT 4
 
 // status index 6 is still free
 
 #define STATUS_HV 7
 #define ST_HV_OK 1
 #define ST_HV_ERROR 2
+#define ST_HV_DEGRADED 3  // still ok, but HV health analysis predicts a failure
 
 #define STATUS_MAX 8
 
+// set_status only records the new status, the status line gets updated on the display
+// with the next display_GMC() or flush_status(), so multiple changes cost one I2C update.
 void set_status(int index, int value);
 int get_status(int index);
 void display_status(void);
+void flush_status(void);  // update the status line, if some status changed
 
 #endif // _DISPLAY_H_
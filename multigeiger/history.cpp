@@ -0,0 +1,471 @@
+// measurement history database with 3 tiers of decreasing resolution, see history.h
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "platform.h"
+#include "log.h"
+#include "history.h"
+
+#define HISTORY_MAGIC 0x54534948  // "HIST"
+#define HISTORY_VERSION 1
+#define HISTORY_META "/hist/meta"
+
+// columns of the flash tiers, one file each: /hist/<tier prefix>_<column>
+#define COL_TIME 0
+#define COL_COUNTS 1
+#define COL_TEMPERATURE 2  // int16, 0.01 C
+#define COL_HUMIDITY 3     // uint16, 0.01 %
+#define COL_PRESSURE 4     // uint16, 10 Pa
+#define COL_MINUTES 5      // uint8, hours tier only
+#define COLUMNS 6
+
+static const char *column_names[COLUMNS] = {"time", "counts", "temp", "humi", "press", "min"};
+static const uint8_t column_size[COLUMNS] = {4, 4, 2, 2, 2, 1};
+
+#define NO_TEMPERATURE -32768  // no THP data
+#define NO_VALUE 0xFFFF
+
+// records read from flash at once (buffers are on the stack of the reading task)
+#define READ_CHUNK HISTORY_READ_CHUNK
+
+// SPIFFS needs free space for its garbage collection and metadata, so we use at most this much of it.
+#define FS_USABLE_PERCENT 70
+
+// fewer records per flash tier are of no use (and the ring buffers need at least 2)
+#define MIN_FLASH_RECORDS 2
+
+typedef struct {
+  char prefix;
+  uint32_t max_records;  // if the filesystem is large enough
+  int columns;
+  uint32_t records;
+  uint32_t next_seq;
+} FlashTier;
+
+static FlashTier flash_tiers[2] = {
+  {'m', HISTORY_MINUTES_RECORDS, COL_MINUTES, 0, 0},
+  {'h', HISTORY_HOURS_RECORDS, COLUMNS, 0, 0},
+};
+
+typedef struct {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t records[2];
+  uint32_t next_seq[2];
+} Meta;
+
+// seconds tier, in RAM
+static uint16_t second_counts[HISTORY_SECONDS_RECORDS];
+static uint32_t second_next_seq = 0;
+static uint32_t second_last_time = 0;  // time of the newest record
+
+// counts of the newest minutes, also in RAM: cheap to read, and there without flash, too
+static uint32_t recent_minutes[HISTORY_RECENT_MINUTES];
+static uint32_t recent_minutes_total = 0;  // minutes recorded since boot
+
+// intervals being downsampled into the next minute / hour record
+typedef struct {
+  uint32_t time;  // end of the last interval added
+  uint32_t counts;
+  uint32_t thp_samples;
+  float temperature, humidity, pressure;  // sums
+  uint8_t parts;  // seconds / minutes added
+} Accu;
+
+static Accu minute, hour;
+static bool flash_ok = false;
+
+// history_sample runs in the loop task, readers also in other tasks (e.g. BLE)
+static hal_mux_t mux_history = HAL_MUX_INITIALIZER;
+
+static FlashTier *flash_tier(int tier) {
+  return &flash_tiers[tier - HISTORY_MINUTES];
+}
+
+static void column_path(char *path, const FlashTier *ft, int col) {
+  snprintf(path, 24, "/hist/%c_%s", ft->prefix, column_names[col]);
+}
+
+static void write_meta(void) {
+  Meta meta;
+  meta.magic = HISTORY_MAGIC;
+  meta.version = HISTORY_VERSION;
+  for (int i = 0; i < 2; i++) {
+    meta.records[i] = flash_tiers[i].records;
+    meta.next_seq[i] = flash_tiers[i].next_seq;
+  }
+  hal_fs_write(HISTORY_META, 0, &meta, sizeof(meta));
+}
+
+static void reset_flash_tier(FlashTier *ft) {
+  char path[24];
+  for (int col = 0; col < ft->columns; col++) {
+    column_path(path, ft, col);
+    hal_fs_remove(path);
+  }
+  hal_enter_critical(&mux_history);
+  ft->next_seq = 0;
+  hal_exit_critical(&mux_history);
+}
+
+static uint32_t record_size(const FlashTier *ft) {
+  uint32_t size = 0;
+  for (int col = 0; col < ft->columns; col++)
+    size += column_size[col];
+  return size;
+}
+
+// shrink both flash tiers by the same factor, if they do not fit into the filesystem.
+// returns false if the filesystem is too small for them.
+static bool size_flash_tiers(void) {
+  uint64_t budget = (uint64_t)hal_fs_size() * FS_USABLE_PERCENT / 100, needed = 0;
+  for (int i = 0; i < 2; i++)
+    needed += (uint64_t)flash_tiers[i].max_records * record_size(&flash_tiers[i]);
+  for (int i = 0; i < 2; i++)
+    flash_tiers[i].records = (needed > budget) ? flash_tiers[i].max_records * budget / needed : flash_tiers[i].max_records;
+  for (int i = 0; i < 2; i++)
+    if (flash_tiers[i].records < MIN_FLASH_RECORDS) {
+      log(ERROR, "History: flash filesystem too small (%u bytes), keeping the seconds tier only", (unsigned)hal_fs_size());
+      return false;
+    }
+  if (needed > budget)
+    log(WARNING, "History: flash filesystem too small, keeping %.1f days of minutes and %.1f days of hours",
+        flash_tiers[0].records / 1440.0, flash_tiers[1].records / 24.0);
+  return true;
+}
+
+void setup_history(void) {
+  flash_ok = false;
+  if (!hal_fs_mount()) {
+    log(ERROR, "History: could not mount the flash filesystem, keeping the seconds tier only");
+    return;
+  }
+  if (!size_flash_tiers())
+    return;
+  Meta meta;
+  bool valid = (hal_fs_read(HISTORY_META, 0, &meta, sizeof(meta)) == sizeof(meta)) &&
+               (meta.magic == HISTORY_MAGIC) && (meta.version == HISTORY_VERSION);
+  for (int i = 0; i < 2; i++) {
+    if (valid && (meta.records[i] == flash_tiers[i].records))
+      flash_tiers[i].next_seq = meta.next_seq[i];
+    else
+      reset_flash_tier(&flash_tiers[i]);
+  }
+  write_meta();
+  flash_ok = true;
+  log(INFO, "History: %u minute and %u hour records in flash",
+      history_next_seq(HISTORY_MINUTES) - history_first_seq(HISTORY_MINUTES),
+      history_next_seq(HISTORY_HOURS) - history_first_seq(HISTORY_HOURS));
+}
+
+static void put_le(uint8_t *buf, uint32_t value, int len) {
+  for (int i = 0; i < len; i++)
+    buf[i] = (value >> (8 * i)) & 0xFF;
+}
+
+static uint32_t get_le(const uint8_t *buf, int len) {
+  uint32_t value = 0;
+  for (int i = 0; i < len; i++)
+    value |= (uint32_t)buf[i] << (8 * i);
+  return value;
+}
+
+static uint32_t encode(const HistoryRecord *r, int col) {
+  switch (col) {
+  case COL_TIME:
+    return r->time;
+  case COL_COUNTS:
+    return r->counts;
+  case COL_TEMPERATURE:
+    return isnan(r->temperature) ? (uint16_t)NO_TEMPERATURE : (uint16_t)(int16_t)lroundf(r->temperature * 100);
+  case COL_HUMIDITY:
+    return isnan(r->humidity) ? NO_VALUE : (uint16_t)lroundf(r->humidity * 100);
+  case COL_PRESSURE:
+    return isnan(r->pressure) ? NO_VALUE : (uint16_t)lroundf(r->pressure / 10);
+  case COL_MINUTES:
+    return r->minutes;
+  }
+  return 0;
+}
+
+static void decode(HistoryRecord *r, int col, uint32_t value) {
+  switch (col) {
+  case COL_TIME:
+    r->time = value;
+    break;
+  case COL_COUNTS:
+    r->counts = value;
+    break;
+  case COL_TEMPERATURE:
+    r->temperature = ((int16_t)value == NO_TEMPERATURE) ? NAN : (int16_t)value / 100.0;
+    break;
+  case COL_HUMIDITY:
+    r->humidity = (value == NO_VALUE) ? NAN : value / 100.0;
+    break;
+  case COL_PRESSURE:
+    r->pressure = (value == NO_VALUE) ? NAN : value * 10.0;
+    break;
+  case COL_MINUTES:
+    r->minutes = value;
+    break;
+  }
+}
+
+static void append_flash(int tier, const HistoryRecord *r) {
+  if (!flash_ok)
+    return;
+  FlashTier *ft = flash_tier(tier);
+  uint32_t index = ft->next_seq % ft->records;
+  char path[24];
+  uint8_t value[4];
+  for (int col = 0; col < ft->columns; col++) {
+    column_path(path, ft, col);
+    put_le(value, encode(r, col), column_size[col]);
+    if (hal_fs_write(path, index * column_size[col], value, column_size[col]) != column_size[col]) {
+      log(WARNING, "History: could not write %s, resetting the %c tier", path, ft->prefix);
+      reset_flash_tier(ft);
+      write_meta();
+      return;
+    }
+  }
+  hal_enter_critical(&mux_history);
+  ft->next_seq++;
+  hal_exit_critical(&mux_history);
+  write_meta();
+}
+
+static void accu_add(Accu *a, uint32_t time, uint32_t counts, uint32_t thp_samples, float t, float h, float p) {
+  a->time = time;
+  a->counts += counts;
+  a->thp_samples += thp_samples;
+  a->temperature += t;
+  a->humidity += h;
+  a->pressure += p;
+  a->parts++;
+}
+
+static void accu_record(const Accu *a, HistoryRecord *r) {
+  r->time = a->time;
+  r->counts = a->counts;
+  r->minutes = 0;
+  r->temperature = a->thp_samples ? a->temperature / a->thp_samples : NAN;
+  r->humidity = a->thp_samples ? a->humidity / a->thp_samples : NAN;
+  r->pressure = a->thp_samples ? a->pressure / a->thp_samples : NAN;
+}
+
+static void close_hour(void) {
+  HistoryRecord r;
+  accu_record(&hour, &r);
+  r.minutes = hour.parts;
+  if (r.time)
+    r.time = ((r.time - 1) / 3600 + 1) * 3600;  // end of the hour
+  append_flash(HISTORY_HOURS, &r);
+  memset(&hour, 0, sizeof(hour));
+}
+
+static void close_minute(void) {
+  HistoryRecord r;
+  accu_record(&minute, &r);
+  hal_enter_critical(&mux_history);
+  recent_minutes[recent_minutes_total % HISTORY_RECENT_MINUTES] = r.counts;
+  recent_minutes_total++;
+  hal_exit_critical(&mux_history);
+  append_flash(HISTORY_MINUTES, &r);
+  // hours follow the clock (if it is set), so a new minute might belong to the next hour
+  if (hour.parts && ((hour.parts >= 60) ||
+                     (r.time && hour.time && ((r.time - 1) / 3600 != (hour.time - 1) / 3600))))
+    close_hour();
+  accu_add(&hour, r.time, minute.counts, minute.thp_samples, minute.temperature, minute.humidity, minute.pressure);
+  memset(&minute, 0, sizeof(minute));
+}
+
+static void add_second(uint32_t time, uint32_t counts, bool have_thp, float t, float h, float p) {
+  hal_enter_critical(&mux_history);
+  second_counts[second_next_seq % HISTORY_SECONDS_RECORDS] = (counts < 0xFFFF) ? counts : 0xFFFF;
+  second_next_seq++;
+  second_last_time = time;
+  hal_exit_critical(&mux_history);
+  if (have_thp)
+    accu_add(&minute, time, counts, 1, t, h, p);
+  else
+    accu_add(&minute, time, counts, 0, 0, 0, 0);
+  if (minute.parts >= 60)
+    close_minute();
+}
+
+void history_sample(unsigned long current_ms, uint32_t time, unsigned long counts,
+                    bool have_thp, float temperature, float humidity, float pressure) {
+  static unsigned long last_ms = current_ms, last_counts = counts;
+  unsigned long seconds = (current_ms - last_ms) / 1000;
+  if (!seconds)
+    return;
+  if (seconds > HISTORY_SECONDS_RECORDS) {
+    last_ms += (seconds - HISTORY_SECONDS_RECORDS) * 1000;
+    seconds = HISTORY_SECONDS_RECORDS;
+  }
+  // if the loop was late, spread the counts evenly over the missed seconds
+  unsigned long delta = counts - last_counts;
+  for (unsigned long i = 0; i < seconds; i++) {
+    uint32_t share = delta * (i + 1) / seconds - delta * i / seconds;
+    add_second(time ? time - (seconds - 1 - i) : 0, share, have_thp, temperature, humidity, pressure);
+  }
+  last_ms += seconds * 1000;
+  last_counts = counts;
+}
+
+static bool valid_tier(int tier) {
+  return (tier >= 0) && (tier < HISTORY_TIERS);
+}
+
+static uint32_t tier_records(int tier) {
+  // of the flash tiers, the oldest record might be getting overwritten right now, so it is not available.
+  if (tier == HISTORY_SECONDS)
+    return HISTORY_SECONDS_RECORDS;
+  return flash_ok ? flash_tier(tier)->records - 1 : 0;
+}
+
+uint32_t history_next_seq(int tier) {
+  if (!valid_tier(tier))
+    return 0;
+  hal_enter_critical(&mux_history);
+  uint32_t next = (tier == HISTORY_SECONDS) ? second_next_seq : flash_tier(tier)->next_seq;
+  hal_exit_critical(&mux_history);
+  return next;
+}
+
+uint32_t history_first_seq(int tier) {
+  if (!valid_tier(tier))
+    return 0;
+  uint32_t next = history_next_seq(tier);
+  return (next > tier_records(tier)) ? next - tier_records(tier) : 0;
+}
+
+int history_recent_minutes(uint32_t *counts, int max_count) {
+  if (max_count > HISTORY_RECENT_MINUTES)
+    max_count = HISTORY_RECENT_MINUTES;
+  hal_enter_critical(&mux_history);
+  int count = (recent_minutes_total < (uint32_t)max_count) ? recent_minutes_total : max_count;
+  for (int i = 0; i < count; i++)
+    counts[i] = recent_minutes[(recent_minutes_total - count + i) % HISTORY_RECENT_MINUTES];
+  hal_exit_critical(&mux_history);
+  return count;
+}
+
+static int read_seconds(uint32_t seq, HistoryRecord *dest, int count) {
+  hal_enter_critical(&mux_history);
+  for (int i = 0; i < count; i++, seq++) {
+    dest[i].time = second_last_time ? second_last_time - (second_next_seq - 1 - seq) : 0;
+    dest[i].counts = second_counts[seq % HISTORY_SECONDS_RECORDS];
+    dest[i].minutes = 0;
+    dest[i].temperature = dest[i].humidity = dest[i].pressure = NAN;
+  }
+  hal_exit_critical(&mux_history);
+  return count;
+}
+
+// read one column of count (<= READ_CHUNK) records, returns false on read errors
+static bool read_column(const FlashTier *ft, int col, uint32_t seq, int count, uint8_t *buf) {
+  char path[24];
+  column_path(path, ft, col);
+  int size = column_size[col];
+  uint32_t index = seq % ft->records;
+  int first = (index + count <= ft->records) ? count : ft->records - index;  // ring buffer wraps around
+  if (hal_fs_read(path, index * size, buf, first * size) != (size_t)(first * size))
+    return false;
+  if ((first < count) && (hal_fs_read(path, 0, buf + first * size, (count - first) * size) != (size_t)((count - first) * size)))
+    return false;
+  return true;
+}
+
+static int read_flash(int tier, uint32_t seq, HistoryRecord *dest, int count) {
+  const FlashTier *ft = flash_tier(tier);
+  uint8_t buf[READ_CHUNK * 4];
+  for (int i = 0; i < count; i++) {
+    dest[i].minutes = 0;
+    dest[i].temperature = dest[i].humidity = dest[i].pressure = NAN;
+  }
+  for (int col = 0; col < ft->columns; col++) {
+    if (!read_column(ft, col, seq, count, buf))
+      return 0;
+    for (int i = 0; i < count; i++)
+      decode(&dest[i], col, get_le(buf + i * column_size[col], column_size[col]));
+  }
+  return count;
+}
+
+int history_read(int tier, uint32_t *seq, HistoryRecord *dest, int max_count) {
+  if (!valid_tier(tier) || ((tier != HISTORY_SECONDS) && !flash_ok))
+    return 0;
+  uint32_t first = history_first_seq(tier), next = history_next_seq(tier);
+  if (*seq < first)
+    *seq = first;
+  int count = 0;
+  while ((count < max_count) && (*seq + count < next)) {
+    int n = max_count - count;
+    if (n > READ_CHUNK)
+      n = READ_CHUNK;
+    if ((uint32_t)n > next - (*seq + count))
+      n = next - (*seq + count);
+    if (tier == HISTORY_SECONDS)
+      n = read_seconds(*seq + count, dest + count, n);
+    else
+      n = read_flash(tier, *seq + count, dest + count, n);
+    if (!n)
+      break;
+    count += n;
+  }
+  // records which got overwritten while we were reading are not valid
+  first = history_first_seq(tier);
+  if (*seq < first) {
+    int drop = ((first - *seq) < (uint32_t)count) ? first - *seq : count;
+    memmove(dest, dest + drop, (count - drop) * sizeof(HistoryRecord));
+    count -= drop;
+    *seq = first;
+  }
+  return count;
+}
+
+int history_query(int tier, uint32_t from, uint32_t to, uint32_t *seq, HistoryRecord *dest, int max_count) {
+  // only the time column gets scanned, complete records are read for the matching ones only.
+  HistoryRecord chunk[READ_CHUNK];
+  uint32_t times[READ_CHUNK];
+  uint8_t buf[READ_CHUNK * 4];
+  int count = 0;
+  if (!valid_tier(tier))
+    return 0;
+  while (count < max_count) {
+    uint32_t first = history_first_seq(tier), next = history_next_seq(tier);
+    if (*seq < first)
+      *seq = first;
+    if (*seq >= next)
+      break;
+    int n = (next - *seq < READ_CHUNK) ? next - *seq : READ_CHUNK;
+    if (tier == HISTORY_SECONDS) {
+      n = read_seconds(*seq, chunk, n);
+      for (int i = 0; i < n; i++)
+        times[i] = chunk[i].time;
+    } else {
+      if (!flash_ok || !read_column(flash_tier(tier), COL_TIME, *seq, n, buf))
+        break;
+      for (int i = 0; i < n; i++)
+        times[i] = get_le(buf + i * 4, 4);
+    }
+    int i = 0;
+    while ((i < n) && (count < max_count)) {
+      while ((i < n) && ((times[i] < from) || (times[i] >= to)))
+        i++;
+      int j = i;
+      while ((j < n) && (times[j] >= from) && (times[j] < to) && (j - i < max_count - count))
+        j++;
+      if (j > i) {
+        uint32_t s = *seq + i;
+        count += history_read(tier, &s, dest + count, j - i);
+      }
+      i = j;
+    }
+    *seq += i;
+  }
+  return count;
+}
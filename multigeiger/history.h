@@ -0,0 +1,72 @@
+// measurement history database with 3 tiers of decreasing resolution (like RRD):
+//
+// tier      resolution  kept for  columns                                   storage
+// seconds   1s          1 hour    counts                                    RAM
+// minutes   1min        1 week    time, counts, temperature, humidity,     flash (SPIFFS)
+//                                 pressure
+// hours     1h          1 year    same as minutes, plus minutes             flash (SPIFFS)
+//
+// every tier is a ring buffer, stored column-wise (one file per column), the coarser tiers
+// are downsampled from the finer ones while the data comes in. the flash tiers survive
+// reboots, the seconds tier and the partial minute / hour do not.
+//
+// budget: RAM: 7.2kB (seconds counts) + 192B (counts of the last 48 minutes) + ~100B. flash: minutes 10080 * 14B = 141kB,
+// hours 8760 * 15B = 131kB, plus SPIFFS overhead, so ~400kB of the SPIFFS partition.
+// if the partition is smaller (e.g. "Minimal SPIFFS": 190kB), both flash tiers keep
+// proportionally less time (about 3 days of minutes and 5 months of hours there).
+
+#ifndef _HISTORY_H_
+#define _HISTORY_H_
+
+#include <stdint.h>
+
+#define HISTORY_SECONDS 0
+#define HISTORY_MINUTES 1
+#define HISTORY_HOURS 2
+#define HISTORY_TIERS 3
+
+// records per tier (the flash tiers might get less, see above)
+#define HISTORY_SECONDS_RECORDS 3600
+#define HISTORY_MINUTES_RECORDS (7 * 1440)
+#define HISTORY_HOURS_RECORDS (365 * 24)
+
+// records read from flash at once (per column file), the best batch size for history_read()
+#define HISTORY_READ_CHUNK 32
+
+// the counts of this many minutes are also kept in RAM, see history_recent_minutes()
+#define HISTORY_RECENT_MINUTES 48
+
+typedef struct {
+  uint32_t time;  // [s] since epoch, end of the interval, 0 = unknown (clock was not set)
+  uint32_t counts;  // GM counts within the interval
+  uint8_t minutes;  // hours tier: minutes recorded within the hour (e.g. less after a reboot), else 0
+  float temperature, humidity, pressure;  // mean within the interval, NAN = no data (or seconds tier)
+} HistoryRecord;
+
+// mount the flash filesystem and open the flash tiers (formats them if missing / changed).
+void setup_history(void);
+
+// call regularly from loop(). time: [s] since epoch, 0 if the clock is not set.
+void history_sample(unsigned long current_ms, uint32_t time, unsigned long counts,
+                    bool have_thp, float temperature, float humidity, float pressure);
+
+// records get consecutive sequence numbers (per tier), the available range is [first, next).
+uint32_t history_first_seq(int tier);
+uint32_t history_next_seq(int tier);
+
+// copy up to max_count records starting at *seq into records, returns the amount copied.
+// if *seq is older than the oldest available record, *seq is advanced to that record.
+// can be called from any task.
+int history_read(int tier, uint32_t *seq, HistoryRecord *records, int max_count);
+
+// copy the counts of the newest (up to max_count) minutes into counts, oldest first, returns
+// the amount copied. from RAM, so cheap (e.g. for every display refresh) and also without flash.
+int history_recent_minutes(uint32_t *counts, int max_count);
+
+// range query: copy up to max_count records with from <= time < to, starting the search
+// at *seq (use history_first_seq() for the first call). *seq returns where to continue.
+// the time column is scanned in chunks of HISTORY_READ_CHUNK records, so batches of that
+// size avoid reading the same chunk again in the next call.
+int history_query(int tier, uint32_t from, uint32_t to, uint32_t *seq, HistoryRecord *records, int max_count);
+
+#endif // _HISTORY_H_
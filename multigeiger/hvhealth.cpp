@@ -0,0 +1,240 @@
+// HV subsystem health: tracks the HV charging per hour to detect a degrading HV capacitor
+// or diode (increasing leak current) long before charging fails completely.
+//
+// The HV capacitor loses its charge by leak currents (capacitor, diode, PCB, humidity),
+// the recharging replaces that, so the charge pulses per hour are a measure of the leak.
+// Leak currents grow with temperature (about 2x per 10 deg C), so we compensate that.
+// We compare the recent leak with a baseline taken after the first boot, extrapolate its trend
+// and also watch the max. charge pulses of one charge cycle (normally 1 or 2, charging fails
+// at MAX_CHARGE_PULSES). The baseline and the recent hours are saved to NVS every hour, so
+// a reboot (or a firmware update) does not start the analysis from scratch.
+
+#include <Arduino.h>
+#include <math.h>
+#include <string.h>
+
+#include "log.h"
+#include "platform.h"
+#include "tube.h"
+#include "hvhealth.h"
+
+#define HV_HEALTH_INTERVAL 3600000  // [ms], 1 bucket per hour
+#define HV_HEALTH_HOURS 168  // 7 days of buckets
+#define HV_HEALTH_SKIP_HOURS 1  // ignore the 1st hour after boot (initial charging)
+#define HV_HEALTH_BASELINE_HOURS 24  // baseline: mean of the next 24 hours
+#define HV_HEALTH_RECENT_HOURS 6  // recent: mean of the last 6 hours
+#define HV_HEALTH_TREND_HOURS 72  // trend: linear regression over the last 3 days
+
+#define HV_DEGRADED_RATIO 4.0  // recent leak is 4x the baseline
+#define HV_DEGRADED_DAYS 3.0  // trend reaches HV_DEGRADED_RATIO within 3 days
+#define HV_DEGRADED_CYCLE_PULSES 300  // ~10% of MAX_CHARGE_PULSES needed for one charge cycle
+
+#define REFERENCE_TEMPERATURE 25.0  // [deg C], leak is compensated to this temperature
+
+#define HV_HEALTH_NVS_NAMESPACE "hvhealth"
+#define HV_HEALTH_NVS_KEY "state"
+#define HV_HEALTH_MAGIC 0x4856  // change this if the layout of HvState changes
+#define HV_HEALTH_SAVED_HOURS HV_HEALTH_TREND_HOURS  // the buckets the trend needs, keeps the blob < 1 kB
+
+typedef struct {
+  uint32_t pulses;  // HV charge pulses within the hour
+  uint16_t cycle_max;  // max. charge pulses of one charge cycle
+  int16_t temperature;  // [0.1 deg C] mean of the hour
+  uint8_t humidity;  // [0.5 %] mean of the hour
+  bool have_thp;  // temperature and humidity are valid
+} HvBucket;
+
+// saved to NVS
+typedef struct {
+  uint16_t magic;
+  uint16_t count;  // buckets saved, oldest first
+  float baseline, baseline_sum;
+  int32_t baseline_count;
+  HvBucket buckets[HV_HEALTH_SAVED_HOURS];
+} HvState;
+
+static HvBucket buckets[HV_HEALTH_HOURS];
+static unsigned long hours = 0;  // complete hours recorded (ring buffer index: hours % HV_HEALTH_HOURS)
+static float baseline = 0.0;  // compensated pulses per hour, 0 = not known yet
+static float baseline_sum = 0.0;
+static int baseline_count = 0;
+static HvHealth health;
+
+static float compensated(const HvBucket *b) {
+  // pulses per hour at REFERENCE_TEMPERATURE
+  if (!b->have_thp)
+    return b->pulses;
+  return b->pulses / powf(2.0, (b->temperature / 10.0 - REFERENCE_TEMPERATURE) / 10.0);
+}
+
+static const HvBucket *bucket(unsigned long age) {
+  // age 0 == last complete hour
+  return &buckets[(hours - 1 - age) % HV_HEALTH_HOURS];
+}
+
+static float correlation(int n, float (*x)(const HvBucket *)) {
+  // pearson correlation of the hourly HV pulses with x over the last n hours (only hours with THP)
+  float sx = 0, sy = 0, sxx = 0, syy = 0, sxy = 0;
+  int count = 0;
+  for (int i = 0; i < n; i++) {
+    const HvBucket *b = bucket(i);
+    if (!b->have_thp)
+      continue;
+    float vx = x(b), vy = b->pulses;
+    sx += vx;
+    sy += vy;
+    sxx += vx * vx;
+    syy += vy * vy;
+    sxy += vx * vy;
+    count++;
+  }
+  if (count < 3)
+    return 0.0;
+  float cov = sxy - sx * sy / count, vx = sxx - sx * sx / count, vy = syy - sy * sy / count;
+  return ((vx > 0) && (vy > 0)) ? cov / sqrtf(vx * vy) : 0.0;
+}
+
+static float get_temperature(const HvBucket *b) {
+  return b->temperature / 10.0;
+}
+
+static float get_humidity(const HvBucket *b) {
+  return b->humidity / 2.0;
+}
+
+static void analyze(void) {
+  unsigned long n = (hours < HV_HEALTH_HOURS) ? hours : HV_HEALTH_HOURS;
+  health.hours = n;
+  health.pulses_per_hour = bucket(0)->pulses;
+
+  int recent_n = (n < HV_HEALTH_RECENT_HOURS) ? n : HV_HEALTH_RECENT_HOURS;
+  float recent = 0.0;
+  unsigned int cycle_max = 0;
+  for (int i = 0; i < recent_n; i++) {
+    recent += compensated(bucket(i));
+    if (bucket(i)->cycle_max > cycle_max)
+      cycle_max = bucket(i)->cycle_max;
+  }
+  recent /= recent_n;
+  health.cycle_max_pulses = cycle_max;
+  health.leak_ratio = (baseline > 0) ? recent / baseline : 0.0;
+
+  // trend of the compensated leak [pulses/h per h], least squares over the last hours
+  health.days_to_degraded = -1.0;
+  int trend_n = (n < HV_HEALTH_TREND_HOURS) ? n : HV_HEALTH_TREND_HOURS;
+  if ((baseline > 0) && (trend_n >= HV_HEALTH_RECENT_HOURS * 2)) {
+    float sx = 0, sy = 0, sxx = 0, sxy = 0;
+    for (int i = 0; i < trend_n; i++) {
+      float x = -i, y = compensated(bucket(i));
+      sx += x;
+      sy += y;
+      sxx += x * x;
+      sxy += x * y;
+    }
+    float slope = (sxy - sx * sy / trend_n) / (sxx - sx * sx / trend_n);
+    if (slope > 0) {
+      float remaining = HV_DEGRADED_RATIO * baseline - recent;
+      health.days_to_degraded = (remaining > 0) ? remaining / slope / 24 : 0.0;
+    }
+  }
+
+  health.corr_temperature = correlation(n, get_temperature);
+  health.corr_humidity = correlation(n, get_humidity);
+
+  bool degraded = (health.leak_ratio >= HV_DEGRADED_RATIO) ||
+                  ((health.days_to_degraded >= 0) && (health.days_to_degraded < HV_DEGRADED_DAYS)) ||
+                  (cycle_max >= HV_DEGRADED_CYCLE_PULSES);
+  if (degraded && !health.degraded)
+    log(WARNING, "HV charging degraded: leak ratio %.1f, days to degraded %.1f, max. pulses per charge %u",
+        health.leak_ratio, health.days_to_degraded, cycle_max);
+  health.degraded = degraded;
+}
+
+static void save_state(void) {
+  static HvState s;  // not on the stack of the loop task
+  memset(&s, 0, sizeof(s));
+  s.magic = HV_HEALTH_MAGIC;
+  s.count = (hours < HV_HEALTH_SAVED_HOURS) ? hours : HV_HEALTH_SAVED_HOURS;
+  s.baseline = baseline;
+  s.baseline_sum = baseline_sum;
+  s.baseline_count = baseline_count;
+  for (int i = 0; i < s.count; i++)
+    s.buckets[i] = *bucket(s.count - 1 - i);
+  if (hal_nvs_set(HV_HEALTH_NVS_NAMESPACE, HV_HEALTH_NVS_KEY, &s, sizeof(s)) != sizeof(s))
+    log(ERROR, "Could not save HV health state to NVS");
+}
+
+void setup_hv_health(void) {
+  static HvState s;
+  size_t len = hal_nvs_get(HV_HEALTH_NVS_NAMESPACE, HV_HEALTH_NVS_KEY, &s, sizeof(s));
+  if ((len != sizeof(s)) || (s.magic != HV_HEALTH_MAGIC) || (s.count > HV_HEALTH_SAVED_HOURS))
+    return;  // nothing (usable) saved, e.g. first boot
+  // the hours before the reboot directly precede the new ones, the gap does not matter for the trend
+  for (int i = 0; i < s.count; i++)
+    buckets[i] = s.buckets[i];
+  hours = s.count;
+  baseline = s.baseline;
+  baseline_sum = s.baseline_sum;
+  baseline_count = s.baseline_count;
+  if (hours)
+    analyze();
+  log(INFO, "HV health: restored %lu hours, baseline %.1f pulses/h", hours, baseline);
+}
+
+void hv_health_sample(unsigned long current_ms, unsigned long hv_pulses,
+                      bool have_thp, float temperature, float humidity) {
+  static unsigned long last_ms = current_ms, last_pulses = hv_pulses;
+  static unsigned long skipped = 0;
+  static float t_sum, h_sum;
+  static unsigned int thp_count;
+  static unsigned int cycle_max;
+
+  unsigned long charges, interval_us;
+  unsigned int max;
+  read_hv_stats(&charges, &max, &interval_us);
+  health.recharge_interval_us = interval_us;
+  if (max > cycle_max)
+    cycle_max = max;
+  if (have_thp) {
+    t_sum += temperature;
+    h_sum += humidity;
+    thp_count++;
+  }
+
+  if (current_ms - last_ms < HV_HEALTH_INTERVAL)
+    return;
+  last_ms += HV_HEALTH_INTERVAL;
+
+  HvBucket b;
+  b.pulses = hv_pulses - last_pulses;
+  b.cycle_max = (cycle_max < 0xFFFF) ? cycle_max : 0xFFFF;
+  b.have_thp = thp_count > 0;
+  b.temperature = b.have_thp ? (int16_t)(t_sum / thp_count * 10) : 0;
+  b.humidity = b.have_thp ? (uint8_t)(h_sum / thp_count * 2) : 0;
+  last_pulses = hv_pulses;
+  t_sum = h_sum = 0.0;
+  thp_count = 0;
+  cycle_max = 0;
+
+  if (skipped < HV_HEALTH_SKIP_HOURS) {
+    skipped++;
+    return;
+  }
+  buckets[hours % HV_HEALTH_HOURS] = b;
+  hours++;
+  if (!baseline) {
+    baseline_sum += compensated(&b);
+    if (++baseline_count == HV_HEALTH_BASELINE_HOURS)
+      baseline = (baseline_sum > 0) ? baseline_sum / baseline_count : 1.0 / HV_HEALTH_BASELINE_HOURS;
+  }
+  analyze();
+  save_state();
+}
+
+bool hv_health_degraded(void) {
+  return health.degraded;
+}
+
+void get_hv_health(HvHealth *h) {
+  *h = health;
+}
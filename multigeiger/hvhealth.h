@@ -0,0 +1,29 @@
+// HV subsystem health: tracks the HV charging per hour to detect a degrading HV capacitor
+// or diode (increasing leak current) long before charging fails completely.
+
+#ifndef _HVHEALTH_H_
+#define _HVHEALTH_H_
+
+typedef struct {
+  bool degraded;                      // HV charging is still ok, but will likely fail
+  unsigned long hours;                // complete hours recorded (max. HV_HEALTH_HOURS)
+  unsigned long pulses_per_hour;      // HV charge pulses within the last complete hour
+  float leak_ratio;                   // recent / baseline leak (temperature compensated), 0 = no baseline yet
+  float days_to_degraded;             // projected from the trend of the leak, < 0 = not increasing
+  float corr_temperature;             // correlation of the hourly charge pulses with temperature
+  float corr_humidity;                // correlation of the hourly charge pulses with humidity
+  unsigned int cycle_max_pulses;      // max. charge pulses of one charge cycle within the recent hours
+  unsigned long recharge_interval_us; // current recharge interval
+} HvHealth;
+
+// restores the baseline and the recent hours saved before the last reboot.
+void setup_hv_health(void);
+
+// call regularly from loop(), hv_pulses is the total of HV charge pulses (see read_hv).
+void hv_health_sample(unsigned long current_ms, unsigned long hv_pulses,
+                      bool have_thp, float temperature, float humidity);
+
+bool hv_health_degraded(void);
+void get_hv_health(HvHealth *health);
+
+#endif // _HVHEALTH_H_
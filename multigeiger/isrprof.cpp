@@ -0,0 +1,95 @@
+// ISR profiling: entry counts and execution times [CPU cycles] of the interrupt service routines
+//
+// every profiled ISR call updates min / max / sum and a histogram (for the p99), all in
+// DRAM, so the ISRs can access them while the flash cache is disabled.
+
+#include <string.h>
+
+#include "platform.h"
+#include "log.h"
+#include "isrprof.h"
+
+// log2 histogram with 4 bins per octave, covers the full 32bit cycle range
+#define HIST_BINS 124
+
+typedef struct {
+  uint64_t entries;
+  uint64_t sum;
+  uint32_t min, max;
+  uint32_t hist[HIST_BINS];
+} IsrStats;
+
+static IsrStats stats[ISR_MAX];
+static const char *isr_names[ISR_MAX] = {"isr_GMC_count", "isr_recharge", "isr_GMC_capacitor_full", "tick"};
+static hal_mux_t mux_prof = HAL_MUX_INITIALIZER;
+
+static uint32_t hist_bin_max(int bin) {
+  // largest cycle count within bin
+  if (bin < 4)
+    return bin;
+  int shift = bin / 4 - 1;
+  return (((uint32_t)(4 + bin % 4)) << shift) + ((1u << shift) - 1);
+}
+
+#if ISR_PROFILE
+static int HAL_IRAM hist_bin(uint32_t cycles) {
+  if (cycles < 4)
+    return cycles;
+  int octave = 31 - __builtin_clz(cycles);
+  return (octave - 1) * 4 + ((cycles >> (octave - 2)) & 3);
+}
+
+void HAL_IRAM isr_prof_end(int isr, uint32_t start) {
+  uint32_t cycles = hal_cycles() - start;
+  IsrStats *s = &stats[isr];
+  hal_enter_critical_isr(&mux_prof);
+  if (!s->entries || (cycles < s->min))
+    s->min = cycles;
+  if (cycles > s->max)
+    s->max = cycles;
+  s->entries++;
+  s->sum += cycles;
+  if (++s->hist[hist_bin(cycles)] == 0x80000000) {
+    // frequent ISRs (isr_recharge: 10kHz) would overflow a bin after some days,
+    // so halve the histogram, this keeps the distribution.
+    for (int i = 0; i < HIST_BINS; i++)
+      s->hist[i] >>= 1;
+  }
+  hal_exit_critical_isr(&mux_prof);
+}
+#endif
+
+void get_isr_profile(int isr, IsrProfile *profile) {
+  IsrStats s;
+  hal_enter_critical(&mux_prof);
+  memcpy(&s, &stats[isr], sizeof(s));
+  hal_exit_critical(&mux_prof);
+
+  profile->name = isr_names[isr];
+  profile->entries = (double)s.entries;
+  profile->min = s.min;
+  profile->max = s.max;
+  profile->avg = s.entries ? (uint32_t)(s.sum / s.entries) : 0;
+  uint64_t total = 0;
+  for (int i = 0; i < HIST_BINS; i++)
+    total += s.hist[i];
+  uint64_t target = (total * 99 + 99) / 100, seen = 0;
+  profile->p99 = 0;
+  for (int i = 0; (i < HIST_BINS) && total; i++) {
+    seen += s.hist[i];
+    if (seen >= target) {
+      profile->p99 = (hist_bin_max(i) < s.max) ? hist_bin_max(i) : s.max;
+      break;
+    }
+  }
+}
+
+void log_isr_profile(void) {
+  unsigned int mhz = hal_cpu_mhz();
+  for (int i = 0; i < ISR_MAX; i++) {
+    IsrProfile p;
+    get_isr_profile(i, &p);
+    log(INFO, "ISR %-22s: %10.0f calls, cycles min %u avg %u p99 %u max %u (max %.1f us)",
+        p.name, p.entries, p.min, p.avg, p.p99, p.max, (float)p.max / mhz);
+  }
+}
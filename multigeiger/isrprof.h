@@ -0,0 +1,47 @@
+// ISR profiling: entry counts and execution times [CPU cycles] of the interrupt service routines
+
+#ifndef _ISRPROF_H_
+#define _ISRPROF_H_
+
+#include <stdint.h>
+
+#include "platform.h"
+
+// set to 0 to remove the profiling code from the ISRs
+#ifndef ISR_PROFILE
+#define ISR_PROFILE 1
+#endif
+
+// profiled ISRs
+#define ISR_GMC_COUNT 0  // includes the tick() it calls
+#define ISR_RECHARGE 1
+#define ISR_CAP_FULL 2
+#define ISR_TICK 3
+#define ISR_MAX 4
+
+typedef struct {
+  const char *name;
+  double entries;
+  uint32_t min, avg, p99, max;  // [cycles], p99 is the upper bound of its histogram bin (<= 25% too high)
+} IsrProfile;
+
+#if ISR_PROFILE
+// usage: uint32_t prof = isr_prof_start(); ... isr_prof_end(ISR_x, prof);
+static inline uint32_t isr_prof_start(void) {
+  return hal_cycles();
+}
+void isr_prof_end(int isr, uint32_t start);
+#else
+static inline uint32_t isr_prof_start(void) {
+  return 0;
+}
+static inline void isr_prof_end(int isr, uint32_t start) {
+  (void)isr;
+  (void)start;
+}
+#endif
+
+void get_isr_profile(int isr, IsrProfile *profile);
+void log_isr_profile(void);
+
+#endif // _ISRPROF_H_
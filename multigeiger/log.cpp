@@ -1,32 +1,112 @@
 // low level log() call - outputs to serial/usb
+//
+// log() only formats the message into a ring buffer, a low priority task does the
+// (slow) output to the serial port. if the ring buffer is full, messages get dropped.
 
 #include <Arduino.h>
+#include <atomic>
 
-#include "log.h"
 #include "clock.h"
+#include "log.h"
 
 // the GEIGER: prefix is is to easily differentiate our output from other esp32 output (e.g. wifi messages)
 #define LOG_PREFIX_FORMAT "GEIGER: %s "
-#define LOG_PREFIX_LEN (7+1+19+1)  // chars, without the terminating \0
+
+#define LOG_RING_SIZE 32  // messages
+#define LOG_MSG_LEN 160  // chars, including the terminating \0, longer messages get truncated
 
 static int log_level = NOLOG;  // messages at level >= log_level will be output
 
-void log(int level, const char *format, ...) {
+typedef struct {
+  std::atomic<unsigned int> seq;  // == index + 1 when the message is complete
+  time_t timestamp;
+  char msg[LOG_MSG_LEN];
+} LogSlot;
+
+// lock-free ring buffer: writers claim a slot by advancing write_index, the reader
+// (log task or log_flush, serialized by a mutex) outputs completed slots in order.
+static LogSlot ring[LOG_RING_SIZE];
+static std::atomic<unsigned int> write_index(0), read_index(0);
+static std::atomic<unsigned int> dropped(0);
+static SemaphoreHandle_t reader_mutex;
+static TaskHandle_t log_task_handle;
+
+void log_write(int level, const char *format, ...) {
   if (level < log_level)
     return;
 
+  unsigned int index = write_index.load(std::memory_order_relaxed);
+  do {
+    if (index - read_index.load(std::memory_order_acquire) >= LOG_RING_SIZE) {
+      dropped++;
+      return;
+    }
+  } while (!write_index.compare_exchange_weak(index, index + 1, std::memory_order_acq_rel));
+
+  LogSlot *slot = &ring[index % LOG_RING_SIZE];
+  slot->timestamp = epoch_us() / 1000000;
   va_list args;
   va_start(args, format);
-  char buf[vsnprintf(NULL, 0, format, args) + 1 + LOG_PREFIX_LEN];
-  sprintf(buf, LOG_PREFIX_FORMAT, utctime());
-  vsprintf(buf + LOG_PREFIX_LEN, format, args);
+  vsnprintf(slot->msg, LOG_MSG_LEN, format, args);
   va_end(args);
-  Serial.println(buf);
+  slot->seq.store(index + 1, std::memory_order_release);
+
+  if (log_task_handle)
+    xTaskNotifyGive(log_task_handle);
+}
+
+static void output_timestamp(time_t timestamp) {
+  // formatting the time is rather slow, so only do it if it changed
+  static time_t last_timestamp = -1;
+  static char prefix[40];
+  if (timestamp != last_timestamp) {
+    char buffer[20];
+    struct tm ti;
+    gmtime_r(&timestamp, &ti);
+    strftime(buffer, 20, "%Y-%m-%dT%H:%M:%S", &ti);
+    snprintf(prefix, sizeof(prefix), LOG_PREFIX_FORMAT, buffer);
+    last_timestamp = timestamp;
+  }
+  Serial.print(prefix);
+}
+
+static void drain(void) {
+  xSemaphoreTake(reader_mutex, portMAX_DELAY);
+  for (;;) {
+    unsigned int index = read_index.load(std::memory_order_relaxed);
+    LogSlot *slot = &ring[index % LOG_RING_SIZE];
+    if (slot->seq.load(std::memory_order_acquire) != index + 1)
+      break;  // empty or not completely written yet
+    output_timestamp(slot->timestamp);
+    Serial.println(slot->msg);
+    read_index.store(index + 1, std::memory_order_release);
+  }
+  unsigned int lost = dropped.exchange(0);
+  if (lost && (log_level != NOLOG)) {  // NOLOG: no text, e.g. within binary data on the serial port
+    output_timestamp(epoch_us() / 1000000);
+    Serial.printf("%u log messages dropped.\n", lost);
+  }
+  xSemaphoreGive(reader_mutex);
+}
+
+static void log_task(void *arg) {
+  for (;;) {
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    drain();
+  }
+}
+
+void log_flush(void) {
+  drain();
+  Serial.flush();
 }
 
 void setup_log(int level) {
   Serial.begin(115200);
   while (!Serial) {};
-  log(NOLOG, "Logging initialized at level %d.", level);  // this will always be output
+  reader_mutex = xSemaphoreCreateMutex();
+  xTaskCreate(log_task, "log", 3072, NULL, tskIDLE_PRIORITY + 1, &log_task_handle);
+  if (level != NOLOG)
+    log(NOLOG, "Logging initialized at level %d.", level);  // this will always be output
   log_level = level;
 }
@@ -1,4 +1,7 @@
 // low level log() call - outputs to serial/usb
+//
+// log() only formats the message into a ring buffer, a low priority task does the
+// (slow) output to the serial port. if the ring buffer is full, messages get dropped.
 
 #ifndef _LOG_H_
 #define _LOG_H_
@@ -11,7 +14,20 @@
 #define CRITICAL 4
 #define NOLOG 999  // only to set log_level, so log() never creates output
 
-void log(int level, const char *format, ...);
+// log() calls below this level are removed at compile time, e.g. -D LOG_MIN_LEVEL=1 removes DEBUG.
+#ifndef LOG_MIN_LEVEL
+#define LOG_MIN_LEVEL DEBUG
+#endif
+
+void log_write(int level, const char *format, ...);
+
+template<typename... Args>
+inline void log(int level, const char *format, Args... args) {
+  if (level >= LOG_MIN_LEVEL)
+    log_write(level, format, args...);
+}
+
 void setup_log(int level);
+void log_flush(void);  // output all buffered messages now (e.g. before a restart)
 
 #endif // _LOG_H_
@@ -1,7 +1,12 @@
 // measurement data logging
 
+#include <Arduino.h>
+
 #include "version.h"
 #include "log.h"
+#include "userdefines.h"
+#include "tube.h"
+#include "clock.h"
 #include "log_data.h"
 
 int Serial_Print_Mode;
@@ -14,6 +19,145 @@ static const char *Serial_Logging_Body = "DATA %10d %15d %10f %9f %9d %8d %9d %9
 static const char *Serial_One_Minute_Log_Header = "     %4s %10s %29s";
 static const char *Serial_One_Minute_Log_Body = "DATA %4d %10d %29d";
 
+// binary logging: every record is a frame of [type][seq][payload][crc16], COBS encoded and
+// terminated by a 0 byte. all values are little endian. see misc/decode_binary_log.py.
+#define BINARY_LOG_VERSION 1
+#define REC_INFO 0      // u8 format version, u8 tube nbr, char[] firmware version
+#define REC_INTERVAL 1  // u32 uptime [ms], u32 dt [ms], u32 counts, u32 hv pulses, u8 flags (bit 0: hv error)
+#define REC_PULSES 2    // u16 dropped pulses, u32 timestamps [us] of the pulses (micros(), wraps around)
+#define REC_THP 3       // u32 uptime [ms], f32 temperature [C], f32 humidity [%], f32 pressure [Pa]
+#define REC_TIME 4      // u32 uptime [ms], u64 UTC [us] since epoch (only sent if the clock is set)
+
+#define TIME_RECORD_INTERVAL 60000  // [ms]
+
+#define MAX_PAYLOAD 130
+#define PULSES_PER_RECORD 32
+#define PULSE_RECORDS_PER_CALL 8
+
+static uint16_t crc16(const uint8_t *data, int len) {
+  // CRC-16/CCITT-FALSE: poly 0x1021, init 0xFFFF
+  uint16_t crc = 0xFFFF;
+  for (int i = 0; i < len; i++) {
+    crc ^= (uint16_t)data[i] << 8;
+    for (int b = 0; b < 8; b++)
+      crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+  }
+  return crc;
+}
+
+static int cobs_encode(const uint8_t *src, int len, uint8_t *dst) {
+  // encode len bytes from src into dst (needs len + len / 254 + 1 bytes), returns the encoded length.
+  int code_pos = 0, out = 1;
+  uint8_t code = 1;
+  for (int i = 0; i < len; i++) {
+    if (src[i] == 0) {
+      dst[code_pos] = code;
+      code_pos = out++;
+      code = 1;
+    } else {
+      dst[out++] = src[i];
+      if (++code == 0xFF) {
+        dst[code_pos] = code;
+        code_pos = out++;
+        code = 1;
+      }
+    }
+  }
+  dst[code_pos] = code;
+  return out;
+}
+
+static void write_record(uint8_t type, const uint8_t *payload, int len) {
+  static uint8_t seq = 0;
+  uint8_t frame[2 + MAX_PAYLOAD + 2];
+  uint8_t encoded[sizeof(frame) + sizeof(frame) / 254 + 2];
+  frame[0] = type;
+  frame[1] = seq++;
+  memcpy(frame + 2, payload, len);
+  uint16_t crc = crc16(frame, 2 + len);
+  frame[2 + len] = crc & 0xFF;
+  frame[3 + len] = crc >> 8;
+  int n = cobs_encode(frame, 4 + len, encoded);
+  encoded[n++] = 0;  // frame delimiter
+  Serial.write(encoded, n);
+}
+
+static uint8_t *put_u32(uint8_t *p, uint32_t v) {
+  for (int i = 0; i < 4; i++)
+    *p++ = (v >> (8 * i)) & 0xFF;
+  return p;
+}
+
+static uint8_t *put_f32(uint8_t *p, float v) {
+  uint32_t u;
+  memcpy(&u, &v, 4);
+  return put_u32(p, u);
+}
+
+static void log_data_binary_info(void) {
+  uint8_t payload[MAX_PAYLOAD];
+  payload[0] = BINARY_LOG_VERSION;
+  payload[1] = tubes[TUBE_TYPE].nbr;
+  snprintf((char *)payload + 2, MAX_PAYLOAD - 2, "%s", VERSION_STR);
+  write_record(REC_INFO, payload, 2 + strlen((char *)payload + 2));
+}
+
+void log_data_binary(unsigned long current_ms, unsigned long gm_counts, unsigned long hv_pulses, bool hv_error,
+                     bool have_thp, float t, float h, float p) {
+  static unsigned long last_ms = current_ms, last_counts = gm_counts, last_hv_pulses = hv_pulses;
+  static unsigned int pulse_position = 0;
+  static float last_t, last_h, last_p;
+  uint8_t payload[MAX_PAYLOAD], *q;
+
+  // per-pulse timestamps first, they were recorded before the interval ended
+  unsigned long timestamps[PULSES_PER_RECORD];
+  unsigned int dropped;
+  for (int r = 0; r < PULSE_RECORDS_PER_CALL; r++) {
+    int count = read_GMC_pulses(&pulse_position, timestamps, PULSES_PER_RECORD, &dropped);
+    if (!count && !dropped)
+      break;
+    if (dropped > 0xFFFF)
+      dropped = 0xFFFF;
+    payload[0] = dropped & 0xFF;
+    payload[1] = dropped >> 8;
+    q = payload + 2;
+    for (int i = 0; i < count; i++)
+      q = put_u32(q, timestamps[i]);
+    write_record(REC_PULSES, payload, q - payload);
+  }
+
+  q = put_u32(payload, current_ms);
+  q = put_u32(q, current_ms - last_ms);
+  q = put_u32(q, gm_counts - last_counts);
+  q = put_u32(q, hv_pulses - last_hv_pulses);
+  *q++ = hv_error ? 0x01 : 0;
+  write_record(REC_INTERVAL, payload, q - payload);
+  last_ms = current_ms;
+  last_counts = gm_counts;
+  last_hv_pulses = hv_pulses;
+
+  static unsigned long last_time_record_ms = current_ms - TIME_RECORD_INTERVAL;
+  if ((current_ms - last_time_record_ms >= TIME_RECORD_INTERVAL) && clock_is_set()) {
+    uint64_t now_us = epoch_us();
+    q = put_u32(payload, current_ms);
+    q = put_u32(q, now_us & 0xFFFFFFFF);
+    q = put_u32(q, now_us >> 32);
+    write_record(REC_TIME, payload, q - payload);
+    last_time_record_ms = current_ms;
+  }
+
+  if (have_thp && ((t != last_t) || (h != last_h) || (p != last_p))) {
+    q = put_u32(payload, current_ms);
+    q = put_f32(q, t);
+    q = put_f32(q, h);
+    q = put_f32(q, p);
+    write_record(REC_THP, payload, q - payload);
+    last_t = t;
+    last_h = h;
+    last_p = p;
+  }
+}
+
 void setup_log_data(int mode) {
   Serial_Print_Mode = mode;
 
@@ -24,6 +168,8 @@ void setup_log_data(int mode) {
     log(INFO, "%s, Version %s", Serial_Logging_Name, VERSION_STR);
     log(INFO, dashes);
   }
+  if (Serial_Print_Mode == Serial_Binary_Log)
+    log_data_binary_info();
 }
 
 void log_data(int GMC_counts, int time_difference, float Count_Rate, float Dose_Rate, int HV_pulse_count,
@@ -9,6 +9,7 @@
 #define Serial_Logging 2         // Log measurements as a table
 #define Serial_One_Minute_Log 3  // One Minute logging
 #define Serial_Statistics_Log 4  // Logs time [us] between two events
+#define Serial_Binary_Log 5      // Binary records (COBS framed, CRC), decode with misc/decode_binary_log.py
 
 extern int Serial_Print_Mode;
 
@@ -18,5 +19,7 @@ void log_data(int GMC_counts, int time_difference, float Count_Rate, float Dose_
               float t, float h, float p);
 void log_data_one_minute(int time_s, int cpm, int counts);
 void log_data_statistics(int count_time_between);
+void log_data_binary(unsigned long current_ms, unsigned long gm_counts, unsigned long hv_pulses, bool hv_error,
+                     bool have_thp, float t, float h, float p);
 
 #endif // _LOG_DATA_H_
@@ -43,6 +43,7 @@
 #include <hal/hal.h>
 #include "hal/heltecv2.h"
 #include <SPI.h>
+#include "platform.h"
 #include "webconf.h"
 #include "utils.h"
 #include "loraWan.h"
@@ -79,6 +80,90 @@ static volatile transmissionStatus_t txStatus;
 static uint8_t *__rxPort;
 static uint8_t *__rxBuffer;
 static uint8_t *__rxSz;
+static bool __ack;
+
+// LoRaWAN session persistence:
+// After the OTAA join and after each uplink, the session state is saved to NVS.
+// At boot (or when setup_lorawan() is called again after a timeout), we restore it
+// and can send immediately instead of doing a new join.
+// As we can not know whether the network server still knows our session, the first
+// uplink after restoring is sent confirmed. If it does not get acked, we forget the
+// session and do a new join.
+#define SESSION_NVS_NAMESPACE "lorawan"
+#define SESSION_NVS_KEY "session"
+#define SESSION_MAGIC 0x4C53  // change this if the layout of LoraSession changes
+
+typedef struct {
+  uint16_t magic;
+  char deveui[17];  // the session is only valid for the credentials it was created with
+  char appeui[17];
+  u4_t netid;
+  devaddr_t devaddr;
+  u1_t nwkKey[16];
+  u1_t artKey[16];
+  u4_t seqnoUp;
+  u4_t seqnoDn;
+  u1_t datarate;
+  s1_t txpow;
+  u1_t dn2Dr;
+  u1_t rxDelay;
+  u4_t channelFreq[MAX_CHANNELS];
+  u2_t channelDrMap[MAX_CHANNELS];
+  u4_t channelMap;
+} LoraSession;
+
+static bool session_unconfirmed = false;  // restored session, not yet acked by network
+static bool session_rejected = false;  // restored session did not work, need to join again
+
+void save_session(void) {
+  LoraSession s;
+  memset(&s, 0, sizeof(s));
+  s.magic = SESSION_MAGIC;
+  strncpy(s.deveui, deveui, sizeof(s.deveui) - 1);
+  strncpy(s.appeui, appeui, sizeof(s.appeui) - 1);
+  LMIC_getSessionKeys(&s.netid, &s.devaddr, s.nwkKey, s.artKey);
+  s.seqnoUp = LMIC.seqnoUp;
+  s.seqnoDn = LMIC.seqnoDn;
+  s.datarate = LMIC.datarate;
+  s.txpow = LMIC.txpow;
+  s.dn2Dr = LMIC.dn2Dr;
+  s.rxDelay = LMIC.rxDelay;
+  memcpy(s.channelFreq, LMIC.channelFreq, sizeof(s.channelFreq));
+  memcpy(s.channelDrMap, LMIC.channelDrMap, sizeof(s.channelDrMap));
+  s.channelMap = LMIC.channelMap;
+
+  if (hal_nvs_set(SESSION_NVS_NAMESPACE, SESSION_NVS_KEY, &s, sizeof(s)) != sizeof(s))
+    log(ERROR, "Could not save LoRaWAN session to NVS");
+}
+
+void forget_session(void) {
+  hal_nvs_remove(SESSION_NVS_NAMESPACE, SESSION_NVS_KEY);
+  session_unconfirmed = false;
+}
+
+bool restore_session(void) {
+  LoraSession s;
+  size_t len = hal_nvs_get(SESSION_NVS_NAMESPACE, SESSION_NVS_KEY, &s, sizeof(s));
+  if ((len != sizeof(s)) || (s.magic != SESSION_MAGIC))
+    return false;  // no (usable) session saved
+  if ((strcmp(s.deveui, deveui) != 0) || (strcmp(s.appeui, appeui) != 0)) {
+    log(INFO, "LoRaWAN credentials have changed, not restoring old session");
+    return false;
+  }
+
+  // this also resets the channels and the frame counters, so restore them afterwards.
+  LMIC_setSession(s.netid, s.devaddr, s.nwkKey, s.artKey);
+  LMIC.seqnoUp = s.seqnoUp;
+  LMIC.seqnoDn = s.seqnoDn;
+  LMIC.dn2Dr = s.dn2Dr;
+  LMIC.rxDelay = s.rxDelay;
+  memcpy(LMIC.channelFreq, s.channelFreq, sizeof(s.channelFreq));
+  memcpy(LMIC.channelDrMap, s.channelDrMap, sizeof(s.channelDrMap));
+  LMIC.channelMap = s.channelMap;
+  LMIC_setDrTxpow(s.datarate, s.txpow);
+  log(INFO, "LoRaWAN session restored, devaddr: %08x, seqnoUp: %u", s.devaddr, s.seqnoUp);
+  return true;
+}
 
 void onEvent(ev_t ev) {
   switch (ev) {
@@ -124,6 +209,7 @@ void onEvent(ev_t ev) {
     // during join, but because slow data rates change max TX
     // size, we don't use it in this example.
     LMIC_setLinkCheckMode(0);
+    save_session();
     break;
   // This event is defined but not used in the code.
   // No point in wasting codespace on it.
@@ -142,9 +228,23 @@ void onEvent(ev_t ev) {
     log(DEBUG, "EV_TXCOMPLETE (includes waiting for RX windows)");
     txStatus =   TX_STATUS_UPLINK_SUCCESS;
     if (LMIC.txrxFlags & TXRX_ACK) {
-      txStatus = TX_STATUS_UPLINK_ACKED;
+      if (__ack)  // only report the ack if the caller asked for it
+        txStatus = TX_STATUS_UPLINK_ACKED;
       log(DEBUG, "Received ack");
     }
+    if (session_unconfirmed) {
+      if (LMIC.txrxFlags & TXRX_ACK) {
+        log(INFO, "LoRaWAN restored session confirmed by network");
+        session_unconfirmed = false;
+      } else {
+        log(WARNING, "LoRaWAN restored session not acked by network, will join again");
+        forget_session();
+        session_rejected = true;
+        txStatus = TX_STATUS_ENDING_ERROR;
+        break;
+      }
+    }
+    save_session();  // saves the updated frame counters
     if (LMIC.dataLen) {
       log(DEBUG, "Received %d bytes of payload", LMIC.dataLen);
       if (__rxPort != NULL) *__rxPort = LMIC.frame[LMIC.dataBeg - 1];
@@ -169,6 +269,8 @@ void onEvent(ev_t ev) {
   case EV_LINK_DEAD:
     txStatus = TX_STATUS_ENDING_ERROR;
     log(DEBUG, "EV_LINK_DEAD");
+    // our session seems to be unknown to the network, join again at next setup_lorawan()
+    forget_session();
     break;
   case EV_LINK_ALIVE:
     txStatus = TX_STATUS_UNKNOWN;
@@ -211,7 +313,16 @@ void setup_lorawan() {
   LMIC_setupChannel(8, 868800000, DR_RANGE_MAP(DR_FSK,  DR_FSK),  BAND_MILLI);  // g2-band
   LMIC_setLinkCheckMode(0);
   LMIC.dn2Dr = SF9;
-  LMIC_setDrTxpow(DR_SF7, 14);
+  LMIC_setDrTxpow(loraDataRate, 14);
+
+  // if we have a saved session, use it instead of joining again
+  session_rejected = false;
+  session_unconfirmed = restore_session();
+}
+
+// datarate: 0 (SF12) .. 5 (SF7) for EU868
+void lorawan_set_datarate(int datarate) {
+  LMIC_setDrTxpow(datarate, 14);
 }
 
 void poll_lorawan() {
@@ -237,8 +348,10 @@ transmissionStatus_t lorawan_send(uint8_t txPort, uint8_t *txBuffer, uint8_t txS
     __rxPort = rxPort;
     __rxBuffer = rxBuffer;
     __rxSz = rxSz;
+    __ack = ack;
     // Prepare upstream data transmission at the next possible time.
-    LMIC_setTxData2(txPort, txBuffer, txSz, ((ack) ? 1 : 0));
+    // A restored session gets verified by sending a confirmed uplink.
+    LMIC_setTxData2(txPort, txBuffer, txSz, ((ack || session_unconfirmed) ? 1 : 0));
     // wait for completion
     uint64_t start = millis();
     while (true) {
@@ -257,7 +370,15 @@ transmissionStatus_t lorawan_send(uint8_t txPort, uint8_t *txBuffer, uint8_t txS
       case TX_STATUS_TIMEOUT:
         break;
       }
+      if (session_rejected) {
+        setup_lorawan();  // session was forgotten, so this prepares a new join
+        return TX_STATUS_ENDING_ERROR;
+      }
       if (millis() - start > LORA_TIMEOUT_MS) {
+        if (session_unconfirmed) {
+          log(WARNING, "LoRaWAN restored session could not be confirmed, will join again");
+          forget_session();
+        }
         setup_lorawan();
         return TX_STATUS_TIMEOUT;
       }
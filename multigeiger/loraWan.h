@@ -16,6 +16,7 @@ typedef enum {
 #define LORA_TIMEOUT_MS 30000L
 
 void setup_lorawan();
+void lorawan_set_datarate(int datarate);
 
 // call os_runloop_once(); a separate function to keep the LMIC header files mostly hidden.
 void poll_lorawan();
@@ -0,0 +1,94 @@
+// low power mode for battery powered (LoRa) deployments:
+// the ULP coprocessor counts the GM pulses, the main cores light-sleep between the loop runs.
+//
+// note: the HV generation (GPIO 23 / 22) is not connected to RTC GPIOs, so the ULP can not
+// recharge the HV capacitor and deep sleep is not possible: the HV would break down after a
+// few seconds and the tube would stop counting. thus we use light sleep, wake up once per
+// loop (1s) and recharge the HV capacitor then, which only needs a few ms.
+
+#include <Arduino.h>
+#include <esp32/ulp.h>
+#include <driver/rtc_io.h>
+#include <soc/rtc_io_reg.h>
+#include <esp_sleep.h>
+
+#include "log.h"
+#include "tube.h"
+#include "lowpower.h"
+
+// RTC slow memory layout [32bit words], the ULP only uses the lower 16 bits.
+#define ULP_COUNTER 0  // GM pulses counted by the ULP (wraps around)
+#define ULP_PROG_START 16
+
+#define ULP_CYCLES_PER_US 8  // ULP runs at RTC_FAST_CLK (8MHz)
+
+// max. time to wait for a running HV charge cycle to finish before sleeping [ms]
+#define HV_WAIT_MAX 100
+
+static uint16_t last_ulp_count;
+
+void start_ulp_counter(int gpio, int dead_time_us) {
+  int rtc_io = rtc_gpio_desc[gpio].rtc_num;
+  int in_bit = RTC_GPIO_IN_NEXT_S + rtc_io;
+  rtc_gpio_init((gpio_num_t)gpio);
+  rtc_gpio_set_direction((gpio_num_t)gpio, RTC_GPIO_MODE_INPUT_ONLY);
+  rtc_gpio_pullup_dis((gpio_num_t)gpio);
+  rtc_gpio_pulldown_dis((gpio_num_t)gpio);
+
+  enum {WAIT_HIGH, WAIT_LOW};  // labels
+  const ulp_insn_t program[] = {
+    I_MOVI(R1, ULP_COUNTER),  // R1: address of the counter
+    M_LABEL(WAIT_HIGH),  // wait until the input is idle (high)
+    I_RD_REG(RTC_GPIO_IN_REG, in_bit, in_bit),
+    M_BL(WAIT_HIGH, 1),
+    M_LABEL(WAIT_LOW),  // wait for a GM pulse (low)
+    I_RD_REG(RTC_GPIO_IN_REG, in_bit, in_bit),
+    M_BGE(WAIT_LOW, 1),
+    I_LD(R0, R1, 0),  // count it
+    I_ADDI(R0, R0, 1),
+    I_ST(R0, R1, 0),
+    I_DELAY(dead_time_us * ULP_CYCLES_PER_US),  // ignore false pulses (no Schmitt trigger on the input)
+    M_BX(WAIT_HIGH),
+  };
+
+  RTC_SLOW_MEM[ULP_COUNTER] = 0;
+  last_ulp_count = 0;
+  size_t size = sizeof(program) / sizeof(ulp_insn_t);
+  esp_err_t err = ulp_process_macros_and_load(ULP_PROG_START, program, &size);
+  if (err == ESP_OK)
+    err = ulp_run(ULP_PROG_START);  // the program never halts, so it runs continuously
+  if (err != ESP_OK)
+    log(ERROR, "Starting the ULP pulse counter failed, err: %d", err);
+  // keep RTC IO powered while sleeping, so the ULP can read the input
+  esp_sleep_pd_config(ESP_PD_DOMAIN_RTC_PERIPH, ESP_PD_OPTION_ON);
+}
+
+unsigned int read_ulp_counts(void) {
+  uint16_t count = RTC_SLOW_MEM[ULP_COUNTER] & 0xFFFF;
+  uint16_t counts = count - last_ulp_count;
+  last_ulp_count = count;
+  return counts;
+}
+
+void lowpower_sleep(unsigned long sleep_ms) {
+  unsigned long start_ms = millis();
+  // the HV FET must never stay on while we sleep, so do not start a new charge cycle
+  // and wait for a running one to finish (usually, this takes only a few ms).
+  hv_pause(true);
+  while (hv_is_charging() && (millis() - start_ms < HV_WAIT_MAX))
+    delay(1);
+  unsigned long waited_ms = millis() - start_ms;
+  if (waited_ms < sleep_ms) {
+    if (!hv_is_charging()) {
+      Serial.flush();  // UART output would be garbled otherwise
+      esp_sleep_enable_timer_wakeup((sleep_ms - waited_ms) * 1000ULL);
+      esp_light_sleep_start();
+    } else {
+      hv_pause(false);  // let it finish charging, sleep next time
+      delay(sleep_ms - waited_ms);
+    }
+  }
+  hv_pause(false);
+  // the HV capacitor was not recharged while sleeping, so do it now.
+  hv_recharge_now();
+}
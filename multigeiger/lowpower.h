@@ -0,0 +1,17 @@
+// low power mode for battery powered (LoRa) deployments:
+// the ULP coprocessor counts the GM pulses, the main cores light-sleep between the loop runs.
+
+#ifndef _LOWPOWER_H_
+#define _LOWPOWER_H_
+
+// time after boot until the low power mode gets activated, allows configuration via WiFi [ms]
+#define LOW_POWER_GRACE_PERIOD 300000
+
+// start counting GM pulses (falling edges on gpio, which has to be a RTC GPIO) with the ULP.
+void start_ulp_counter(int gpio, int dead_time_us);
+unsigned int read_ulp_counts(void);  // pulses counted since the last call
+
+// sleep for sleep_ms (GM pulses are still counted by the ULP), recharges HV afterwards.
+void lowpower_sleep(unsigned long sleep_ms);
+
+#endif // _LOWPOWER_H_
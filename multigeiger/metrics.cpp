@@ -0,0 +1,225 @@
+// live metrics for monitoring, exported in Prometheus text format via the web server (/metrics)
+
+#include <Arduino.h>
+#include <WiFi.h>
+
+#include "tube.h"
+#include "boot.h"
+#include "hvhealth.h"
+#include "isrprof.h"
+#include "history.h"
+#include "metrics.h"
+
+static const char *sink_names[SINK_MAX] = {"sensor.community", "madavi", "ttn", "mqtt", "customsrv"};
+
+static unsigned long gm_counts, hv_pulses;
+static bool hv_error;
+static float rates[4];  // count_rate, dose_rate, accumulated_count_rate, accumulated_dose_rate
+
+typedef struct {
+  unsigned long ok, error;
+  unsigned long duration_ms_sum;
+  unsigned long last_duration_ms;
+  unsigned long last_ok_ms;  // 0 = never
+} SinkMetrics;
+
+static SinkMetrics sinks[SINK_MAX];
+
+static unsigned long loop_duration_ms, loop_duration_max_ms;
+
+static unsigned long display_refreshes, display_bytes_sum;
+static unsigned long long display_duration_us_sum;  // 32 bits would overflow after ~1h of refreshing
+static unsigned long display_last_bytes, display_last_duration_us;
+
+static unsigned long thp_reads_ok, thp_reads_error;
+static unsigned long thp_latency_ms_sum, thp_last_latency_ms;  // trigger to result available
+static unsigned long thp_last_read_us, thp_read_max_us;  // time spent in the loop collecting the result
+
+void metrics_gm(unsigned long counts, unsigned long pulses, bool error) {
+  gm_counts = counts;
+  hv_pulses = pulses;
+  hv_error = error;
+}
+
+void metrics_rates(float count_rate, float dose_rate, float accumulated_count_rate, float accumulated_dose_rate) {
+  rates[0] = count_rate;
+  rates[1] = dose_rate;
+  rates[2] = accumulated_count_rate;
+  rates[3] = accumulated_dose_rate;
+}
+
+void metrics_upload(int sink, bool ok, unsigned long duration_ms) {
+  if ((sink < 0) || (sink >= SINK_MAX))
+    return;
+  SinkMetrics *s = &sinks[sink];
+  if (ok) {
+    s->ok++;
+    s->last_ok_ms = millis();
+  } else
+    s->error++;
+  s->duration_ms_sum += duration_ms;
+  s->last_duration_ms = duration_ms;
+}
+
+void metrics_loop(unsigned long duration_ms) {
+  loop_duration_ms = duration_ms;
+  if (duration_ms > loop_duration_max_ms)
+    loop_duration_max_ms = duration_ms;
+}
+
+void metrics_display(unsigned long bytes, unsigned long duration_us) {
+  display_refreshes++;
+  display_bytes_sum += bytes;
+  display_duration_us_sum += duration_us;
+  display_last_bytes = bytes;
+  display_last_duration_us = duration_us;
+}
+
+void metrics_thp(bool ok, unsigned long latency_ms, unsigned long read_us) {
+  if (ok)
+    thp_reads_ok++;
+  else
+    thp_reads_error++;
+  thp_latency_ms_sum += latency_ms;
+  thp_last_latency_ms = latency_ms;
+  thp_last_read_us = read_us;
+  if (read_us > thp_read_max_us)
+    thp_read_max_us = read_us;
+}
+
+// append formatted text to buf, never writing more than size bytes
+#define APPEND(...) do { \
+    if (len < size) \
+      len += snprintf(buf + len, size - len, __VA_ARGS__); \
+  } while (0)
+
+int render_metrics(char *buf, int size) {
+  int len = 0;
+  APPEND("# TYPE multigeiger_gm_counts_total counter\n");
+  APPEND("multigeiger_gm_counts_total %lu\n", gm_counts);
+  APPEND("# TYPE multigeiger_hv_pulses_total counter\n");
+  APPEND("multigeiger_hv_pulses_total %lu\n", hv_pulses);
+  APPEND("# TYPE multigeiger_hv_error gauge\n");
+  APPEND("multigeiger_hv_error %d\n", hv_error ? 1 : 0);
+
+  HvHealth hv;
+  get_hv_health(&hv);
+  APPEND("# TYPE multigeiger_hv_degraded gauge\n");
+  APPEND("multigeiger_hv_degraded %d\n", hv.degraded ? 1 : 0);
+  APPEND("# TYPE multigeiger_hv_health_hours gauge\n");
+  APPEND("multigeiger_hv_health_hours %lu\n", hv.hours);
+  APPEND("# TYPE multigeiger_hv_pulses_per_hour gauge\n");
+  APPEND("multigeiger_hv_pulses_per_hour %lu\n", hv.pulses_per_hour);
+  APPEND("# TYPE multigeiger_hv_leak_ratio gauge\n");
+  APPEND("multigeiger_hv_leak_ratio %.3f\n", hv.leak_ratio);
+  APPEND("# TYPE multigeiger_hv_days_to_degraded gauge\n");
+  APPEND("multigeiger_hv_days_to_degraded %.1f\n", hv.days_to_degraded);
+  APPEND("# TYPE multigeiger_hv_leak_correlation gauge\n");
+  APPEND("multigeiger_hv_leak_correlation{with=\"temperature\"} %.3f\n", hv.corr_temperature);
+  APPEND("multigeiger_hv_leak_correlation{with=\"humidity\"} %.3f\n", hv.corr_humidity);
+  APPEND("# TYPE multigeiger_hv_cycle_max_pulses gauge\n");
+  APPEND("multigeiger_hv_cycle_max_pulses %u\n", hv.cycle_max_pulses);
+  APPEND("# TYPE multigeiger_hv_recharge_interval_seconds gauge\n");
+  APPEND("multigeiger_hv_recharge_interval_seconds %.4f\n", hv.recharge_interval_us / 1000000.0);
+
+  APPEND("# TYPE multigeiger_count_rate_cps gauge\n");
+  APPEND("multigeiger_count_rate_cps{window=\"current\"} %.4f\n", rates[0]);
+  APPEND("multigeiger_count_rate_cps{window=\"accumulated\"} %.4f\n", rates[2]);
+  APPEND("# TYPE multigeiger_dose_rate_usvph gauge\n");
+  APPEND("multigeiger_dose_rate_usvph{window=\"current\"} %.4f\n", rates[1]);
+  APPEND("multigeiger_dose_rate_usvph{window=\"accumulated\"} %.4f\n", rates[3]);
+
+  APPEND("# TYPE multigeiger_uploads_total counter\n");
+  for (int i = 0; i < SINK_MAX; i++) {
+    APPEND("multigeiger_uploads_total{sink=\"%s\",result=\"ok\"} %lu\n", sink_names[i], sinks[i].ok);
+    APPEND("multigeiger_uploads_total{sink=\"%s\",result=\"error\"} %lu\n", sink_names[i], sinks[i].error);
+  }
+  APPEND("# TYPE multigeiger_upload_duration_seconds summary\n");
+  for (int i = 0; i < SINK_MAX; i++) {
+    APPEND("multigeiger_upload_duration_seconds_sum{sink=\"%s\"} %.3f\n", sink_names[i], sinks[i].duration_ms_sum / 1000.0);
+    APPEND("multigeiger_upload_duration_seconds_count{sink=\"%s\"} %lu\n", sink_names[i], sinks[i].ok + sinks[i].error);
+  }
+  APPEND("# TYPE multigeiger_upload_last_duration_seconds gauge\n");
+  for (int i = 0; i < SINK_MAX; i++)
+    APPEND("multigeiger_upload_last_duration_seconds{sink=\"%s\"} %.3f\n", sink_names[i], sinks[i].last_duration_ms / 1000.0);
+
+  APPEND("# TYPE multigeiger_loop_duration_seconds gauge\n");
+  APPEND("multigeiger_loop_duration_seconds %.3f\n", loop_duration_ms / 1000.0);
+  APPEND("# TYPE multigeiger_loop_duration_max_seconds gauge\n");
+  APPEND("multigeiger_loop_duration_max_seconds %.3f\n", loop_duration_max_ms / 1000.0);
+  APPEND("# TYPE multigeiger_display_refreshes_total counter\n");
+  APPEND("multigeiger_display_refreshes_total %lu\n", display_refreshes);
+  APPEND("# TYPE multigeiger_display_sent_bytes_total counter\n");
+  APPEND("multigeiger_display_sent_bytes_total %lu\n", display_bytes_sum);
+  APPEND("# TYPE multigeiger_display_refresh_duration_seconds_total counter\n");
+  APPEND("multigeiger_display_refresh_duration_seconds_total %.6f\n", display_duration_us_sum / 1000000.0);
+  APPEND("# TYPE multigeiger_display_last_refresh_bytes gauge\n");
+  APPEND("multigeiger_display_last_refresh_bytes %lu\n", display_last_bytes);
+  APPEND("# TYPE multigeiger_display_last_refresh_seconds gauge\n");
+  APPEND("multigeiger_display_last_refresh_seconds %.6f\n", display_last_duration_us / 1000000.0);
+  APPEND("# TYPE multigeiger_thp_reads_total counter\n");
+  APPEND("multigeiger_thp_reads_total{result=\"ok\"} %lu\n", thp_reads_ok);
+  APPEND("multigeiger_thp_reads_total{result=\"error\"} %lu\n", thp_reads_error);
+  APPEND("# TYPE multigeiger_thp_latency_seconds_total counter\n");
+  APPEND("multigeiger_thp_latency_seconds_total %.3f\n", thp_latency_ms_sum / 1000.0);
+  APPEND("# TYPE multigeiger_thp_last_latency_seconds gauge\n");
+  APPEND("multigeiger_thp_last_latency_seconds %.3f\n", thp_last_latency_ms / 1000.0);
+  APPEND("# TYPE multigeiger_thp_last_read_seconds gauge\n");
+  APPEND("multigeiger_thp_last_read_seconds %.6f\n", thp_last_read_us / 1000000.0);
+  APPEND("# TYPE multigeiger_thp_read_max_seconds gauge\n");
+  APPEND("multigeiger_thp_read_max_seconds %.6f\n", thp_read_max_us / 1000000.0);
+  APPEND("# TYPE multigeiger_free_heap_bytes gauge\n");
+  APPEND("multigeiger_free_heap_bytes %u\n", ESP.getFreeHeap());
+  APPEND("# TYPE multigeiger_wifi_rssi_dbm gauge\n");
+  APPEND("multigeiger_wifi_rssi_dbm %d\n", (WiFi.status() == WL_CONNECTED) ? WiFi.RSSI() : 0);
+  BootStage stages[BOOT_STAGES_MAX];
+  int stage_count = get_boot_stages(stages, BOOT_STAGES_MAX);
+  APPEND("# TYPE multigeiger_boot_stage_seconds gauge\n");
+  for (int i = 0; i < stage_count; i++)
+    APPEND("multigeiger_boot_stage_seconds{stage=\"%s\"} %.6f\n", stages[i].name, stages[i].us / 1000000.0);
+  if (first_count_us()) {
+    APPEND("# TYPE multigeiger_time_to_first_count_seconds gauge\n");
+    APPEND("multigeiger_time_to_first_count_seconds %.6f\n", first_count_us() / 1000000.0);
+  }
+  APPEND("# TYPE multigeiger_cpu_mhz gauge\n");
+  APPEND("multigeiger_cpu_mhz %u\n", hal_cpu_mhz());
+  IsrProfile isr[ISR_MAX];
+  for (int i = 0; i < ISR_MAX; i++)
+    get_isr_profile(i, &isr[i]);
+  APPEND("# TYPE multigeiger_isr_calls_total counter\n");
+  for (int i = 0; i < ISR_MAX; i++)
+    APPEND("multigeiger_isr_calls_total{isr=\"%s\"} %.0f\n", isr[i].name, isr[i].entries);
+  APPEND("# TYPE multigeiger_isr_cycles gauge\n");
+  for (int i = 0; i < ISR_MAX; i++) {
+    APPEND("multigeiger_isr_cycles{isr=\"%s\",stat=\"min\"} %u\n", isr[i].name, isr[i].min);
+    APPEND("multigeiger_isr_cycles{isr=\"%s\",stat=\"avg\"} %u\n", isr[i].name, isr[i].avg);
+    APPEND("multigeiger_isr_cycles{isr=\"%s\",stat=\"p99\"} %u\n", isr[i].name, isr[i].p99);
+    APPEND("multigeiger_isr_cycles{isr=\"%s\",stat=\"max\"} %u\n", isr[i].name, isr[i].max);
+  }
+  APPEND("# TYPE multigeiger_uptime_seconds counter\n");
+  APPEND("multigeiger_uptime_seconds %lu\n", millis() / 1000);
+  return (len < size) ? len : size - 1;
+}
+
+int render_status(char *buf, int size) {
+  int len = 0;
+  HvHealth hv;
+  get_hv_health(&hv);
+  APPEND("{\"uptime_ms\":%lu,\"counts\":%lu,", millis(), gm_counts);
+  APPEND("\"rates\":{\"cps\":%.4f,\"usvph\":%.4f,\"acc_cps\":%.4f,\"acc_usvph\":%.4f},",
+         rates[0], rates[1], rates[2], rates[3]);
+  APPEND("\"hv\":{\"error\":%s,\"degraded\":%s,\"days_to_degraded\":%.1f,\"pulses_per_hour\":%lu},",
+         hv_error ? "true" : "false", hv.degraded ? "true" : "false", hv.days_to_degraded, hv.pulses_per_hour);
+  APPEND("\"uplinks\":{");
+  for (int i = 0; i < SINK_MAX; i++) {
+    APPEND("%s\"%s\":{\"ok\":%lu,\"error\":%lu,", i ? "," : "", sink_names[i], sinks[i].ok, sinks[i].error);
+    if (sinks[i].last_ok_ms)
+      APPEND("\"last_ok_s\":%lu}", (millis() - sinks[i].last_ok_ms) / 1000);
+    else
+      APPEND("\"last_ok_s\":null}");
+  }
+  APPEND("},\"rssi\":%d,", (WiFi.status() == WL_CONNECTED) ? WiFi.RSSI() : 0);
+  APPEND("\"history\":[%u,%u,%u]}\n", history_next_seq(HISTORY_SECONDS), history_next_seq(HISTORY_MINUTES),
+         history_next_seq(HISTORY_HOURS));
+  return (len < size) ? len : size - 1;
+}
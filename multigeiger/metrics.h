@@ -0,0 +1,27 @@
+// live metrics for monitoring, exported in Prometheus text format via the web server (/metrics)
+
+#ifndef _METRICS_H_
+#define _METRICS_H_
+
+// data sinks we count uploads for
+#define SINK_SCOMM 0
+#define SINK_MADAVI 1
+#define SINK_TTN 2
+#define SINK_MQTT 3
+#define SINK_CUSTOMSRV 4
+#define SINK_MAX 5
+
+void metrics_gm(unsigned long counts, unsigned long hv_pulses, bool hv_error);
+void metrics_rates(float count_rate, float dose_rate, float accumulated_count_rate, float accumulated_dose_rate);
+void metrics_upload(int sink, bool ok, unsigned long duration_ms);
+void metrics_loop(unsigned long duration_ms);
+void metrics_display(unsigned long bytes, unsigned long duration_us);
+void metrics_thp(bool ok, unsigned long latency_ms, unsigned long read_us);
+
+// render all metrics into buf (no heap allocation), returns the length of the text.
+int render_metrics(char *buf, int size);
+
+// render the current values for the web dashboard as (small) JSON into buf, returns the length.
+int render_status(char *buf, int size);
+
+#endif // _METRICS_H_
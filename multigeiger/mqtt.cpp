@@ -0,0 +1,70 @@
+// MQTT related code
+// - persistent connection to a MQTT broker, publishing of messages
+//
+// We use the MQTT client of ESP-IDF (esp-mqtt), it runs in its own task,
+// reconnects automatically and retransmits unacknowledged QoS 1 messages.
+
+#include <Arduino.h>
+#include <mqtt_client.h>
+
+#include "log.h"
+#include "mqtt.h"
+
+static esp_mqtt_client_handle_t client = NULL;
+
+// updated from the esp-mqtt task
+static volatile bool connected = false;
+static volatile int last_acked_msg_id = 0;
+
+static esp_err_t mqtt_event_handler(esp_mqtt_event_handle_t event) {
+  switch (event->event_id) {
+  case MQTT_EVENT_CONNECTED:
+    connected = true;
+    break;
+  case MQTT_EVENT_DISCONNECTED:
+    connected = false;
+    break;
+  case MQTT_EVENT_PUBLISHED:
+    last_acked_msg_id = event->msg_id;
+    break;
+  default:
+    break;
+  }
+  return ESP_OK;
+}
+
+void setup_mqtt(const char *uri, const char *user, const char *password, const char *client_id) {
+  // note: esp_mqtt_client_init copies all the strings, so the caller does not need to keep them.
+  esp_mqtt_client_config_t config;
+  memset(&config, 0, sizeof(config));
+  config.event_handle = mqtt_event_handler;
+  config.uri = uri;
+  config.client_id = client_id;
+  config.username = (strcmp(user, "") != 0) ? user : NULL;
+  config.password = (strcmp(password, "") != 0) ? password : NULL;
+  client = esp_mqtt_client_init(&config);
+  if (!client) {
+    log(ERROR, "MQTT client init failed, broker: %s", uri);
+    return;
+  }
+  esp_mqtt_client_start(client);
+  log(INFO, "MQTT client started, broker: %s", uri);
+}
+
+bool is_mqtt_started(void) {
+  return client != NULL;
+}
+
+bool is_mqtt_connected(void) {
+  return (client != NULL) && connected;
+}
+
+int mqtt_publish(const char *topic, const char *payload, int qos) {
+  if (!is_mqtt_connected())
+    return -1;
+  return esp_mqtt_client_publish(client, topic, payload, strlen(payload), qos, 0);
+}
+
+int mqtt_last_acked(void) {
+  return last_acked_msg_id;
+}
@@ -0,0 +1,17 @@
+// MQTT related code
+// - persistent connection to a MQTT broker, publishing of messages
+
+#ifndef _MQTT_H_
+#define _MQTT_H_
+
+void setup_mqtt(const char *uri, const char *user, const char *password, const char *client_id);
+bool is_mqtt_started(void);
+bool is_mqtt_connected(void);
+
+// publish a message, returns the message id (or 0 for QoS 0) or -1 if publishing failed.
+int mqtt_publish(const char *topic, const char *payload, int qos);
+
+// returns the message id of the last QoS 1 message acknowledged by the broker.
+int mqtt_last_acked(void);
+
+#endif // _MQTT_H_
@@ -18,9 +18,14 @@
 #include "ble.h"
 #include "chkhardware.h"
 #include "clock.h"
-
-// Measurement interval (default 2.5min) [sec]
-#define MEASUREMENT_INTERVAL 150
+#include "metrics.h"
+#include "stream.h"
+#include "history.h"
+#include "lowpower.h"
+#include "boot.h"
+#include "hvhealth.h"
+#include "rates.h"
+#include "isrprof.h"
 
 // Max time the greeting display will be on. [msec]
 #define AFTERSTART 5000
@@ -31,6 +36,14 @@
 // Minimum amount of GM pulses required to early-update the display.
 #define MINCOUNTS 100
 
+// In which intervals the THP sensor is sampled. [msec]
+// The samples are averaged over the measurement interval.
+#define THP_SAMPLE_INTERVAL 10000
+
+// When the ISR profile (calls, execution times) is logged: first soon after boot, then regularly. [msec]
+#define ISR_PROFILE_FIRST_LOG 60000
+#define ISR_PROFILE_LOG_INTERVAL 3600000
+
 // Target loop duration [ms]
 // slow down the arduino main loop so it spins about once per LOOP_DURATION -
 #define LOOP_DURATION 1000
@@ -38,20 +51,39 @@
 // DIP switches
 static Switches switches;
 
+// low power mode active? (see LOW_POWER_MODE)
+static bool lowpower_active = false;
+
+// THP samples of the current measurement interval
+static ThpStats thp_stats;
+
 
 void setup() {
+  // start counting first, so we do not lose the pulses while the rest of the setup runs.
+  setup_tube();
+  boot_stage("tube");
   bool isLoraBoard = init_hwtest();
-  setup_log(DEFAULT_LOG_LEVEL);
+  boot_stage("hwtest");
+  setup_log((SERIAL_DEBUG == Serial_Binary_Log) ? NOLOG : DEFAULT_LOG_LEVEL);  // no text within the binary data
   setup_display(isLoraBoard);
+  boot_stage("display");
   setup_switches(isLoraBoard);
   switches = read_switches();  // only read DIP switches once at boot time
   setup_thp_sensor();
+  boot_stage("thp");
   setup_webconf(isLoraBoard);
+  boot_stage("webconf");
   setup_speaker(playSound, ledTick && switches.led_on, speakerTick && switches.speaker_on);
+  boot_stage("speaker");
+  setup_ble(ssid, sendToBle && switches.ble_on);  // runs in parallel, logs its stage when done
   setup_transmission(VERSION_STR, ssid, isLoraBoard);
-  setup_ble(ssid, sendToBle && switches.ble_on);
+  boot_stage("transmission");
   setup_log_data(SERIAL_DEBUG);
-  setup_tube();
+  setup_history();  // the first boot formats the flash filesystem, this takes a while
+  boot_stage("history");
+  setup_hv_health();
+  boot_stage("setup");
+  log_boot_timeline();
   log(DEBUG, "All Setup done");
 }
 
@@ -109,60 +141,42 @@ int update_ble_status(void) {  // currently no error detection
 
 void publish(unsigned long current_ms, unsigned long current_counts, unsigned long gm_count_timestamp, unsigned long current_hv_pulses,
              float temperature, float humidity, float pressure) {
-  static unsigned long last_timestamp = millis();
-  static unsigned long last_counts = 0;
+  static Rates rates;
+  static bool rates_initialized = false;
   static unsigned long last_hv_pulses = 0;
-  static unsigned long last_count_timestamp = 0;
-  static unsigned int accumulated_GMC_counts = 0;
-  static unsigned long accumulated_time = 0;
-  static float accumulated_Count_Rate = 0.0, accumulated_Dose_Rate = 0.0;
 
-  if (((current_counts - last_counts) >= MINCOUNTS) || ((current_ms - last_timestamp) >= DISPLAYREFRESH)) {
-    if ((gm_count_timestamp == 0) && (last_count_timestamp == 0)) {
-      // seems like there was no GM pulse yet and everything is still in initial state.
-      // get out of here, we can't do anything useful now.
-      return;
-    }
-    last_timestamp = current_ms;
+  if (!rates_initialized) {
+    init_rates(&rates, millis(), MINCOUNTS, DISPLAYREFRESH, tubes[TUBE_TYPE].cps_to_uSvph);
+    rates_initialized = true;
+  }
+
+  int result = update_rates(&rates, current_ms, current_counts, gm_count_timestamp);
+  if (result == RATES_NO_PULSES)
+    return;  // no GM pulse yet, nothing useful to show
+  if (result == RATES_UPDATED) {
     int hv_pulses = current_hv_pulses - last_hv_pulses;
     last_hv_pulses = current_hv_pulses;
-    int counts = current_counts - last_counts;
-    last_counts = current_counts;
-    int dt = gm_count_timestamp - last_count_timestamp;
-    last_count_timestamp = gm_count_timestamp;
-
-    accumulated_time += dt;
-    accumulated_GMC_counts = current_counts;
-
-    float GMC_factor_uSvph = tubes[TUBE_TYPE].cps_to_uSvph;
-
-    // calculate the current count rate and dose rate
-    float Count_Rate = (dt != 0) ? (float)counts * 1000.0 / (float)dt : 0.0;
-    float Dose_Rate = Count_Rate * GMC_factor_uSvph;
-
-    // calculate the count rate and dose rate over the complete time from start
-    accumulated_Count_Rate = (accumulated_time != 0) ? (float)accumulated_GMC_counts * 1000.0 / (float)accumulated_time : 0.0;
-    accumulated_Dose_Rate = accumulated_Count_Rate * GMC_factor_uSvph;
+    metrics_rates(rates.count_rate, rates.dose_rate, rates.accumulated_count_rate, rates.accumulated_dose_rate);
 
     // ... and update the data on display, notify via BLE
-    update_bledata((unsigned int)(Count_Rate * 60));
-    display_GMC((unsigned int)(accumulated_time / 1000), (int)(accumulated_Dose_Rate * 1000), (int)(Count_Rate * 60),
-                (showDisplay && switches.display_on));
+    update_bledata((unsigned int)(rates.count_rate * 60));
+    display_GMC((unsigned int)(rates.accumulated_time / 1000), (int)(rates.accumulated_dose_rate * 1000), (int)(rates.count_rate * 60),
+                (showDisplay && switches.display_on && !lowpower_active), showSparkline);
 
     // Sound local alarm?
-    if (soundLocalAlarm && GMC_factor_uSvph > 0) {
-      if (accumulated_Dose_Rate > localAlarmThreshold) {
-        log(WARNING, "Local alarm: Accumulated dose of %.3f µSv/h above threshold at %.3f µSv/h", accumulated_Dose_Rate, localAlarmThreshold);
+    if (soundLocalAlarm) {
+      int reason = check_alarm(&rates, localAlarmThreshold, localAlarmFactor);
+      if (reason == ALARM_THRESHOLD)
+        log(WARNING, "Local alarm: Accumulated dose of %.3f µSv/h above threshold at %.3f µSv/h", rates.accumulated_dose_rate, localAlarmThreshold);
+      else if (reason == ALARM_FACTOR)
+        log(WARNING, "Local alarm: Current dose of %.3f > %d x accumulated dose of %.3f µSv/h", rates.dose_rate, localAlarmFactor, rates.accumulated_dose_rate);
+      if (reason != ALARM_NONE)
         alarm();
-      } else if (Dose_Rate > (accumulated_Dose_Rate * localAlarmFactor)) {
-        log(WARNING, "Local alarm: Current dose of %.3f > %d x accumulated dose of %.3f µSv/h", Dose_Rate, localAlarmFactor, accumulated_Dose_Rate);
-        alarm();
-      }
     }
 
     if (Serial_Print_Mode == Serial_Logging) {
-      log_data(counts, dt, Count_Rate, Dose_Rate, hv_pulses,
-               accumulated_GMC_counts, accumulated_time, accumulated_Count_Rate, accumulated_Dose_Rate,
+      log_data(rates.counts, rates.dt, rates.count_rate, rates.dose_rate, hv_pulses,
+               rates.accumulated_counts, rates.accumulated_time, rates.accumulated_count_rate, rates.accumulated_dose_rate,
                temperature, humidity, pressure);
     }
   } else {
@@ -172,7 +186,7 @@ void publish(unsigned long current_ms, unsigned long current_counts, unsigned lo
     if (afterStartTime && ((current_ms - boot_timestamp) >= afterStartTime)) {
       afterStartTime = 0;
       update_bledata(0);
-      display_GMC(0, 0, 0, (showDisplay && switches.display_on));
+      display_GMC(0, 0, 0, (showDisplay && switches.display_on && !lowpower_active), showSparkline);
     }
   }
 }
@@ -201,24 +215,37 @@ void statistics_log(unsigned long current_counts, unsigned int time_between) {
   }
 }
 
-void read_THP(unsigned long current_ms,
+void read_THP(unsigned long current_ms, ThpStats *stats,
               bool *have_thp, float *temperature, float *humidity, float *pressure) {
   static unsigned long last_timestamp = 0;
-  // first call: immediately query thp sensor
-  // subsequent calls: only query every MEASUREMENT_INTERVAL
-  if (!last_timestamp || (current_ms - last_timestamp) >= (MEASUREMENT_INTERVAL * 1000)) {
+  // first call: immediately trigger a thp sensor conversion
+  // subsequent calls: trigger it every THP_SAMPLE_INTERVAL.
+  // the result is collected by one of the next calls, we never wait for the sensor.
+  if (!last_timestamp || (current_ms - last_timestamp) >= THP_SAMPLE_INTERVAL) {
     last_timestamp = current_ms;
-    *have_thp = read_thp_sensor(temperature, humidity, pressure);
+    if (!start_thp_reading())
+      *have_thp = false;
+  }
+  float t, h, p;
+  int st = poll_thp_sensor(&t, &h, &p);
+  if (st == THP_DONE) {
+    *temperature = t;
+    *humidity = h;
+    *pressure = p;
+    *have_thp = true;
+    thp_stats_add(stats, t, h, p);
+  } else if (st == THP_FAILED) {
+    *have_thp = false;
   }
 }
 
 void transmit(unsigned long current_ms, unsigned long current_counts, unsigned long gm_count_timestamp, unsigned long current_hv_pulses,
-              bool have_thp, float temperature, float humidity, float pressure, int wifi_status) {
+              ThpStats *thp, int wifi_status) {
   static unsigned long last_counts = 0;
   static unsigned long last_hv_pulses = 0;
   static unsigned long last_timestamp = millis();
   static unsigned long last_count_timestamp = 0;
-  if ((current_ms - last_timestamp) >= (MEASUREMENT_INTERVAL * 1000)) {
+  if ((current_ms - last_timestamp) >= (measurementInterval * 1000)) {
     if ((gm_count_timestamp == 0) && (last_count_timestamp == 0)) {
       // seems like there was no GM pulse yet and everything is still in initial state.
       // get out of here, we can't do anything useful now.
@@ -238,10 +265,20 @@ void transmit(unsigned long current_ms, unsigned long current_counts, unsigned l
     log(DEBUG, "Measured GM: cpm= %d HV=%d", current_cpm, hv_pulses);
 
     transmit_data(tubes[TUBE_TYPE].type, tubes[TUBE_TYPE].nbr, dt, hv_pulses, counts, current_cpm,
-                  have_thp, temperature, humidity, pressure, wifi_status);
+                  thp, wifi_status);
+    thp_stats_reset(thp);  // next interval
   }
 }
 
+void enter_lowpower(void) {
+  log(INFO, "Entering low power mode: WiFi, display and ticks off, GM pulses counted by ULP.");
+  iotWebConf.goOffLine();
+  tick_enable(false);
+  display_power(false);
+  tube_use_ulp();
+  lowpower_active = true;
+}
+
 void loop() {
   static bool hv_error = false;  // true means a HV capacitor charging issue
 
@@ -270,14 +307,22 @@ void loop() {
   unsigned int gm_count_time_between;
 
   read_GMC(&gm_counts, &gm_count_timestamp, &gm_count_time_between);
+  static bool first_count_logged = false;
+  if (gm_counts && !first_count_logged) {
+    log(INFO, "Boot: time to first count: %lu ms", first_count_us() / 1000);
+    first_count_logged = true;
+  }
 
-  read_THP(current_ms, &have_thp, &temperature, &humidity, &pressure);
+  read_THP(current_ms, &thp_stats, &have_thp, &temperature, &humidity, &pressure);
 
   read_hv(&hv_error, &hv_pulses);
-  set_status(STATUS_HV, hv_error ? ST_HV_ERROR : ST_HV_OK);
+  hv_health_sample(current_ms, hv_pulses, have_thp, temperature, humidity);
+  set_status(STATUS_HV, hv_error ? ST_HV_ERROR : (hv_health_degraded() ? ST_HV_DEGRADED : ST_HV_OK));
+  metrics_gm(gm_counts, hv_pulses, hv_error);
 
   int wifi_status = update_wifi_status();
   setup_ntp(wifi_status);
+  sync_clock();
 
   update_ble_status();
 
@@ -286,15 +331,39 @@ void loop() {
 
   publish(current_ms, gm_counts, gm_count_timestamp, hv_pulses, temperature, humidity, pressure);
 
+  poll_stream(current_ms, gm_counts);
+
+  history_sample(current_ms, clock_is_set() ? epoch_us() / 1000000 : 0, gm_counts, have_thp, temperature, humidity, pressure);
+
+  update_ble_telemetry(current_ms, gm_counts, hv_error, have_thp, temperature, humidity, pressure);
+
   if (Serial_Print_Mode == Serial_One_Minute_Log)
     one_minute_log(current_ms, gm_counts);
 
   if (Serial_Print_Mode == Serial_Statistics_Log)
     statistics_log(gm_counts, gm_count_time_between);
 
-  transmit(current_ms, gm_counts, gm_count_timestamp, hv_pulses, have_thp, temperature, humidity, pressure, wifi_status);
+  if (Serial_Print_Mode == Serial_Binary_Log)
+    log_data_binary(current_ms, gm_counts, hv_pulses, hv_error, have_thp, temperature, humidity, pressure);
+
+  transmit(current_ms, gm_counts, gm_count_timestamp, hv_pulses, &thp_stats, wifi_status);
+
+  static unsigned long isr_profile_next_log = ISR_PROFILE_FIRST_LOG;
+  if (ISR_PROFILE && ((long)(current_ms - isr_profile_next_log) >= 0)) {
+    log_isr_profile();
+    isr_profile_next_log = current_ms + ISR_PROFILE_LOG_INTERVAL;
+  }
+
+  flush_status();  // once per loop, for all status changes above
+
+  if (LOW_POWER_MODE && !lowpower_active && (current_ms > LOW_POWER_GRACE_PERIOD))
+    enter_lowpower();
 
   long loop_duration;
   loop_duration = millis() - current_ms;
-  iotWebConf.delay((loop_duration < LOOP_DURATION) ? (LOOP_DURATION - loop_duration) : 0);
+  metrics_loop(loop_duration);
+  if (lowpower_active)
+    lowpower_sleep((loop_duration < LOOP_DURATION) ? (LOOP_DURATION - loop_duration) : 0);
+  else
+    iotWebConf.delay((loop_duration < LOOP_DURATION) ? (LOOP_DURATION - loop_duration) : 0);
 }
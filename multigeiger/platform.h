@@ -0,0 +1,122 @@
+// thin hardware abstraction layer: time, GPIO, critical sections, timers, NVS.
+//
+// the measurement core (tube, timers, rates) only uses these, so it also builds on Linux.
+// ESP32: time, GPIO and critical sections are inline (usable from IRAM ISRs), the rest is
+// in platform_esp32.cpp. Linux: platform_linux.cpp, with a virtual clock for simulations.
+
+#ifndef _PLATFORM_H_
+#define _PLATFORM_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef ARDUINO
+
+#include <Arduino.h>
+
+#define HAL_IRAM IRAM_ATTR
+
+typedef portMUX_TYPE hal_mux_t;
+#define HAL_MUX_INITIALIZER portMUX_INITIALIZER_UNLOCKED
+#define hal_enter_critical(mux) portENTER_CRITICAL(mux)
+#define hal_exit_critical(mux) portEXIT_CRITICAL(mux)
+#define hal_enter_critical_isr(mux) portENTER_CRITICAL_ISR(mux)
+#define hal_exit_critical_isr(mux) portEXIT_CRITICAL_ISR(mux)
+
+static inline unsigned long hal_millis(void) {
+  return millis();
+}
+
+static inline unsigned long hal_micros(void) {
+  return micros();
+}
+
+static inline void hal_pin_mode(int pin, int mode) {
+  pinMode(pin, mode);
+}
+
+static inline void hal_digital_write(int pin, int level) {
+  digitalWrite(pin, level);
+}
+
+static inline int hal_digital_read(int pin) {
+  return digitalRead(pin);
+}
+
+// CPU cycle counter (per core, wraps around), for profiling
+static inline uint32_t hal_cycles(void) {
+  return ESP.getCycleCount();
+}
+
+static inline unsigned int hal_cpu_mhz(void) {
+  return getCpuFrequencyMhz();
+}
+
+#else  // Linux
+
+#define HAL_IRAM
+
+#define LOW 0
+#define HIGH 1
+#define INPUT 0x01
+#define OUTPUT 0x02
+#define RISING 0x01
+#define FALLING 0x02
+
+// the simulation runs "ISRs" and the main code in one thread, so there is nothing to lock.
+typedef struct {
+  int nesting;
+} hal_mux_t;
+#define HAL_MUX_INITIALIZER {0}
+#define hal_enter_critical(mux) ((mux)->nesting++)
+#define hal_exit_critical(mux) ((mux)->nesting--)
+#define hal_enter_critical_isr(mux) hal_enter_critical(mux)
+#define hal_exit_critical_isr(mux) hal_exit_critical(mux)
+
+// like on the ESP32, micros() is 32bit and wraps around after ~72 minutes.
+unsigned long hal_millis(void);
+unsigned long hal_micros(void);
+void hal_pin_mode(int pin, int mode);
+void hal_digital_write(int pin, int level);
+int hal_digital_read(int pin);
+// "cycles" are host nanoseconds here (so hal_cpu_mhz() is 1000)
+uint32_t hal_cycles(void);
+unsigned int hal_cpu_mhz(void);
+
+// virtual time / hardware control for simulations:
+uint64_t hal_sim_time_us(void);
+// virtual power cycle: clock back to 0, timers stopped, ISRs detached, pins low (NVS and files are kept).
+void hal_sim_reset(void);
+// advance the virtual clock by us, running the timer ISRs that are due on the way.
+void hal_sim_advance(uint64_t us);
+// drive an input pin, runs the attached ISR on a matching edge.
+void hal_sim_set_pin(int pin, int level);
+// called on every hal_digital_write(), so a simulation can model the hardware reacting to outputs.
+void hal_sim_write_hook(void (*hook)(int pin, int level));
+// called on every hal_fs_read(), so a simulation can model another task writing meanwhile.
+void hal_sim_fs_read_hook(void (*hook)(const char *path));
+// size of the simulated flash filesystem (default: 1.5MB, like the default partition scheme).
+void hal_sim_fs_size(size_t size);
+
+#endif
+
+// attach an ISR to a GPIO edge (RISING / FALLING)
+void hal_attach_interrupt(int pin, void (*isr)(void), int mode);
+void hal_detach_interrupt(int pin);
+
+// call isr every period_us, from a hw timer interrupt
+void hal_timer_start(int timer_no, void (*isr)(void), unsigned long period_us);
+
+// non-volatile storage of small blobs, returns the length read / written, 0 on failure.
+size_t hal_nvs_get(const char *ns, const char *key, void *buf, size_t len);
+size_t hal_nvs_set(const char *ns, const char *key, const void *buf, size_t len);
+void hal_nvs_remove(const char *ns, const char *key);
+
+// files on the flash filesystem (SPIFFS). writing at offset == file size appends.
+bool hal_fs_mount(void);
+size_t hal_fs_size(void);  // total size [bytes]
+size_t hal_fs_read(const char *path, size_t offset, void *buf, size_t len);
+size_t hal_fs_write(const char *path, size_t offset, const void *buf, size_t len);
+void hal_fs_remove(const char *path);
+
+#endif // _PLATFORM_H_
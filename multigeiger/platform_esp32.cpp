@@ -0,0 +1,80 @@
+// thin hardware abstraction layer, ESP32 (Arduino) implementation, see platform.h
+
+#ifdef ARDUINO
+
+#include <Arduino.h>
+#include <Preferences.h>
+#include <SPIFFS.h>
+
+#include "platform.h"
+
+void hal_attach_interrupt(int pin, void (*isr)(void), int mode) {
+  attachInterrupt(digitalPinToInterrupt(pin), isr, mode);
+}
+
+void hal_detach_interrupt(int pin) {
+  detachInterrupt(digitalPinToInterrupt(pin));
+}
+
+void hal_timer_start(int timer_no, void (*isr)(void), unsigned long period_us) {
+  hw_timer_t *timer = timerBegin(timer_no, 80, true);  // prescaler: 80MHz / 80 == 1MHz
+  timerAttachInterrupt(timer, isr, true);  // set ISR
+  timerAlarmWrite(timer, period_us, true);  // set alarm after period, do repeat
+  timerWrite(timer, 0);
+  timerAlarmEnable(timer);
+}
+
+size_t hal_nvs_get(const char *ns, const char *key, void *buf, size_t len) {
+  Preferences prefs;
+  prefs.begin(ns, true);
+  size_t got = prefs.getBytes(key, buf, len);
+  prefs.end();
+  return got;
+}
+
+size_t hal_nvs_set(const char *ns, const char *key, const void *buf, size_t len) {
+  Preferences prefs;
+  prefs.begin(ns, false);
+  size_t put = prefs.putBytes(key, buf, len);
+  prefs.end();
+  return put;
+}
+
+void hal_nvs_remove(const char *ns, const char *key) {
+  Preferences prefs;
+  prefs.begin(ns, false);
+  prefs.remove(key);
+  prefs.end();
+}
+
+bool hal_fs_mount(void) {
+  return SPIFFS.begin(true);  // format if it can not be mounted
+}
+
+size_t hal_fs_size(void) {
+  return SPIFFS.totalBytes();
+}
+
+size_t hal_fs_read(const char *path, size_t offset, void *buf, size_t len) {
+  File f = SPIFFS.open(path, "r");
+  if (!f)
+    return 0;
+  size_t got = f.seek(offset) ? f.read((uint8_t *)buf, len) : 0;
+  f.close();
+  return got;
+}
+
+size_t hal_fs_write(const char *path, size_t offset, const void *buf, size_t len) {
+  File f = SPIFFS.open(path, SPIFFS.exists(path) ? "r+" : "w");
+  if (!f)
+    return 0;
+  size_t put = f.seek(offset) ? f.write((const uint8_t *)buf, len) : 0;
+  f.close();
+  return put;
+}
+
+void hal_fs_remove(const char *path) {
+  SPIFFS.remove(path);
+}
+
+#endif // ARDUINO
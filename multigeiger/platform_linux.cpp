@@ -0,0 +1,220 @@
+// thin hardware abstraction layer, Linux implementation with a virtual clock, see platform.h
+//
+// nothing happens by itself here: the simulation advances the clock (running the timer
+// ISRs that are due) and drives the input pins (running the GPIO ISRs).
+
+#ifndef ARDUINO
+
+#include <map>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string>
+#include <string.h>
+#include <time.h>
+
+#include "platform.h"
+#include "speaker.h"
+#include "lowpower.h"
+#include "log.h"
+
+#define HAL_PINS 40
+#define HAL_TIMERS 4
+
+typedef struct {
+  int mode;
+  int level;
+  void (*isr)(void);
+  int edge;
+} Pin;
+
+typedef struct {
+  void (*isr)(void);
+  uint64_t period_us;
+  uint64_t next_us;
+} Timer;
+
+static uint64_t now_us = 0;
+static Pin pins[HAL_PINS];
+static Timer timers[HAL_TIMERS];
+static std::map<std::string, std::string> nvs;
+static std::map<std::string, std::string> files;
+static size_t fs_size = 0x180000;
+static void (*write_hook)(int pin, int level) = NULL;
+static void (*fs_read_hook)(const char *path) = NULL;
+
+unsigned long hal_millis(void) {
+  return (uint32_t)(now_us / 1000);
+}
+
+unsigned long hal_micros(void) {
+  return (uint32_t)now_us;
+}
+
+void hal_pin_mode(int pin, int mode) {
+  if ((pin >= 0) && (pin < HAL_PINS))
+    pins[pin].mode = mode;
+}
+
+void hal_digital_write(int pin, int level) {
+  if ((pin < 0) || (pin >= HAL_PINS))
+    return;
+  pins[pin].level = level;
+  if (write_hook)
+    write_hook(pin, level);
+}
+
+int hal_digital_read(int pin) {
+  return ((pin >= 0) && (pin < HAL_PINS)) ? pins[pin].level : LOW;
+}
+
+uint32_t hal_cycles(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint32_t)(ts.tv_sec * 1000000000ULL + ts.tv_nsec);
+}
+
+unsigned int hal_cpu_mhz(void) {
+  return 1000;
+}
+
+void hal_attach_interrupt(int pin, void (*isr)(void), int mode) {
+  if ((pin >= 0) && (pin < HAL_PINS)) {
+    pins[pin].isr = isr;
+    pins[pin].edge = mode;
+  }
+}
+
+void hal_detach_interrupt(int pin) {
+  if ((pin >= 0) && (pin < HAL_PINS))
+    pins[pin].isr = NULL;
+}
+
+void hal_timer_start(int timer_no, void (*isr)(void), unsigned long period_us) {
+  if ((timer_no < 0) || (timer_no >= HAL_TIMERS) || !period_us)
+    return;
+  timers[timer_no].isr = isr;
+  timers[timer_no].period_us = period_us;
+  timers[timer_no].next_us = now_us + period_us;
+}
+
+uint64_t hal_sim_time_us(void) {
+  return now_us;
+}
+
+void hal_sim_reset(void) {
+  now_us = 0;
+  memset(pins, 0, sizeof(pins));
+  memset(timers, 0, sizeof(timers));
+}
+
+void hal_sim_advance(uint64_t us) {
+  uint64_t end_us = now_us + us;
+  for (;;) {
+    Timer *due = NULL;
+    for (int i = 0; i < HAL_TIMERS; i++)
+      if (timers[i].isr && (timers[i].next_us <= end_us) && (!due || (timers[i].next_us < due->next_us)))
+        due = &timers[i];
+    if (!due)
+      break;
+    now_us = due->next_us;
+    due->next_us += due->period_us;
+    due->isr();
+  }
+  now_us = end_us;
+}
+
+void hal_sim_set_pin(int pin, int level) {
+  if ((pin < 0) || (pin >= HAL_PINS))
+    return;
+  Pin *p = &pins[pin];
+  int old = p->level;
+  p->level = level;
+  if (p->isr && (old != level) && (((p->edge == RISING) && level) || ((p->edge == FALLING) && !level)))
+    p->isr();
+}
+
+void hal_sim_write_hook(void (*hook)(int pin, int level)) {
+  write_hook = hook;
+}
+
+size_t hal_nvs_get(const char *ns, const char *key, void *buf, size_t len) {
+  auto it = nvs.find(std::string(ns) + "/" + key);
+  if ((it == nvs.end()) || (it->second.size() > len))
+    return 0;
+  memcpy(buf, it->second.data(), it->second.size());
+  return it->second.size();
+}
+
+size_t hal_nvs_set(const char *ns, const char *key, const void *buf, size_t len) {
+  nvs[std::string(ns) + "/" + key] = std::string((const char *)buf, len);
+  return len;
+}
+
+void hal_nvs_remove(const char *ns, const char *key) {
+  nvs.erase(std::string(ns) + "/" + key);
+}
+
+bool hal_fs_mount(void) {
+  return true;
+}
+
+size_t hal_fs_size(void) {
+  return fs_size;
+}
+
+void hal_sim_fs_size(size_t size) {
+  fs_size = size;
+}
+
+void hal_sim_fs_read_hook(void (*hook)(const char *path)) {
+  fs_read_hook = hook;
+}
+
+size_t hal_fs_read(const char *path, size_t offset, void *buf, size_t len) {
+  if (fs_read_hook)
+    fs_read_hook(path);
+  auto it = files.find(path);
+  if ((it == files.end()) || (offset > it->second.size()))
+    return 0;
+  if (len > it->second.size() - offset)
+    len = it->second.size() - offset;
+  memcpy(buf, it->second.data() + offset, len);
+  return len;
+}
+
+size_t hal_fs_write(const char *path, size_t offset, const void *buf, size_t len) {
+  std::string &f = files[path];
+  if (offset > f.size())
+    return 0;
+  if (offset + len > f.size())
+    f.resize(offset + len);
+  memcpy(&f[offset], buf, len);
+  return len;
+}
+
+void hal_fs_remove(const char *path) {
+  files.erase(path);
+}
+
+// the hardware specific parts of other modules used by the measurement core.
+// weak, so a simulation can provide its own (e.g. to count the ticks).
+
+__attribute__((weak)) void tick(bool high) {
+}
+
+__attribute__((weak)) void start_ulp_counter(int gpio, int dead_time_us) {
+}
+
+__attribute__((weak)) unsigned int read_ulp_counts(void) {
+  return 0;
+}
+
+__attribute__((weak)) void log_write(int level, const char *format, ...) {
+  va_list args;
+  va_start(args, format);
+  vfprintf(stderr, format, args);
+  va_end(args);
+  fputc('\n', stderr);
+}
+
+#endif // !ARDUINO
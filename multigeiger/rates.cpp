@@ -0,0 +1,55 @@
+// count rate / dose rate computation and local alarm decision (no hardware dependencies)
+
+#include "rates.h"
+
+void init_rates(Rates *r, unsigned long current_ms, unsigned int min_counts, unsigned long refresh_ms, float cps_to_uSvph) {
+  r->min_counts = min_counts;
+  r->refresh_ms = refresh_ms;
+  r->cps_to_uSvph = cps_to_uSvph;
+  r->last_timestamp = current_ms;
+  r->last_counts = 0;
+  r->last_count_timestamp = 0;
+  r->counts = 0;
+  r->dt = 0;
+  r->count_rate = r->dose_rate = 0.0;
+  r->accumulated_counts = 0;
+  r->accumulated_time = 0;
+  r->accumulated_count_rate = r->accumulated_dose_rate = 0.0;
+}
+
+int update_rates(Rates *r, unsigned long current_ms, unsigned long current_counts, unsigned long gm_count_timestamp) {
+  if (((current_counts - r->last_counts) < r->min_counts) && ((current_ms - r->last_timestamp) < r->refresh_ms))
+    return RATES_WAIT;
+  if ((gm_count_timestamp == 0) && (r->last_count_timestamp == 0)) {
+    // seems like there was no GM pulse yet and everything is still in initial state.
+    // we can't do anything useful now.
+    return RATES_NO_PULSES;
+  }
+  r->last_timestamp = current_ms;
+  r->counts = current_counts - r->last_counts;
+  r->last_counts = current_counts;
+  r->dt = gm_count_timestamp - r->last_count_timestamp;
+  r->last_count_timestamp = gm_count_timestamp;
+
+  r->accumulated_time += r->dt;
+  r->accumulated_counts = current_counts;
+
+  // calculate the current count rate and dose rate
+  r->count_rate = (r->dt != 0) ? (float)r->counts * 1000.0 / (float)r->dt : 0.0;
+  r->dose_rate = r->count_rate * r->cps_to_uSvph;
+
+  // calculate the count rate and dose rate over the complete time from start
+  r->accumulated_count_rate = (r->accumulated_time != 0) ? (float)r->accumulated_counts * 1000.0 / (float)r->accumulated_time : 0.0;
+  r->accumulated_dose_rate = r->accumulated_count_rate * r->cps_to_uSvph;
+  return RATES_UPDATED;
+}
+
+int check_alarm(const Rates *r, float threshold_uSvph, int factor) {
+  if (r->cps_to_uSvph <= 0)
+    return ALARM_NONE;  // unknown tube, no dose rates
+  if (r->accumulated_dose_rate > threshold_uSvph)
+    return ALARM_THRESHOLD;
+  if ((r->counts >= ALARM_FACTOR_MIN_COUNTS) && (r->dose_rate > (r->accumulated_dose_rate * factor)))
+    return ALARM_FACTOR;
+  return ALARM_NONE;
+}
@@ -0,0 +1,48 @@
+// count rate / dose rate computation and local alarm decision (no hardware dependencies)
+
+#ifndef _RATES_H_
+#define _RATES_H_
+
+// update_rates() results
+#define RATES_WAIT 0      // not yet time for a new computation
+#define RATES_NO_PULSES 1 // time for a new computation, but there was no GM pulse yet
+#define RATES_UPDATED 2   // new rates computed
+
+// check_alarm() results
+#define ALARM_NONE 0
+#define ALARM_THRESHOLD 1 // accumulated dose rate above threshold
+#define ALARM_FACTOR 2    // current dose rate above factor x accumulated dose rate
+
+// the factor alarm needs at least this many counts in the rate computation, with fewer the
+// current rate is too noisy (e.g. at 0.1 cps, 2 pulses close together looked like a big rise).
+#define ALARM_FACTOR_MIN_COUNTS 10
+
+typedef struct {
+  // configuration
+  unsigned int min_counts;        // compute new rates after this many counts ...
+  unsigned long refresh_ms;       // ... or after this time, whatever comes first
+  float cps_to_uSvph;             // tube conversion factor, 0.0 = unknown tube
+  // state
+  unsigned long last_timestamp;
+  unsigned long last_counts;
+  unsigned long last_count_timestamp;
+  // results of the last computation
+  int counts;                     // counts since the previous computation ...
+  int dt;                         // ... within this time [ms] (between the last pulses)
+  float count_rate;               // [cps]
+  float dose_rate;                // [uSv/h]
+  unsigned long accumulated_counts;
+  unsigned long accumulated_time; // [ms]
+  float accumulated_count_rate;   // since start [cps]
+  float accumulated_dose_rate;    // since start [uSv/h]
+} Rates;
+
+void init_rates(Rates *r, unsigned long current_ms, unsigned int min_counts, unsigned long refresh_ms, float cps_to_uSvph);
+
+// current_counts: total GM counts, gm_count_timestamp: [ms] of the last GM pulse (see read_GMC).
+int update_rates(Rates *r, unsigned long current_ms, unsigned long current_counts, unsigned long gm_count_timestamp);
+
+// decide whether to sound the local alarm, based on the last computed rates.
+int check_alarm(const Rates *r, float threshold_uSvph, int factor);
+
+#endif // _RATES_H_
@@ -0,0 +1,96 @@
+// sound sequencer: decides which tone to play when, with a queue of prioritized sound requests.
+// this does not depend on the hardware and gets the time passed in, so it can be tested
+// on a host with a virtual clock.
+
+#include <stddef.h>
+
+#include "sequencer.h"
+
+void sequencer_init(Sequencer *s) {
+  s->head = 0;
+  s->tail = 0;
+  s->current = NULL;
+  s->current_priority = 0;
+  s->current_silent = true;
+  s->next_ms = 0;
+  s->pending.sequence = NULL;
+  s->pending.priority = 0;
+  s->alarm_played = false;
+  s->alarm_ms = 0;
+}
+
+bool sequencer_request(Sequencer *s, const int *sequence, int priority) {
+  unsigned int tail = s->tail.load(std::memory_order_relaxed);
+  unsigned int next = (tail + 1) % SOUND_QUEUE_LEN;
+  if (next == s->head.load(std::memory_order_acquire))
+    return false;  // full
+  s->queue[tail].sequence = sequence;
+  s->queue[tail].priority = priority;
+  s->tail.store(next, std::memory_order_release);
+  return true;
+}
+
+static void start(Sequencer *s, SoundRequest *request, unsigned long now_ms) {
+  s->current = request->sequence;
+  s->current_priority = request->priority;
+  s->next_ms = now_ms;
+  if (request->priority == SOUND_ALARM) {
+    s->alarm_played = true;
+    s->alarm_ms = now_ms;
+  }
+}
+
+static void handle_request(Sequencer *s, SoundRequest *request, unsigned long now_ms) {
+  if (request->priority == SOUND_ALARM) {
+    bool alarm_playing = s->current && (s->current_priority == SOUND_ALARM);
+    if (alarm_playing || (s->alarm_played && (now_ms - s->alarm_ms < ALARM_HOLDOFF_MS)))
+      return;  // rate limited
+  }
+  if (!s->current || (request->priority >= s->current_priority)) {
+    start(s, request, now_ms);  // preempt
+  } else if (!s->pending.sequence || (request->priority >= s->pending.priority)) {
+    s->pending = *request;  // play it later
+  }
+}
+
+const int *sequencer_poll(Sequencer *s, unsigned long now_ms, unsigned long *wait_ms) {
+  unsigned int head = s->head.load(std::memory_order_relaxed);
+  while (head != s->tail.load(std::memory_order_acquire)) {
+    SoundRequest request = s->queue[head];
+    head = (head + 1) % SOUND_QUEUE_LEN;
+    s->head.store(head, std::memory_order_release);
+    handle_request(s, &request, now_ms);
+  }
+
+  const int *step = NULL;
+  if (s->current && ((long)(now_ms - s->next_ms) >= 0)) {
+    step = s->current;
+    int frequency_mHz = step[0], duration_ms = step[3];
+    s->current_silent = (frequency_mHz == 0);
+    if (duration_ms > 0) {
+      s->current += 4;
+      s->next_ms = now_ms + duration_ms;
+    } else {  // end of sequence, continue with the pending one (if any)
+      s->current = NULL;
+      s->current_priority = 0;
+      if (s->pending.sequence) {
+        start(s, &s->pending, now_ms);
+        s->pending.sequence = NULL;
+      }
+    }
+  }
+
+  if (!s->current)
+    *wait_ms = SEQUENCER_IDLE;
+  else if ((long)(s->next_ms - now_ms) > 0)
+    *wait_ms = s->next_ms - now_ms;
+  else
+    *wait_ms = 0;
+  return step;
+}
+
+bool sequencer_ticks_allowed(Sequencer *s) {
+  if (!s->current)
+    return true;
+  return (s->current_priority < SOUND_ALARM) && s->current_silent;
+}
@@ -0,0 +1,55 @@
+// sound sequencer: decides which tone to play when, with a queue of prioritized sound requests.
+// this does not depend on the hardware and gets the time passed in, so it can be tested
+// on a host with a virtual clock.
+
+#ifndef _SEQUENCER_H_
+#define _SEQUENCER_H_
+
+#include <atomic>
+
+// a sequence is an array of steps: frequency_mHz, volume, LED, duration_ms (== 0: last step)
+
+// priorities of sound requests. GM ticks are not queued (they are started from the GM ISR),
+// but they are only allowed while sequencer_ticks_allowed() says so.
+#define SOUND_MELODY 1  // ticks may play in the pauses of a melody
+#define SOUND_ALARM 2  // preempts melodies, suppresses ticks
+
+#define SOUND_QUEUE_LEN 4  // power of 2
+#define ALARM_HOLDOFF_MS 10000  // an alarm requested within this time after the last one is dropped
+
+#define SEQUENCER_IDLE 0xFFFFFFFFUL  // wait time if there is nothing to play
+
+typedef struct {
+  const int *sequence;
+  int priority;
+} SoundRequest;
+
+// requests must only be made from one task (the producer) and polled from one other task
+// (the consumer), then no locking is needed.
+typedef struct {
+  // lock-free single producer / single consumer queue
+  SoundRequest queue[SOUND_QUEUE_LEN];
+  std::atomic<unsigned int> head, tail;
+  // consumer state
+  const int *current;  // next step of the sequence being played
+  int current_priority;
+  bool current_silent;  // the current step is a pause
+  unsigned long next_ms;  // when the next step is due
+  SoundRequest pending;  // lower priority request, played after the current one
+  bool alarm_played;
+  unsigned long alarm_ms;  // when the last alarm started
+} Sequencer;
+
+void sequencer_init(Sequencer *s);
+
+// producer side: queue a sound request, returns false if the queue is full.
+bool sequencer_request(Sequencer *s, const int *sequence, int priority);
+
+// consumer side: process the queued requests and advance to now_ms. returns the step to
+// play now (or NULL), *wait_ms is set to the time until the next call is needed.
+const int *sequencer_poll(Sequencer *s, unsigned long now_ms, unsigned long *wait_ms);
+
+// may a GM tick be played now?
+bool sequencer_ticks_allowed(Sequencer *s);
+
+#endif // _SEQUENCER_H_
@@ -0,0 +1,45 @@
+// sparkline renderer for the OLED display, draws a series of values into display tiles.
+// this does not depend on the hardware, so it can be tested on a host by rendering into a buffer.
+
+#include <string.h>
+
+#include "sparkline.h"
+
+static void set_pixel(uint8_t *buf, int stride, int x, int y) {
+  buf[(y / 8) * stride + x] |= 1 << (y % 8);
+}
+
+void render_sparkline(const uint32_t *values, int count, uint8_t *buf, int width, int pages, int stride) {
+  for (int p = 0; p < pages; p++)
+    memset(buf + p * stride, 0, width);
+  if (count <= 0)
+    return;
+  if (count > width) {
+    values += count - width;
+    count = width;
+  }
+  uint32_t min = values[0], max = values[0];
+  for (int i = 1; i < count; i++) {
+    if (values[i] < min)
+      min = values[i];
+    if (values[i] > max)
+      max = values[i];
+  }
+  int height = pages * 8;
+  int x0 = width - count;
+  int prev_y = 0;
+  for (int i = 0; i < count; i++) {
+    int y;  // 0 is on top
+    if (max == min)
+      y = height / 2;
+    else
+      y = (height - 1) - (int)((uint64_t)(values[i] - min) * (height - 1) / (max - min));
+    if (i == 0)
+      prev_y = y;
+    // connect to the previous value with a vertical line, so steep changes stay visible
+    int y1 = (y < prev_y) ? y : prev_y, y2 = (y < prev_y) ? prev_y : y;
+    for (int py = y1; py <= y2; py++)
+      set_pixel(buf, stride, x0 + i, py);
+    prev_y = y;
+  }
+}
@@ -0,0 +1,16 @@
+// sparkline renderer for the OLED display, draws a series of values into display tiles.
+// this does not depend on the hardware, so it can be tested on a host by rendering into a buffer.
+
+#ifndef _SPARKLINE_H_
+#define _SPARKLINE_H_
+
+#include <stdint.h>
+
+// render values (oldest first) into a width x (pages * 8) pixels area of buf.
+// buf holds pages rows of tiles, stride bytes apart, in SSD1306 page format:
+// each byte is a column of 8 pixels, LSB on top.
+// the newest value is at the right edge, values are scaled between their min and max,
+// if there are more values than width pixels, only the newest ones are shown.
+void render_sparkline(const uint32_t *values, int count, uint8_t *buf, int width, int pages, int stride);
+
+#endif // _SPARKLINE_H_
@@ -1,27 +1,57 @@
 // speaker / sound related code
 // also handles the onboard LED, which lights up while speaker ticks.
-
-#include <Arduino.h>
-#include <driver/mcpwm.h>
-
+//
+// sound is generated by the RMT peripheral: a tone is a single RMT item (high level for the
+// tone duration), modulated by the RMT carrier running at the tone frequency. the N pin of
+// the piezo gets the inverted RMT output via the GPIO matrix (push-pull drive = high volume).
+// the LED is driven by a second RMT channel. once started, the hardware ends a tone / tick /
+// LED flash by itself, so there is no periodic timer interrupt and no CPU usage while silent.
+//
+// ticks are started directly from the GM ISR by writing to the RMT registers.
+// melodies and alarms are queued to the sequencer (see sequencer.h) and played by the
+// audio task, which sleeps until the next step is due or a new request arrives.
+//
+// this stays ESP32-only (RMT peripheral, FreeRTOS task), the sound / alarm scheduling logic is
+// in sequencer.cpp, which also builds on the host. GPIO, time and locking use the HAL anyway.
+
+#include <driver/rmt.h>
+#include <soc/rmt_struct.h>
+#include <rom/gpio.h>
+
+#include "platform.h"
 #include "speaker.h"
-#include "timers.h"
+#include "sequencer.h"
+#include "isrprof.h"
 
 #define PIN_SPEAKER_OUTPUT_P 12
 #define PIN_SPEAKER_OUTPUT_N 0
 
+#define SPEAKER_CHANNEL RMT_CHANNEL_0
+#define LED_CHANNEL RMT_CHANNEL_1
+
+// RMT source clock is REF_TICK, so the carrier (tone frequency) has 1us resolution.
+// the item durations use the divided clock, 100us resolution, max. 3.2s.
+#define RMT_SOURCE_HZ 1000000
+#define RMT_CLK_DIV 100
+#define RMT_TICKS(ms) ((ms) * (RMT_SOURCE_HZ / RMT_CLK_DIV / 1000))
+#define RMT_MAX_TICKS 32767
+
+// tick: 5kHz, tock: 1kHz, both 4ms - given as carrier half periods [us]
+#define TICK_HALF_PERIOD (RMT_SOURCE_HZ / 5000 / 2)
+#define TOCK_HALF_PERIOD (RMT_SOURCE_HZ / 1000 / 2)
+#define TICK_DURATION_MS 4
+
 // shall the speaker / LED "tick"?
 static volatile bool speaker_tick, led_tick;  // current state
 static bool speaker_tick_wanted, led_tick_wanted;  // state wanted by user
 
-// MUX (mutexes used for mutual exclusive access to isr variables)
-portMUX_TYPE mux_audio = portMUX_INITIALIZER_UNLOCKED;
+// MUX (mutexes used for mutual exclusive access to the RMT from ISR and audio task)
+hal_mux_t mux_audio = HAL_MUX_INITIALIZER;
 
-volatile int *isr_audio_sequence = NULL;
-volatile int *isr_tick_sequence = NULL;
-volatile int *isr_sequence = NULL;  // currently played sequence
+static volatile bool ticks_allowed = true;  // false: the audio task owns the speaker
+static Sequencer sequencer;
+static TaskHandle_t audio_task_handle;
 
-static int tick_sequence[8];
 static int alarm_sequence[12] = {
   // "high_Pitch"
   3000000, 1, -1, 400,  // frequency_mHz, volume, LED (-1 = don't touch), duration_ms
@@ -31,130 +61,83 @@ static int alarm_sequence[12] = {
   0, 0, -1, 0 // duration_ms = 0 --> END
 };
 
+static void HAL_IRAM rmt_pulse(rmt_channel_t channel, int duration) {
+  // output one pulse of duration RMT ticks, followed by the end marker.
+  // this just writes registers, so it can be called from an ISR.
+  rmt_item32_t item;
+  item.level0 = 1;
+  item.duration0 = duration;
+  item.level1 = 0;
+  item.duration1 = 1;
+  RMTMEM.chan[channel].data32[0].val = item.val;
+  RMTMEM.chan[channel].data32[1].val = 0;
+  RMT.conf_ch[channel].conf1.mem_rd_rst = 1;
+  RMT.conf_ch[channel].conf1.mem_rd_rst = 0;
+  RMT.conf_ch[channel].conf1.tx_start = 1;
+}
 
-// hw timer period and microseconds -> periods conversion
-#define PERIOD_DURATION_US 1000
-#define PERIODS(us) ((us) / PERIOD_DURATION_US)
-
-void IRAM_ATTR isr_audio() {
-  // this code is periodically called by a timer hw interrupt, always same period.
-  // we need to decide internally whether we actually want to do something.
-  //
-  // note: this is implemented like it is because dynamically reprogramming the hw timer
-  // to a different period would require us to call library functions like timerAlarmWrite
-  // which are **not** in IRAM (but in flash) and doing that can lead to spurious fatal
-  // exceptions like "Cache disabled but cached memory region accessed".
-  static unsigned int current = 0;  // current period counter
-  static unsigned int next = PERIODS(1000);  // periods to next sequencer execution
-  if (++current < next)
-    return;  // nothing to do yet
-
-  // we reached "next", so we execute the sequencer:
-  current = 0;
-
-  // tone and tick generation, also led blinking
-  int frequency_mHz = 0, volume = 0, led = 0, duration_ms = 0;  // init avoids compiler warning
-  static bool playing_audio = false, playing_tick = false;
-
-  // fetch next tone / next led state
-  portENTER_CRITICAL_ISR(&mux_audio);
-  if (!isr_sequence) {
-    if (isr_audio_sequence) {
-      isr_sequence = isr_audio_sequence;
-      playing_audio = true;
-    } else if (isr_tick_sequence) {
-      isr_sequence = isr_tick_sequence;
-      playing_tick = true;
-    }
-  }
-  volatile int *p = isr_sequence;
-  if (p) {
-    frequency_mHz = *p++;
-    volume = *p++;
-    led = *p++;
-    duration_ms = *p++;
-    isr_sequence = p;
-  }
-  portEXIT_CRITICAL_ISR(&mux_audio);
-
-  if (!p)
-    return;  // nothing to do
-  // do not access *p below here, p might point to uninitialized memory after the sequence array!
-
-  // note: by all means, **AVOID** mcpwm_set_duty() in ISR, causes floating point coprocessor troubles!
-  //       when just calling mcpwm_set_duty_**type**(), it will reuse a previously set duty cycle.
-  if (frequency_mHz > 0) { // speaker on
-    if (volume >= 1) {
-      // high volume - MCPWM A/B outputs generate inverted signals
-      mcpwm_set_duty_type(MCPWM_UNIT_0, MCPWM_TIMER_0, MCPWM_OPR_A, MCPWM_DUTY_MODE_0);
-      mcpwm_set_duty_type(MCPWM_UNIT_0, MCPWM_TIMER_0, MCPWM_OPR_B, MCPWM_DUTY_MODE_1);
-    } else {
-      // low volume - do MCPWM on A, keep B permanently low
-      mcpwm_set_duty_type(MCPWM_UNIT_0, MCPWM_TIMER_0, MCPWM_OPR_A, MCPWM_DUTY_MODE_0);
-      mcpwm_set_signal_low(MCPWM_UNIT_0, MCPWM_TIMER_0, MCPWM_OPR_B);
-    }
-    // set frequency
-    mcpwm_set_frequency(MCPWM_UNIT_0, MCPWM_TIMER_0, frequency_mHz / 1000);
-    // start outputting PWM signal(s)
-    mcpwm_start(MCPWM_UNIT_0, MCPWM_TIMER_0);
-  } else if (frequency_mHz == 0) {  // speaker off
-    // frequency_mHz == 0 -> disable sound output
-    // stop any PWM signals
-    mcpwm_stop(MCPWM_UNIT_0, MCPWM_TIMER_0);
-    // keep A high and B low (we have a piezo, no current flowing)
-    mcpwm_set_signal_high(MCPWM_UNIT_0, MCPWM_TIMER_0, MCPWM_OPR_A);
-    mcpwm_set_signal_low(MCPWM_UNIT_0, MCPWM_TIMER_0, MCPWM_OPR_B);
+static void HAL_IRAM set_tone(int half_period_us) {
+  RMT.carrier_duty_ch[SPEAKER_CHANNEL].high = half_period_us;
+  RMT.carrier_duty_ch[SPEAKER_CHANNEL].low = half_period_us;
+}
+
+static void set_volume(int volume) {
+  if (volume >= 1)  // high volume - N outputs the inverted signal of P
+    gpio_matrix_out(PIN_SPEAKER_OUTPUT_N, RMT_SIG_OUT0_IDX + SPEAKER_CHANNEL, true, false);
+  else {  // low volume - keep N permanently low
+    gpio_matrix_out(PIN_SPEAKER_OUTPUT_N, SIG_GPIO_OUT_IDX, false, false);
+    hal_digital_write(PIN_SPEAKER_OUTPUT_N, LOW);
   }
-  // frequency_mHz == -1 -> don't touch pwm/speaker
+}
 
+static void play_tone(int frequency_mHz, int volume, int led, int duration_ms) {
   if (led >= 0)  // led == -1 can be used as "don't touch LED"
-    digitalWrite(LED_BUILTIN, led ? HIGH : LOW);
+    rmt_set_idle_level(LED_CHANNEL, true, led ? RMT_IDLE_LEVEL_HIGH : RMT_IDLE_LEVEL_LOW);
+
+  if (frequency_mHz > 0) {  // speaker on
+    set_volume(volume);
+    int half_period_us = (long long)RMT_SOURCE_HZ * 1000 / frequency_mHz / 2;
+    int duration = RMT_TICKS(duration_ms);
+    hal_enter_critical(&mux_audio);
+    set_tone(half_period_us > 0xFFFF ? 0xFFFF : half_period_us);
+    rmt_pulse(SPEAKER_CHANNEL, duration > RMT_MAX_TICKS ? RMT_MAX_TICKS : duration);
+    hal_exit_critical(&mux_audio);
+  } else if (frequency_mHz == 0) {  // speaker off
+    rmt_tx_stop(SPEAKER_CHANNEL);  // output goes to idle level: P low, N high (piezo, no current flowing)
+    set_volume(1);  // ticks always use high volume
+  }
+  // frequency_mHz == -1 -> don't touch speaker
+}
 
-  if (duration_ms > 0) {
-    next = PERIODS(duration_ms * 1000);
-  } else {
-    // duration == 0 marks the end of the sequence to play
-    portENTER_CRITICAL_ISR(&mux_audio);
-    isr_sequence = NULL;
-    if (playing_tick) {
-      isr_tick_sequence = NULL;
-      playing_tick = false;
-    } else if (playing_audio) {
-      isr_audio_sequence = NULL;
-      playing_audio = false;
+static void audio_task(void *arg) {
+  for (;;) {
+    unsigned long wait_ms;
+    const int *step;
+    while ((step = sequencer_poll(&sequencer, hal_millis(), &wait_ms)) != NULL) {
+      // do not let a tick cut a tone short
+      ticks_allowed = false;
+      play_tone(step[0], step[1], step[2], step[3]);
+      ticks_allowed = sequencer_ticks_allowed(&sequencer);
     }
-    portEXIT_CRITICAL_ISR(&mux_audio);
-    next = PERIODS(1000);
+    // sleep until the next step is due or a new sound gets requested
+    ulTaskNotifyTake(pdTRUE, (wait_ms == SEQUENCER_IDLE) ? portMAX_DELAY : pdMS_TO_TICKS(wait_ms));
   }
 }
 
-void IRAM_ATTR tick(bool high) {
+void HAL_IRAM tick(bool high) {
   // high true: "tick" -> high frequency tick and LED blink
   // high false: "tock" -> lower frequency tock, no LED
   // called from ISR!
-  portENTER_CRITICAL_ISR(&mux_audio);
-
-  int *sequence;
-
-  // we expect speaker_tick or led_tick to change at any time,
-  // thus check it here and generate different sequences:
-  if (speaker_tick || led_tick) {
-    sequence = tick_sequence;
-    // "on"
-    sequence[0] = speaker_tick ? (high ? 5000000 : 1000000) : -1;  // frequency_mHz
-    sequence[1] = 1;  // volume
-    sequence[2] = led_tick ? (high ? 1 : -1) : -1;  // LED
-    sequence[3] = 4;  // duration_ms
-    // "off"
-    sequence[4] = speaker_tick ? 0 : -1;
-    sequence[5] = 0;
-    sequence[6] = led_tick ? (high ? 0 : -1) : -1;
-    sequence[7] = 0;  // END
-  } else
-    sequence = NULL;
-
-  isr_tick_sequence = sequence;
-  portEXIT_CRITICAL_ISR(&mux_audio);
+  uint32_t prof = isr_prof_start();
+  hal_enter_critical_isr(&mux_audio);
+  if (speaker_tick && ticks_allowed) {
+    set_tone(high ? TICK_HALF_PERIOD : TOCK_HALF_PERIOD);
+    rmt_pulse(SPEAKER_CHANNEL, RMT_TICKS(TICK_DURATION_MS));
+  }
+  if (led_tick && high)
+    rmt_pulse(LED_CHANNEL, RMT_TICKS(TICK_DURATION_MS));
+  hal_exit_critical_isr(&mux_audio);
+  isr_prof_end(ISR_TICK, prof);
 }
 
 void tick_enable(bool enable) {
@@ -169,46 +152,55 @@ void tick_enable(bool enable) {
   }
 }
 
+static void request(int *sequence, int priority) {
+  // requests must only be made from one task (the loop task), see sequencer.h
+  if (!sequencer_request(&sequencer, sequence, priority))
+    return;  // queue full, drop it
+  xTaskNotifyGive(audio_task_handle);
+}
+
 void alarm() {
   // play alarm sound, called from normal code (not ISR)
-  portENTER_CRITICAL(&mux_audio);
-  isr_audio_sequence = alarm_sequence;
-  portEXIT_CRITICAL(&mux_audio);
+  // preempts melodies, repeated alarms are rate limited by the sequencer.
+  request(alarm_sequence, SOUND_ALARM);
 }
 
 void play(int *sequence) {
   // play a tone sequence, called from normal code (not ISR)
-  portENTER_CRITICAL(&mux_audio);
-  isr_audio_sequence = sequence;
-  portEXIT_CRITICAL(&mux_audio);
+  request(sequence, SOUND_MELODY);
+}
+
+static void setup_rmt_channel(rmt_channel_t channel, int pin, bool carrier) {
+  rmt_config_t config = {};
+  config.rmt_mode = RMT_MODE_TX;
+  config.channel = channel;
+  config.gpio_num = (gpio_num_t)pin;
+  config.mem_block_num = 1;
+  config.clk_div = RMT_CLK_DIV;
+  config.tx_config.loop_en = false;
+  config.tx_config.carrier_en = carrier;
+  config.tx_config.carrier_freq_hz = 1000;  // overwritten for every tone, see set_tone()
+  config.tx_config.carrier_duty_percent = 50;
+  config.tx_config.carrier_level = RMT_CARRIER_LEVEL_HIGH;
+  config.tx_config.idle_output_en = true;
+  config.tx_config.idle_level = RMT_IDLE_LEVEL_LOW;
+  rmt_config(&config);
+  rmt_set_source_clk(channel, RMT_BASECLK_REF);
 }
 
 #define TONE(f, v, led, t) {int(f * 0.75), v, led, int(t * 85)}
 
 void setup_speaker(bool playSound, bool _led_tick, bool _speaker_tick) {
-  pinMode(LED_BUILTIN, OUTPUT);
-
-  mcpwm_gpio_init(MCPWM_UNIT_0, MCPWM0A, PIN_SPEAKER_OUTPUT_P);
-  mcpwm_gpio_init(MCPWM_UNIT_0, MCPWM0B, PIN_SPEAKER_OUTPUT_N);
+  setup_rmt_channel(SPEAKER_CHANNEL, PIN_SPEAKER_OUTPUT_P, true);
+  setup_rmt_channel(LED_CHANNEL, LED_BUILTIN, false);
+  hal_pin_mode(PIN_SPEAKER_OUTPUT_N, OUTPUT);
+  set_volume(1);
 
-  mcpwm_config_t pwm_config;
-  pwm_config.frequency = 1000;
-  // set duty cycles to 50% (and never modify them again!)
-  pwm_config.cmpr_a = 50.0;
-  pwm_config.cmpr_b = 50.0;
-  pwm_config.duty_mode = MCPWM_DUTY_MODE_0;  // active high duty
-  pwm_config.counter_mode = MCPWM_UP_COUNTER;
-  mcpwm_init(MCPWM_UNIT_0, MCPWM_TIMER_0, &pwm_config);
-
-  setup_audio_timer(isr_audio, PERIOD_DURATION_US);
+  sequencer_init(&sequencer);
+  xTaskCreate(audio_task, "audio", 2048, NULL, 3, &audio_task_handle);
 
   tick_enable(false);  // no ticking while we play melody / init sound
 
-  static int init[][4] = {
-    TONE(0, 0, 0, 0),        // speaker off, led off, end
-  };
-  play((int *)init);
-
   static int melody[][4] = {
     TONE(1174659, 1, -1, 2),  // D
     TONE(0, 0, -1, 2),        // ---
@@ -8,5 +8,6 @@ void setup_speaker(bool playSound, bool led_tick, bool speaker_tick);
 void tick_enable(bool enable);
 void tick(bool high);
 void alarm();
+void play(int *sequence);
 
 #endif // _SPEAKER_H_
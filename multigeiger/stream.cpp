@@ -0,0 +1,152 @@
+// live data streaming to local dashboards via Server-Sent Events (SSE)
+//
+// Events:
+// - counts: once per loop (about every second): {"ms": <uptime ms>, "counts": <counts since last event>, "total": <total counts>}
+// - pulses (only if requested with ?pulses=1): {"us": [<pulse timestamps [us]>], "dropped": <lost timestamps>}
+//
+// Each client has a small, fixed size queue of events. We never block on a slow client:
+// data is only written as far as the socket accepts it and if the queue is full, the
+// oldest (not yet partially sent) event gets dropped.
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include <lwip/sockets.h>
+
+#include "log.h"
+#include "tube.h"
+#include "stream.h"
+
+#define MAX_STREAM_CLIENTS 2
+#define EVENT_SLOTS 16  // per client
+#define EVENT_LEN 160  // max. length of one event, including SSE framing
+#define PULSES_PER_EVENT 8  // max. timestamps in one pulses event (must fit into EVENT_LEN)
+#define PULSE_EVENTS_PER_POLL 6  // more timestamps stay in the pulse ring buffer (which might overflow)
+
+typedef struct {
+  bool active;
+  bool pulses;  // client wants per-pulse timestamps
+  WiFiClient client;
+  char events[EVENT_SLOTS][EVENT_LEN];
+  int first, count;  // queue of events
+  int sent;  // bytes of the first event already sent
+  unsigned long dropped;  // events dropped due to a slow client
+} StreamClient;
+
+static StreamClient clients[MAX_STREAM_CLIENTS];
+
+static unsigned int pulse_position;  // our read position in the pulse timestamp ring buffer
+
+bool stream_add_client(WiFiClient &client, bool pulses) {
+  for (int i = 0; i < MAX_STREAM_CLIENTS; i++) {
+    StreamClient *c = &clients[i];
+    if (c->active)
+      continue;
+    // we write the response header ourselves, the web server would close the stream otherwise.
+    client.print("HTTP/1.1 200 OK\r\n"
+                 "Content-Type: text/event-stream\r\n"
+                 "Cache-Control: no-cache\r\n"
+                 "Connection: keep-alive\r\n"
+                 "Access-Control-Allow-Origin: *\r\n"
+                 "\r\n");
+    c->client = client;  // keeps the connection open after the web server releases its client
+    c->pulses = pulses;
+    c->first = c->count = c->sent = 0;
+    c->dropped = 0;
+    c->active = true;
+    log(INFO, "Stream client %d connected, pulses: %d", i, pulses);
+    return true;
+  }
+  return false;
+}
+
+static void remove_client(StreamClient *c) {
+  c->client.stop();
+  c->active = false;
+  log(INFO, "Stream client disconnected, dropped events: %lu", c->dropped);
+}
+
+static void queue_event(StreamClient *c, const char *event) {
+  if (c->count == EVENT_SLOTS) {
+    // queue full: drop the oldest event. if it is partially sent already, we must not
+    // drop it (that would corrupt the stream), so drop the one after it instead.
+    if (c->sent) {
+      int second = (c->first + 1) % EVENT_SLOTS;
+      memcpy(c->events[second], c->events[c->first], EVENT_LEN);
+    }
+    c->first = (c->first + 1) % EVENT_SLOTS;
+    c->count--;
+    c->dropped++;
+  }
+  int slot = (c->first + c->count) % EVENT_SLOTS;
+  strncpy(c->events[slot], event, EVENT_LEN - 1);
+  c->events[slot][EVENT_LEN - 1] = '\0';
+  c->count++;
+}
+
+static void queue_event_all(const char *event, bool pulses) {
+  for (int i = 0; i < MAX_STREAM_CLIENTS; i++) {
+    StreamClient *c = &clients[i];
+    if (c->active && (!pulses || c->pulses))
+      queue_event(c, event);
+  }
+}
+
+static void send_events(StreamClient *c) {
+  int fd = c->client.fd();
+  while (c->count) {
+    const char *event = c->events[c->first] + c->sent;
+    int len = strlen(event);
+    int rc = send(fd, event, len, MSG_DONTWAIT);
+    if (rc < 0) {
+      if ((errno != EAGAIN) && (errno != EWOULDBLOCK))
+        remove_client(c);
+      return;  // socket buffer full, try again next time
+    }
+    if (rc < len) {
+      c->sent += rc;
+      return;
+    }
+    c->sent = 0;
+    c->first = (c->first + 1) % EVENT_SLOTS;
+    c->count--;
+  }
+}
+
+void poll_stream(unsigned long current_ms, unsigned long counts) {
+  static unsigned long last_counts = 0;
+  char event[EVENT_LEN];
+  bool have_clients = false, want_pulses = false;
+  for (int i = 0; i < MAX_STREAM_CLIENTS; i++) {
+    if (clients[i].active && !clients[i].client.connected())
+      remove_client(&clients[i]);
+    have_clients |= clients[i].active;
+    want_pulses |= clients[i].active && clients[i].pulses;
+  }
+
+  if (have_clients) {
+    snprintf(event, EVENT_LEN, "event: counts\ndata: {\"ms\": %lu, \"counts\": %lu, \"total\": %lu}\n\n",
+             current_ms, counts - last_counts, counts);
+    queue_event_all(event, false);
+  }
+  last_counts = counts;
+
+  // always consume the pulse timestamps, so a new client does not get old ones
+  unsigned long timestamps[PULSES_PER_EVENT];
+  unsigned int dropped;
+  for (int e = 0; e < PULSE_EVENTS_PER_POLL; e++) {
+    int n = read_GMC_pulses(&pulse_position, timestamps, PULSES_PER_EVENT, &dropped);
+    if (!n && !dropped)
+      break;
+    if (want_pulses) {
+      int len = snprintf(event, EVENT_LEN, "event: pulses\ndata: {\"us\": [");
+      for (int i = 0; i < n; i++)
+        len += snprintf(event + len, EVENT_LEN - len, "%s%lu", i ? "," : "", timestamps[i]);
+      snprintf(event + len, EVENT_LEN - len, "], \"dropped\": %u}\n\n", dropped);
+      queue_event_all(event, true);
+    }
+  }
+
+  for (int i = 0; i < MAX_STREAM_CLIENTS; i++)
+    if (clients[i].active)
+      send_events(&clients[i]);
+}
@@ -0,0 +1,14 @@
+// live data streaming to local dashboards via Server-Sent Events (SSE)
+
+#ifndef _STREAM_H_
+#define _STREAM_H_
+
+#include <WiFi.h>
+
+// take over a client connection from the web server, returns false if we have no free slot.
+bool stream_add_client(WiFiClient &client, bool pulses);
+
+// queue the current data for all stream clients and send as much as possible without blocking.
+void poll_stream(unsigned long current_ms, unsigned long counts);
+
+#endif // _STREAM_H_
@@ -1,12 +1,14 @@
 // temperature, humidity, pressure sensor (usually a BME280) related code
 
 #include <Arduino.h>
+#include <Wire.h>
 
 #include <Adafruit_Sensor.h>
 #include <Adafruit_BME280.h>
 #include <Adafruit_BME680.h>
 
 #include "log.h"
+#include "metrics.h"
 #include "thp_sensor.h"
 
 static int type_thp = 0;
@@ -14,12 +16,42 @@ static int type_thp = 0;
 Adafruit_BME280 bme280;
 Adafruit_BME680 bme680;
 
+// BME280 forced mode: we trigger a conversion by writing the mode into the ctrl_meas register
+// (the library only has a blocking call for that) and poll the status register until it is done.
+#define BME280_REG_STATUS 0xF3
+#define BME280_REG_CTRL_MEAS 0xF4
+#define BME280_STATUS_MEASURING 0x08
+#define BME280_CTRL_MEAS_FORCED ((Adafruit_BME280::SAMPLING_X1 << 5) | (Adafruit_BME280::SAMPLING_X1 << 2) | Adafruit_BME280::MODE_FORCED)
+#define BME280_CONVERSION_MAX_MS 100  // datasheet: < 10ms at 1x oversampling
+
+static uint8_t bme280_address;
+static bool reading = false;  // a conversion is running
+static unsigned long reading_start_ms;
+
+static bool bme280_write(uint8_t reg, uint8_t value) {
+  Wire.beginTransmission(bme280_address);
+  Wire.write(reg);
+  Wire.write(value);
+  return Wire.endTransmission() == 0;
+}
+
+static int bme280_read(uint8_t reg) {
+  Wire.beginTransmission(bme280_address);
+  Wire.write(reg);
+  if ((Wire.endTransmission() != 0) || (Wire.requestFrom(bme280_address, (uint8_t)1) != 1))
+    return -1;
+  return Wire.read();
+}
+
 bool setup_thp_sensor(void) {
   // BME280
-  if (bme280.begin(BME280_ADDRESS))
+  if (bme280.begin(BME280_ADDRESS)) {
     type_thp = 280;
-  else if (bme280.begin(BME280_ADDRESS_ALTERNATE))
+    bme280_address = BME280_ADDRESS;
+  } else if (bme280.begin(BME280_ADDRESS_ALTERNATE)) {
     type_thp = 280;
+    bme280_address = BME280_ADDRESS_ALTERNATE;
+  }
 
   // BME680
   if (type_thp == 0) {
@@ -40,6 +72,12 @@ bool setup_thp_sensor(void) {
     log(INFO, "BME_Status: ok,  ID: BME680");
     break;
   case 280:
+    // forced mode: the sensor sleeps between our readings ("weather monitoring" settings)
+    bme280.setSampling(Adafruit_BME280::MODE_FORCED,
+                       Adafruit_BME280::SAMPLING_X1,  // temperature
+                       Adafruit_BME280::SAMPLING_X1,  // pressure
+                       Adafruit_BME280::SAMPLING_X1,  // humidity
+                       Adafruit_BME280::FILTER_OFF);
     log(INFO, "BME_Status: ok,  ID: BME280");
     break;
   default:
@@ -49,24 +87,94 @@ bool setup_thp_sensor(void) {
   return (type_thp > 0);
 }
 
-bool read_thp_sensor(float *temperature, float *humidity, float *pressure) {
+bool start_thp_reading(void) {
+  if (reading)
+    return true;  // still busy with the last one
+  bool ok = false;
+  if (type_thp == 280)
+    ok = bme280_write(BME280_REG_CTRL_MEAS, BME280_CTRL_MEAS_FORCED);
+  else if (type_thp == 680)
+    ok = (bme680.beginReading() != 0);
+  if (!ok)
+    return false;
+  reading = true;
+  reading_start_ms = millis();
+  return true;
+}
+
+int poll_thp_sensor(float *temperature, float *humidity, float *pressure) {
+  if (!reading)
+    return THP_IDLE;
+  unsigned long latency_ms = millis() - reading_start_ms;
+  bool ok;
+  unsigned long read_start_us;
   if (type_thp == 280) {
-    *temperature = bme280.readTemperature();
-    *humidity = bme280.readHumidity();
-    *pressure = bme280.readPressure();
-  } else if (type_thp == 680) {
-    if (!bme680.performReading()) {
-      log(INFO, "BME680: Failed to perform reading");
-      return false;
+    int status = bme280_read(BME280_REG_STATUS);
+    if ((status >= 0) && (status & BME280_STATUS_MEASURING) && (latency_ms < BME280_CONVERSION_MAX_MS))
+      return THP_BUSY;
+    read_start_us = micros();
+    ok = (status >= 0) && !(status & BME280_STATUS_MEASURING);
+    if (ok) {
+      *temperature = bme280.readTemperature();
+      *humidity = bme280.readHumidity();
+      *pressure = bme280.readPressure();
+    }
+  } else {  // 680
+    if (bme680.remainingReadingMillis() > 0)
+      return THP_BUSY;
+    read_start_us = micros();
+    ok = bme680.endReading();  // conversion is done, so this does not wait
+    if (ok) {
+      *temperature = bme680.temperature;
+      *humidity = bme680.humidity;
+      *pressure = bme680.pressure;
     }
-    *temperature = bme680.temperature;
-    *humidity = bme680.humidity;
-    *pressure = bme680.pressure;
-  } else {
-    *temperature = 0.0;
-    *humidity = 0.0;
-    *pressure = 0.0;
   }
-  return (type_thp > 0);
+  reading = false;
+  metrics_thp(ok, latency_ms, micros() - read_start_us);
+  if (!ok) {
+    log(INFO, "BME%d: Failed to perform reading", type_thp);
+    return THP_FAILED;
+  }
+  return THP_DONE;
 }
 
+static void accu_add(ThpAccu *accu, float value) {
+  if (!accu->count || (value < accu->min))
+    accu->min = value;
+  if (!accu->count || (value > accu->max))
+    accu->max = value;
+  accu->sum += value;
+  accu->count++;
+}
+
+void thp_stats_reset(ThpStats *stats) {
+  memset(stats, 0, sizeof(ThpStats));
+}
+
+void thp_stats_add(ThpStats *stats, float temperature, float humidity, float pressure) {
+  accu_add(&stats->temperature, temperature);
+  accu_add(&stats->humidity, humidity);
+  accu_add(&stats->pressure, pressure);
+}
+
+static void accu_merge(ThpAccu *dest, const ThpAccu *src) {
+  if (!src->count)
+    return;
+  if (!dest->count || (src->min < dest->min))
+    dest->min = src->min;
+  if (!dest->count || (src->max > dest->max))
+    dest->max = src->max;
+  dest->sum += src->sum;
+  dest->count += src->count;
+}
+
+void thp_stats_merge(ThpStats *dest, const ThpStats *src) {
+  accu_merge(&dest->temperature, &src->temperature);
+  accu_merge(&dest->humidity, &src->humidity);
+  accu_merge(&dest->pressure, &src->pressure);
+}
+
+float thp_mean(const ThpAccu *accu) {
+  return accu->count ? accu->sum / accu->count : 0.0;
+}
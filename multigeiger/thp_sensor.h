@@ -3,7 +3,34 @@
 #ifndef _THP_SENSOR_H_
 #define _THP_SENSOR_H_
 
+// results of poll_thp_sensor()
+#define THP_IDLE 0    // no conversion running
+#define THP_BUSY 1    // conversion running, try again later
+#define THP_DONE 2    // conversion done, values returned
+#define THP_FAILED 3  // conversion or read failed
+
+// running mean / min / max of the THP samples within one measurement interval
+typedef struct {
+  unsigned int count;
+  float sum, min, max;
+} ThpAccu;
+
+typedef struct {
+  ThpAccu temperature, humidity, pressure;
+} ThpStats;
+
 bool setup_thp_sensor(void);
-bool read_thp_sensor(float *temperature, float *humidity, float *pressure);
+
+// reading the sensor is split into 2 steps, so the caller never blocks on a conversion:
+// start_thp_reading() triggers a conversion (forced mode), poll_thp_sensor() returns
+// THP_BUSY until the result is available, then THP_DONE with the values.
+bool start_thp_reading(void);
+int poll_thp_sensor(float *temperature, float *humidity, float *pressure);
+
+void thp_stats_reset(ThpStats *stats);
+void thp_stats_add(ThpStats *stats, float temperature, float humidity, float pressure);
+float thp_mean(const ThpAccu *accu);
+// add the samples of src to dest, e.g. to combine several measurement intervals.
+void thp_stats_merge(ThpStats *dest, const ThpStats *src);
 
 #endif // _THP_SENSOR_H_
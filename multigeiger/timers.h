@@ -1,3 +1,2 @@
 void setup_recharge_timer(void (*isr_recharge)(), int period_us);
-void setup_audio_timer(void (*isr_audio)(), int period_us);
 
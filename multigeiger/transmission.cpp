@@ -1,5 +1,6 @@
 // measurements data transmission related code
 // - via WiFi to internet servers
+// - via WiFi to a MQTT broker
 // - via LoRa to TTN (to internet servers)
 
 #include <Arduino.h>
@@ -11,6 +12,10 @@
 #include "userdefines.h"
 #include "webconf.h"
 #include "loraWan.h"
+#include "mqtt.h"
+#include "metrics.h"
+#include "clock.h"
+#include "hvhealth.h"
 
 #include "transmission.h"
 
@@ -43,6 +48,36 @@ typedef struct https_client {
 
 static HttpsClient c_madavi, c_sensorc, c_customsrv;
 
+// LoRa downlinks on this port are configuration commands, see handle_ttn_downlink()
+#define TTN_CONFIG_PORT 10
+
+// max. LoRa measurement interval we can encode in the payload (3 bytes) [ms]
+#define TTN_MAX_DT 0xFFFFFF
+
+// receive buffer for LoRa downlinks, must be big enough for the max. LoRaWAN payload size
+static uint8_t ttn_rx_port;
+static uint8_t ttn_rx_buffer[256];
+static uint8_t ttn_rx_size;
+
+// MQTT: measurements are queued as records and published (QoS 1) in batches of mqttBatch records.
+// While the broker is not reachable, we keep up to MQTT_MAX_RECORDS records, dropping the oldest.
+#define MQTT_MAX_RECORDS 32
+#define MQTT_MAX_BATCH 10  // max. records per message
+#define MQTT_RECORD_LEN 400  // max. length of a JSON record (~390 with 10 digit counts and THP values)
+
+typedef struct mqtt_record {
+  time_t timestamp;
+  unsigned int dt, hv_pulses, gm_counts, cpm;
+  int hv_state;
+  float hv_leak_ratio;
+  ThpStats thp;
+} MqttRecord;
+
+static MqttRecord mqtt_records[MQTT_MAX_RECORDS];
+static int mqtt_first = 0, mqtt_count = 0;  // ring buffer of queued records
+static volatile int mqtt_pending_msg_id = 0;  // last published message, waiting for the ack
+static String mqtt_topic;
+
 void setup_transmission(const char *version, char *ssid, bool loraHardware) {
   chipID = String(ssid);
   chipID.replace("ESP32", "esp32");
@@ -72,6 +107,7 @@ void setup_transmission(const char *version, char *ssid, bool loraHardware) {
   set_status(STATUS_SCOMM, sendToCommunity ? ST_SCOMM_INIT : ST_SCOMM_OFF);
   set_status(STATUS_MADAVI, sendToMadavi ? ST_MADAVI_INIT : ST_MADAVI_OFF);
   set_status(STATUS_TTN, sendToLora ? ST_TTN_INIT : ST_TTN_OFF);
+  set_status(STATUS_MQTT, sendToMqtt ? ST_MQTT_INIT : ST_MQTT_OFF);
 }
 
 void poll_transmission() {
@@ -82,6 +118,11 @@ void poll_transmission() {
     // to a jump.
     poll_lorawan();
   }
+  // MQTT acks arrive asynchronously, after transmit_data() has published the message
+  if (mqtt_pending_msg_id && (mqtt_last_acked() == mqtt_pending_msg_id)) {
+    mqtt_pending_msg_id = 0;
+    set_status(STATUS_MQTT, ST_MQTT_IDLE);
+  }
 }
 
 void prepare_http(HttpsClient *client, const char *host) {
@@ -210,13 +251,115 @@ int send_http_thp_2_madavi(HttpsClient *client, float temperature, float humidit
   return send_http(client, body);
 }
 
+// HV state as sent via LoRa / MQTT
+#define HV_STATE_OK 0
+#define HV_STATE_DEGRADED 1
+#define HV_STATE_ERROR 2
+
+static int hv_state(void) {
+  switch (get_status(STATUS_HV)) {
+  case ST_HV_ERROR:
+    return HV_STATE_ERROR;
+  case ST_HV_DEGRADED:
+    return HV_STATE_DEGRADED;
+  default:
+    return HV_STATE_OK;
+  }
+}
+
+void queue_mqtt_record(unsigned int timediff, unsigned int hv_pulses, unsigned int gm_counts, unsigned int cpm,
+                       const ThpStats *thp) {
+  if (mqtt_count == MQTT_MAX_RECORDS) {
+    log(WARNING, "MQTT queue full, dropping oldest record");
+    mqtt_first = (mqtt_first + 1) % MQTT_MAX_RECORDS;
+    mqtt_count--;
+  }
+  MqttRecord *r = &mqtt_records[(mqtt_first + mqtt_count) % MQTT_MAX_RECORDS];
+  r->timestamp = epoch_us() / 1000000;
+  r->dt = timediff;
+  r->hv_pulses = hv_pulses;
+  r->gm_counts = gm_counts;
+  r->cpm = cpm;
+  r->thp = *thp;
+  HvHealth hv;
+  get_hv_health(&hv);
+  r->hv_state = hv_state();
+  r->hv_leak_ratio = hv.leak_ratio;
+  mqtt_count++;
+}
+
+// vsnprintf at buf + len, returns the new length (>= size if it did not fit, like snprintf).
+static int append(char *buf, int size, int len, const char *fmt, ...) {
+  if (len >= size)
+    return len;
+  va_list args;
+  va_start(args, fmt);
+  len += vsnprintf(buf + len, size - len, fmt, args);
+  va_end(args);
+  return len;
+}
+
+// publish all queued records, if we have at least mqttBatch of them.
+// returns the count of published messages or -1 on error.
+int send_mqtt(String tube_type) {
+  static char body[100 + MQTT_MAX_BATCH * MQTT_RECORD_LEN];
+  int published = 0;
+  tube_type = tube_type.substring(10);
+  while (mqtt_count >= mqttBatch) {
+    int n = (mqtt_count < MQTT_MAX_BATCH) ? mqtt_count : MQTT_MAX_BATCH;
+    int len = snprintf(body, sizeof(body), "{\"software_version\":\"%s\",\"tube\":\"%s\",\"records\":[",
+                       http_software_version.c_str(), tube_type.c_str());
+    for (int i = 0; i < n; i++) {
+      MqttRecord *r = &mqtt_records[(mqtt_first + i) % MQTT_MAX_RECORDS];
+      int record_start = len;
+      len = append(body, sizeof(body), len,
+                   "%s{\"ts\":%ld,\"sample_time_ms\":%u,\"counts\":%u,\"counts_per_minute\":%u,\"hv_pulses\":%u"
+                   ",\"hv_state\":%d,\"hv_leak_ratio\":%.2f",
+                   i ? "," : "", (long)r->timestamp, r->dt, r->gm_counts, r->cpm, r->hv_pulses,
+                   r->hv_state, r->hv_leak_ratio);
+      if (r->thp.temperature.count)
+        len = append(body, sizeof(body), len, ",\"temperature\":%.2f,\"humidity\":%.2f,\"pressure\":%.2f"
+                     ",\"temperature_min\":%.2f,\"temperature_max\":%.2f,\"humidity_min\":%.2f,\"humidity_max\":%.2f"
+                     ",\"pressure_min\":%.2f,\"pressure_max\":%.2f,\"thp_samples\":%u",
+                     thp_mean(&r->thp.temperature), thp_mean(&r->thp.humidity), thp_mean(&r->thp.pressure),
+                     r->thp.temperature.min, r->thp.temperature.max, r->thp.humidity.min, r->thp.humidity.max,
+                     r->thp.pressure.min, r->thp.pressure.max, r->thp.temperature.count);
+      len = append(body, sizeof(body), len, "}");
+      // stop if the record (and "]}") did not fit, the remaining records are sent with the next message.
+      if (len + 2 >= (int)sizeof(body)) {
+        len = record_start;
+        if (i == 0) {
+          log(ERROR, "MQTT record too long, dropping it");
+          mqtt_first = (mqtt_first + 1) % MQTT_MAX_RECORDS;
+          mqtt_count--;
+        }
+        n = i;
+        break;
+      }
+    }
+    if (n == 0)
+      continue;
+    snprintf(body + len, sizeof(body) - len, "]}");
+    if (DEBUG_SERVER_SEND)
+      log(DEBUG, "mqtt topic: %s message: %s", mqtt_topic.c_str(), body);
+    int msg_id = mqtt_publish(mqtt_topic.c_str(), body, 1);
+    if (msg_id < 0)
+      return -1;  // records stay queued, we retry next time
+    mqtt_pending_msg_id = msg_id;
+    mqtt_first = (mqtt_first + n) % MQTT_MAX_RECORDS;
+    mqtt_count -= n;
+    published++;
+  }
+  return published;
+}
+
 // LoRa payload:
 // To minimise airtime and follow the 'TTN Fair Access Policy', we only send necessary bytes.
 // We do NOT use Cayenne LPP.
 // The payload will be translated via http integration and a small program to be compatible with sensor.community.
 // For byte definitions see ttn2luft.pdf in docs directory.
 int send_ttn_geiger(int tube_nbr, unsigned int dt, unsigned int gm_counts) {
-  unsigned char ttnData[10];
+  unsigned char ttnData[11];
   // first the number of GM counts
   ttnData[0] = (gm_counts >> 24) & 0xFF;
   ttnData[1] = (gm_counts >> 16) & 0xFF;
@@ -231,7 +374,9 @@ int send_ttn_geiger(int tube_nbr, unsigned int dt, unsigned int gm_counts) {
   ttnData[8] = lora_software_version & 0xFF;
   // next byte is the tube number
   ttnData[9] = tube_nbr;
-  return lorawan_send(1, ttnData, 10, false, NULL, NULL, NULL);
+  // last byte is the HV state (0 = ok, 1 = degraded, 2 = error)
+  ttnData[10] = hv_state();
+  return lorawan_send(1, ttnData, 11, false, &ttn_rx_port, ttn_rx_buffer, &ttn_rx_size);
 }
 
 int send_ttn_thp(float temperature, float humidity, float pressure) {
@@ -241,19 +386,93 @@ int send_ttn_thp(float temperature, float humidity, float pressure) {
   ttnData[2] = (int)(humidity * 2);
   ttnData[3] = ((int)(pressure / 10)) >> 8;
   ttnData[4] = ((int)(pressure / 10)) & 0xFF;
-  return lorawan_send(2, ttnData, 5, false, NULL, NULL, NULL);
+  return lorawan_send(2, ttnData, 5, false, &ttn_rx_port, ttn_rx_buffer, &ttn_rx_size);
+}
+
+// LoRa downlink configuration commands (port TTN_CONFIG_PORT):
+// The payload is a sequence of commands, each is a command byte followed by its value (big endian):
+// 0x01 + 2 bytes: measurement interval [s] (30..3600)
+// 0x02 + 2 bytes: local alarm threshold [nSv/h]
+// 0x03 + 1 byte:  local alarm factor (2..100)
+// 0x04 + 1 byte:  LoRa batching factor (1..16)
+// 0x05 + 1 byte:  LoRa data rate (0 = SF12 .. 5 = SF7)
+// Changed values are applied immediately and are saved to the configuration.
+void handle_ttn_downlink(uint8_t port, uint8_t *data, uint8_t size) {
+  if (port != TTN_CONFIG_PORT) {
+    log(INFO, "Ignoring LoRa downlink on port %d", port);
+    return;
+  }
+  bool changed = false;
+  int i = 0;
+  while (i < size) {
+    uint8_t cmd = data[i++];
+    int len = (cmd == 0x01 || cmd == 0x02) ? 2 : 1;
+    if ((cmd < 0x01) || (cmd > 0x05)) {
+      log(ERROR, "LoRa downlink: unknown command 0x%02x, ignoring rest of payload", cmd);
+      break;
+    }
+    if (i + len > size) {
+      log(ERROR, "LoRa downlink: command 0x%02x truncated", cmd);
+      break;
+    }
+    int value = (len == 2) ? ((data[i] << 8) + data[i + 1]) : data[i];
+    i += len;
+    bool valid = true;
+    switch (cmd) {
+    case 0x01:
+      valid = (value >= 30) && (value <= 3600);
+      if (valid)
+        measurementInterval = value;
+      break;
+    case 0x02:
+      valid = (value >= 100);  // 0.1 .. 65.5 uSv/h (2 bytes), 0 would mean a permanent alarm
+      if (valid)
+        localAlarmThreshold = value / 1000.0;
+      break;
+    case 0x03:
+      valid = (value >= 2) && (value <= 100);
+      if (valid)
+        localAlarmFactor = value;
+      break;
+    case 0x04:
+      valid = (value >= 1) && (value <= 16);
+      if (valid)
+        loraBatch = value;
+      break;
+    case 0x05:
+      valid = (value <= 5);
+      if (valid)
+        loraDataRate = value;
+      break;
+    }
+    if (valid) {
+      log(INFO, "LoRa downlink: command 0x%02x, value %d", cmd, value);
+      changed = true;
+    } else
+      log(ERROR, "LoRa downlink: command 0x%02x, invalid value %d", cmd, value);
+  }
+  if (changed)
+    store_webconf();
 }
 
 void transmit_data(String tube_type, int tube_nbr, unsigned int dt, unsigned int hv_pulses, unsigned int gm_counts, unsigned int cpm,
-                   int have_thp, float temperature, float humidity, float pressure, int wifi_status) {
+                   const ThpStats *thp, int wifi_status) {
   int rc1, rc2;
+  unsigned long start_ms;
+  // THP values are the means over the measurement interval
+  bool have_thp = thp->temperature.count > 0;
+  float temperature = thp_mean(&thp->temperature);
+  float humidity = thp_mean(&thp->humidity);
+  float pressure = thp_mean(&thp->pressure);
 
   #if SEND2CUSTOMSRV
   bool customsrv_ok;
   log(INFO, "Sending to CUSTOMSRV ...");
+  start_ms = millis();
   rc1 = send_http_geiger(&c_customsrv, CUSTOMSRV, dt, hv_pulses, gm_counts, cpm, XPIN_NO_XPIN);
   rc2 = have_thp ? send_http_thp(&c_customsrv, CUSTOMSRV, temperature, humidity, pressure, XPIN_NO_XPIN) : 200;
   customsrv_ok = (rc1 == 200) && (rc2 == 200);
+  metrics_upload(SINK_CUSTOMSRV, customsrv_ok, millis() - start_ms);
   log(INFO, "Sent to CUSTOMSRV, status: %s, http: %d %d", customsrv_ok ? "ok" : "error", rc1, rc2);
   #endif
 
@@ -261,40 +480,99 @@ void transmit_data(String tube_type, int tube_nbr, unsigned int dt, unsigned int
     bool madavi_ok;
     log(INFO, "Sending to Madavi ...");
     set_status(STATUS_MADAVI, ST_MADAVI_SENDING);
-    display_status();
+    start_ms = millis();
     rc1 = send_http_geiger_2_madavi(&c_madavi, tube_type, dt, hv_pulses, gm_counts, cpm);
     rc2 = have_thp ? send_http_thp_2_madavi(&c_madavi, temperature, humidity, pressure) : 200;
     delay(300);
     madavi_ok = (rc1 == 200) && (rc2 == 200);
+    metrics_upload(SINK_MADAVI, madavi_ok, millis() - start_ms);
     log(INFO, "Sent to Madavi, status: %s, http: %d %d", madavi_ok ? "ok" : "error", rc1, rc2);
     set_status(STATUS_MADAVI, madavi_ok ? ST_MADAVI_IDLE : ST_MADAVI_ERROR);
-    display_status();
   }
 
   if(sendToCommunity  && (wifi_status == ST_WIFI_CONNECTED)) {
     bool scomm_ok;
     log(INFO, "Sending to sensor.community ...");
     set_status(STATUS_SCOMM, ST_SCOMM_SENDING);
-    display_status();
+    start_ms = millis();
     rc1 = send_http_geiger(&c_sensorc, SENSORCOMMUNITY, dt, hv_pulses, gm_counts, cpm, XPIN_RADIATION);
     rc2 = have_thp ? send_http_thp(&c_sensorc, SENSORCOMMUNITY, temperature, humidity, pressure, XPIN_BME280) : 201;
     delay(300);
     scomm_ok = (rc1 == 201) && (rc2 == 201);
+    metrics_upload(SINK_SCOMM, scomm_ok, millis() - start_ms);
     log(INFO, "Sent to sensor.community, status: %s, http: %d %d", scomm_ok ? "ok" : "error", rc1, rc2);
     set_status(STATUS_SCOMM, scomm_ok ? ST_SCOMM_IDLE : ST_SCOMM_ERROR);
-    display_status();
+  }
+
+  if(sendToMqtt && (strcmp(mqttBroker, "") != 0)) {
+    // the connection to the broker is persistent, it is set up once WiFi is ready.
+    bool mqtt_just_started = false;
+    if (!is_mqtt_started() && (wifi_status == ST_WIFI_CONNECTED)) {
+      mqtt_topic = String(mqttTopic);
+      mqtt_topic.replace("{id}", chipID);
+      mqtt_topic += "/data";
+      setup_mqtt(mqttBroker, mqttUser, mqttPassword, chipID.c_str());
+      mqtt_just_started = true;
+    }
+    queue_mqtt_record(dt, hv_pulses, gm_counts, cpm, thp);
+    if (is_mqtt_connected()) {
+      log(INFO, "Sending to MQTT ...");
+      set_status(STATUS_MQTT, ST_MQTT_SENDING);
+      start_ms = millis();
+      rc1 = send_mqtt(tube_type);
+      if (rc1 != 0)  // 0: nothing was published
+        metrics_upload(SINK_MQTT, rc1 > 0, millis() - start_ms);
+      log(INFO, "Sent to MQTT, status: %s, messages: %d", (rc1 >= 0) ? "ok" : "error", rc1);
+      if (rc1 < 0)
+        set_status(STATUS_MQTT, ST_MQTT_ERROR);
+      else if (rc1 == 0)
+        set_status(STATUS_MQTT, ST_MQTT_IDLE);  // only queued (batching)
+      // else: status gets updated when the broker acks the message, see poll_transmission()
+    } else if (!mqtt_just_started) {
+      log(INFO, "MQTT broker not connected, %d records queued", mqtt_count);
+      metrics_upload(SINK_MQTT, false, 0);
+      set_status(STATUS_MQTT, ST_MQTT_ERROR);
+    }
   }
 
   if(isLoraBoard && sendToLora && (strcmp(appeui, "") != 0)) {    // send only, if we have LoRa credentials
-    bool ttn_ok;
-    log(INFO, "Sending to TTN ...");
-    set_status(STATUS_TTN, ST_TTN_SENDING);
-    display_status();
-    rc1 = send_ttn_geiger(tube_nbr, dt, gm_counts);
-    rc2 = have_thp ? send_ttn_thp(temperature, humidity, pressure) : TX_STATUS_UPLINK_SUCCESS;
-    ttn_ok = (rc1 == TX_STATUS_UPLINK_SUCCESS) && (rc2 == TX_STATUS_UPLINK_SUCCESS);
-    set_status(STATUS_TTN, ttn_ok ? ST_TTN_IDLE : ST_TTN_ERROR);
-    display_status();
+    // to save airtime, we can accumulate the counts of loraBatch measurement intervals into one uplink
+    // (and send the THP means over these intervals)
+    static int batched_intervals = 0;
+    static unsigned int batched_dt = 0, batched_gm_counts = 0;
+    static ThpStats batched_thp;
+    batched_intervals++;
+    batched_dt += dt;
+    batched_gm_counts += gm_counts;
+    thp_stats_merge(&batched_thp, thp);
+    if ((batched_intervals >= loraBatch) || (batched_dt + dt > TTN_MAX_DT)) {
+      // set it for every uplink: a join (e.g. after the session was forgotten) resets it
+      lorawan_set_datarate(loraDataRate);
+      bool ttn_ok;
+      log(INFO, "Sending to TTN ...");
+      set_status(STATUS_TTN, ST_TTN_SENDING);
+      start_ms = millis();
+      rc1 = send_ttn_geiger(tube_nbr, batched_dt, batched_gm_counts);
+      if (rc1 == TX_STATUS_UPLINK_ACKED_WITHDOWNLINK) {
+        handle_ttn_downlink(ttn_rx_port, ttn_rx_buffer, ttn_rx_size);
+        rc1 = TX_STATUS_UPLINK_SUCCESS;
+      }
+      rc2 = TX_STATUS_UPLINK_SUCCESS;
+      if (batched_thp.temperature.count)
+        rc2 = send_ttn_thp(thp_mean(&batched_thp.temperature), thp_mean(&batched_thp.humidity),
+                           thp_mean(&batched_thp.pressure));
+      if (rc2 == TX_STATUS_UPLINK_ACKED_WITHDOWNLINK) {
+        handle_ttn_downlink(ttn_rx_port, ttn_rx_buffer, ttn_rx_size);
+        rc2 = TX_STATUS_UPLINK_SUCCESS;
+      }
+      ttn_ok = (rc1 == TX_STATUS_UPLINK_SUCCESS) && (rc2 == TX_STATUS_UPLINK_SUCCESS);
+      metrics_upload(SINK_TTN, ttn_ok, millis() - start_ms);
+      set_status(STATUS_TTN, ttn_ok ? ST_TTN_IDLE : ST_TTN_ERROR);
+      batched_intervals = 0;
+      batched_dt = 0;
+      batched_gm_counts = 0;
+      thp_stats_reset(&batched_thp);
+    }
   }
 }
 
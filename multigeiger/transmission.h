@@ -5,6 +5,8 @@
 #ifndef _TRANSMISSION_H_
 #define _TRANSMISSION_H_
 
+#include "thp_sensor.h"
+
 // Sensor-PINS.
 // They are called PIN, because in the first days of Feinstaub sensor they were
 // really the CPU-Pins. Now they are 'virtual' pins to distinguish different sensors.
@@ -16,7 +18,7 @@
 
 void setup_transmission(const char *version, char *ssid, bool lora);
 void transmit_data(String tube_type, int tube_nbr, unsigned int dt, unsigned int hv_pulses, unsigned int gm_counts, unsigned int cpm,
-                   int have_thp, float temperature, float humidity, float pressure, int wifi_status);
+                   const ThpStats *thp, int wifi_status);
 
 // The Arduino LMIC wants to be polled from loop(). This takes care of that on LoRa boards.
 void poll_transmission(void);
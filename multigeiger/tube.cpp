@@ -2,26 +2,18 @@
 // - high voltage generation
 // - GM pulse counting
 
-#include <Arduino.h>
-
-#include "log.h"
+#include "platform.h"
 #include "speaker.h"
 #include "timers.h"
+#include "lowpower.h"
+#include "isrprof.h"
 #include "tube.h"
 
 // The test pin, if enabled, is high while isr_GMC_count is active.
 // -1 == disabled, otherwise pin 13 might be an option.
 #define PIN_TEST_OUTPUT -1
 
-#define PIN_HV_FET_OUTPUT 23
-#define PIN_HV_CAP_FULL_INPUT 22  // !! has to be capable of "interrupt on change"
-#define PIN_GMC_COUNT_INPUT 2     // !! has to be capable of "interrupt on change"
-
-// Dead Time of the Geiger Counter. [usec]
-// Has to be longer than the complete pulse generated on the Pin PIN_GMC_COUNT_INPUT.
-#define GMC_DEAD_TIME 190
-
-TUBETYPE tubes[] = {
+TUBETYPE tubes[TUBE_TYPES] = {
   // use 0.0 conversion factor for unknown tubes, so it computes an "obviously-wrong" 0.0 uSv/h value rather than a confusing one.
   {"Radiation unknown", 0, 0.0},
   // The conversion factors for SBM-20 and SBM-19 are taken from the datasheets (according to Jürgen)
@@ -39,24 +31,42 @@ volatile bool isr_GMC_cap_full;
 
 volatile unsigned long isr_hv_pulses;
 volatile bool isr_hv_charge_error;
+volatile bool isr_hv_charging;  // a charge cycle is running, the FET might be on
+volatile bool isr_hv_paused;  // do not start a new charge cycle
+volatile bool isr_hv_recharge_now;  // start a new charge cycle asap
+volatile unsigned long isr_hv_charges;  // completed charge cycles
+volatile unsigned int isr_hv_cycle_max;  // max. charge pulses of one cycle, since the last read_hv_stats()
+volatile unsigned long isr_hv_interval;  // current recharge interval [periods]
+
+static bool ulp_counting = false;  // GM pulses are counted by the ULP (low power mode)
 
 volatile unsigned int isr_GMC_counts;
 volatile unsigned long isr_count_timestamp;
 volatile unsigned long isr_count_time_between;
+volatile unsigned long isr_first_count_us;  // [us] since boot, when the first pulse was counted, 0 = none yet
+
+// ring buffer with the timestamps [us] of the most recent GM pulses (for live streaming)
+#define PULSE_RING_SIZE 128
+volatile unsigned long isr_pulse_timestamps[PULSE_RING_SIZE];
+volatile unsigned int isr_pulse_count;  // pulses written to the ring buffer (wraps around)
 
 // MUX (mutexes used for mutual exclusive access to isr variables)
-portMUX_TYPE mux_cap_full = portMUX_INITIALIZER_UNLOCKED;
-portMUX_TYPE mux_GMC_count = portMUX_INITIALIZER_UNLOCKED;
-portMUX_TYPE mux_hv = portMUX_INITIALIZER_UNLOCKED;
+hal_mux_t mux_cap_full = HAL_MUX_INITIALIZER;
+hal_mux_t mux_GMC_count = HAL_MUX_INITIALIZER;
+hal_mux_t mux_hv = HAL_MUX_INITIALIZER;
 
 // Maximum amount of HV capacitor charge pulses to generate in one charge cycle.
 #define MAX_CHARGE_PULSES 3333
 
+// If charging failed, retry after this time, doubled with every further failure, up to the max. [s]
+#define CHARGE_RETRY_MIN 60
+#define CHARGE_RETRY_MAX 600
+
 // hw timer period and microseconds -> periods conversion
 #define PERIOD_DURATION_US 100
 #define PERIODS(us) ((us) / PERIOD_DURATION_US)
 
-void IRAM_ATTR isr_recharge() {
+static void HAL_IRAM recharge() {
   // this code is periodically called by a timer hw interrupt, always same period.
   // we need to decide internally whether we actually want to do something.
   //
@@ -67,32 +77,42 @@ void IRAM_ATTR isr_recharge() {
   static unsigned int current = 0;  // current period counter
   static unsigned int next_state = 0;  // periods to next state machine execution
   static unsigned int next_charge = PERIODS(1000000);  // periods between recharges, initially 1s
+  enum State {init, pulse_h, pulse_l, check_full, is_full, charge_fail};
+  static State state = init;
+  static int charge_pulses;
+  static unsigned int retry_s = CHARGE_RETRY_MIN;  // wait time after the next charge failure
+
+  if ((state == init) && isr_hv_recharge_now) {
+    isr_hv_recharge_now = false;
+    current = next_state;  // do it now
+  }
   if (++current < next_state)
     return;  // nothing to do yet
 
+  if ((state == init) && isr_hv_paused)
+    return;  // try again with next period
+
   // we reached "next_state", so we execute the state machine:
   current = 0;
 
-  enum State {init, pulse_h, pulse_l, check_full, is_full, charge_fail};
-  static State state = init;
-  static int charge_pulses;
   if (state == init) {
+    isr_hv_charging = true;
     charge_pulses = 0;
-    portENTER_CRITICAL_ISR(&mux_cap_full);
+    hal_enter_critical_isr(&mux_cap_full);
     isr_GMC_cap_full = 0;
-    portEXIT_CRITICAL_ISR(&mux_cap_full);
+    hal_exit_critical_isr(&mux_cap_full);
     state = pulse_h;
     // fall through
   }
   while (state < is_full) {
     if (state == pulse_h) {
-      digitalWrite(PIN_HV_FET_OUTPUT, HIGH);  // turn the HV FET on
+      hal_digital_write(PIN_HV_FET_OUTPUT, HIGH);  // turn the HV FET on
       state = pulse_l;
       next_state = PERIODS(1500);  // 1500us (5000us gives 1.3 times more charge, 500us gives 1/20th of charge)
       return;
     }
     if (state == pulse_l) {
-      digitalWrite(PIN_HV_FET_OUTPUT, LOW);   // turn the HV FET off
+      hal_digital_write(PIN_HV_FET_OUTPUT, LOW);   // turn the HV FET off
       state = check_full;
       next_state = PERIODS(1000);  // 1000us
       return;
@@ -110,11 +130,16 @@ void IRAM_ATTR isr_recharge() {
   }
   if (state == is_full) {
     // capacitor full
-    portENTER_CRITICAL_ISR(&mux_hv);
+    hal_enter_critical_isr(&mux_hv);
     isr_hv_charge_error = false;
     isr_hv_pulses += charge_pulses;
-    portEXIT_CRITICAL_ISR(&mux_hv);
+    isr_hv_charges++;
+    if ((unsigned int)charge_pulses > isr_hv_cycle_max)
+      isr_hv_cycle_max = charge_pulses;
+    hal_exit_critical_isr(&mux_hv);
+    retry_s = CHARGE_RETRY_MIN;
     state = init;
+    isr_hv_charging = false;
     // depending on a lot of circumstances (e.g. level of radiation, humidity,
     // leak currents (diode leak current depends on temperature), tube type, ...),
     // we might need to charge the HV capacitor more or less often.
@@ -135,89 +160,180 @@ void IRAM_ATTR isr_recharge() {
     else if (next_charge > PERIODS(10000000))
       next_charge = PERIODS(10000000);
     next_state = next_charge;
+    isr_hv_interval = next_charge;
     return;
   }
   if (state == charge_fail) {
     // capacitor does not charge!
-    portENTER_CRITICAL_ISR(&mux_hv);
+    hal_enter_critical_isr(&mux_hv);
     isr_hv_charge_error = true;
     isr_hv_pulses += charge_pulses;
-    portEXIT_CRITICAL_ISR(&mux_hv);
-    // let's retry charging later
+    isr_hv_cycle_max = charge_pulses;
+    hal_exit_critical_isr(&mux_hv);
+    // let's retry charging later, first soon (it might have been a transient issue),
+    // then less and less often, so we do not stress the FET with continuous charging.
     state = init;
+    isr_hv_charging = false;
     next_charge = PERIODS(1000000);  // reset to default 1s charge interval
-    next_state = PERIODS(10 * 60 * 1000000);  // wait for 10 minutes before retrying
+    isr_hv_interval = next_charge;
+    next_state = PERIODS(retry_s * 1000000);
+    retry_s = (retry_s * 2 < CHARGE_RETRY_MAX) ? retry_s * 2 : CHARGE_RETRY_MAX;
     return;
   }
 }
 
-void IRAM_ATTR isr_GMC_capacitor_full() {
-  portENTER_CRITICAL_ISR(&mux_cap_full);
+void HAL_IRAM isr_recharge() {
+  uint32_t prof = isr_prof_start();
+  recharge();
+  isr_prof_end(ISR_RECHARGE, prof);
+}
+
+void HAL_IRAM isr_GMC_capacitor_full() {
+  uint32_t prof = isr_prof_start();
+  hal_enter_critical_isr(&mux_cap_full);
   isr_GMC_cap_full = 1;
-  portEXIT_CRITICAL_ISR(&mux_cap_full);
+  hal_exit_critical_isr(&mux_cap_full);
+  isr_prof_end(ISR_CAP_FULL, prof);
+}
+
+void hv_pause(bool pause) {
+  isr_hv_paused = pause;
+}
+
+bool hv_is_charging(void) {
+  return isr_hv_charging;
+}
+
+void hv_recharge_now(void) {
+  isr_hv_recharge_now = true;
 }
 
 void read_hv(bool *hv_error, unsigned long *pulses) {
-  portENTER_CRITICAL(&mux_hv);
+  hal_enter_critical(&mux_hv);
   *pulses = isr_hv_pulses;
   *hv_error = isr_hv_charge_error;
-  portEXIT_CRITICAL(&mux_hv);
+  hal_exit_critical(&mux_hv);
+}
+
+void read_hv_stats(unsigned long *charges, unsigned int *cycle_max, unsigned long *interval_us) {
+  hal_enter_critical(&mux_hv);
+  *charges = isr_hv_charges;
+  *cycle_max = isr_hv_cycle_max;
+  isr_hv_cycle_max = 0;
+  *interval_us = isr_hv_interval * PERIOD_DURATION_US;
+  hal_exit_critical(&mux_hv);
 }
 
-void IRAM_ATTR isr_GMC_count() {
+void HAL_IRAM isr_GMC_count() {
+  uint32_t prof = isr_prof_start();
   unsigned long now;
   static unsigned long last;
-  portENTER_CRITICAL_ISR(&mux_GMC_count);
+  hal_enter_critical_isr(&mux_GMC_count);
   #if PIN_TEST_OUTPUT >= 0
-  digitalWrite(PIN_TEST_OUTPUT, HIGH);
+  hal_digital_write(PIN_TEST_OUTPUT, HIGH);
   #endif
-  now = micros();  // unsigned long == uint32_t == 32bit -> overflows after ~72 minutes.
-  // safely compute dt, even if <now> has overflowed and <last> not [yet]:
-  unsigned long dt = (now >= last) ? (now - last) : ((now + (1 << 30)) - (last + (1 << 30)));
+  now = hal_micros();  // unsigned long == uint32_t == 32bit -> overflows after ~72 minutes.
+  // unsigned 32bit arithmetic computes dt correctly, even if <now> has overflowed and <last> not [yet]:
+  unsigned long dt = (uint32_t)(now - last);
   if (dt > GMC_DEAD_TIME) {
     // We only consider a pulse valid if it happens more than GMC_DEAD_TIME after the last valid pulse.
     // Reason: Pulses occurring short after a valid pulse are false pulses generated by the rising edge on the PIN_GMC_COUNT_INPUT.
     //         This happens because we don't have a Schmitt trigger on this controller pin.
-    isr_count_timestamp = millis();        // remember (system) time of the pulse
+    isr_count_timestamp = hal_millis();    // remember (system) time of the pulse
     isr_count_time_between = dt;           // save for statistics debuging
     isr_GMC_counts++;                      // count the pulse
+    isr_pulse_timestamps[isr_pulse_count++ % PULSE_RING_SIZE] = now;
+    if (!isr_first_count_us)
+      isr_first_count_us = now ? now : 1;
     last = now;                            // remember timestamp of last **valid** pulse
   }
   #if PIN_TEST_OUTPUT >= 0
-  digitalWrite(PIN_TEST_OUTPUT, LOW);
+  hal_digital_write(PIN_TEST_OUTPUT, LOW);
   #endif
-  portEXIT_CRITICAL_ISR(&mux_GMC_count);
+  hal_exit_critical_isr(&mux_GMC_count);
   tick(true);  // tick
+  isr_prof_end(ISR_GMC_COUNT, prof);
 }
 
 void read_GMC(unsigned long *counts, unsigned long *timestamp, unsigned int *between) {
-  portENTER_CRITICAL(&mux_GMC_count);
+  if (ulp_counting) {
+    // no timestamps / time between pulses available from the ULP.
+    // isr_GMC_counts might still hold pulses counted before the ULP took over.
+    unsigned int ulp_counts = read_ulp_counts();
+    hal_enter_critical(&mux_GMC_count);
+    ulp_counts += isr_GMC_counts;
+    isr_GMC_counts = 0;
+    hal_exit_critical(&mux_GMC_count);
+    *counts += ulp_counts;
+    if (ulp_counts)
+      *timestamp = hal_millis();
+    *between = 0;
+    return;
+  }
+  hal_enter_critical(&mux_GMC_count);
   *counts += isr_GMC_counts;
   isr_GMC_counts = 0;
   *timestamp = isr_count_timestamp;
   *between = isr_count_time_between;
-  portEXIT_CRITICAL(&mux_GMC_count);
+  hal_exit_critical(&mux_GMC_count);
+}
+
+int read_GMC_pulses(unsigned int *position, unsigned long *timestamps, int max_count, unsigned int *dropped) {
+  // copy the timestamps [us] of the pulses since *position (max. max_count of them).
+  // if the ring buffer overflowed since the last call, *dropped returns the count of lost timestamps.
+  int count = 0;
+  *dropped = 0;
+  hal_enter_critical(&mux_GMC_count);
+  unsigned int available = isr_pulse_count - *position;
+  if (available > PULSE_RING_SIZE) {
+    *dropped = available - PULSE_RING_SIZE;
+    *position = isr_pulse_count - PULSE_RING_SIZE;
+  }
+  while ((*position != isr_pulse_count) && (count < max_count))
+    timestamps[count++] = isr_pulse_timestamps[(*position)++ % PULSE_RING_SIZE];
+  hal_exit_critical(&mux_GMC_count);
+  return count;
+}
+
+unsigned long first_count_us(void) {
+  return isr_first_count_us;
+}
+
+void tube_use_ulp(void) {
+  // from now on, the ULP counts the GM pulses, so they also get counted while we sleep.
+  // there are no per-pulse timestamps and no ticks then.
+  hal_detach_interrupt(PIN_GMC_COUNT_INPUT);
+  start_ulp_counter(PIN_GMC_COUNT_INPUT, GMC_DEAD_TIME);
+  ulp_counting = true;
 }
 
 void setup_tube(void) {
-  pinMode(PIN_TEST_OUTPUT, OUTPUT);
-  pinMode(PIN_HV_FET_OUTPUT, OUTPUT);
-  pinMode(PIN_HV_CAP_FULL_INPUT, INPUT);
-  pinMode(PIN_GMC_COUNT_INPUT, INPUT);
+  hal_pin_mode(PIN_TEST_OUTPUT, OUTPUT);
+  hal_pin_mode(PIN_HV_FET_OUTPUT, OUTPUT);
+  hal_pin_mode(PIN_HV_CAP_FULL_INPUT, INPUT);
+  hal_pin_mode(PIN_GMC_COUNT_INPUT, INPUT);
 
-  digitalWrite(PIN_TEST_OUTPUT, LOW);
-  digitalWrite(PIN_HV_FET_OUTPUT, LOW);
+  hal_digital_write(PIN_TEST_OUTPUT, LOW);
+  hal_digital_write(PIN_HV_FET_OUTPUT, LOW);
 
   // note: we do not need to get the portMUX here as we did not yet enable interrupts.
   isr_count_timestamp = 0;
   isr_count_time_between = 0;
   isr_GMC_cap_full = 0;
   isr_GMC_counts = 0;
+  isr_pulse_count = 0;
+  isr_first_count_us = 0;
   isr_hv_pulses = 0;
   isr_hv_charge_error = false;
+  isr_hv_charging = false;
+  isr_hv_paused = false;
+  isr_hv_recharge_now = false;
+  isr_hv_charges = 0;
+  isr_hv_cycle_max = 0;
+  isr_hv_interval = PERIODS(1000000);
 
-  attachInterrupt(digitalPinToInterrupt(PIN_HV_CAP_FULL_INPUT), isr_GMC_capacitor_full, RISING);  // capacitor full
-  attachInterrupt(digitalPinToInterrupt(PIN_GMC_COUNT_INPUT), isr_GMC_count, FALLING);            // GMC pulse detected
+  hal_attach_interrupt(PIN_HV_CAP_FULL_INPUT, isr_GMC_capacitor_full, RISING);  // capacitor full
+  hal_attach_interrupt(PIN_GMC_COUNT_INPUT, isr_GMC_count, FALLING);           // GMC pulse detected
 
   setup_recharge_timer(isr_recharge, PERIOD_DURATION_US);
 }
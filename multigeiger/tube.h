@@ -3,16 +3,40 @@
 #ifndef _TUBE_H_
 #define _TUBE_H_
 
+#define PIN_HV_FET_OUTPUT 23
+#define PIN_HV_CAP_FULL_INPUT 22  // !! has to be capable of "interrupt on change"
+#define PIN_GMC_COUNT_INPUT 2     // !! has to be capable of "interrupt on change"
+
+// Dead Time of the Geiger Counter. [usec]
+// Has to be longer than the complete pulse generated on the Pin PIN_GMC_COUNT_INPUT.
+#define GMC_DEAD_TIME 190
+
 typedef struct {
   const char *type;          // type string for sensor.community
   const char nbr;            // number to be sent by LoRa
   const float cps_to_uSvph;  // factor to convert counts per second to µSievert per hour
 } TUBETYPE;
 
-extern TUBETYPE tubes[];
+#define TUBE_TYPES 4  // entries of tubes[], TUBE_TYPE is an index into it
+extern TUBETYPE tubes[TUBE_TYPES];
 
 void setup_tube(void);
 void read_GMC(unsigned long *counts, unsigned long *timestamp, unsigned int *between);
+int read_GMC_pulses(unsigned int *position, unsigned long *timestamps, int max_count, unsigned int *dropped);
 void read_hv(bool *hv_error, unsigned long *pulses);
+// HV charging details for health monitoring: completed charge cycles, max. charge pulses
+// of one cycle since the last call and the current recharge interval.
+void read_hv_stats(unsigned long *charges, unsigned int *cycle_max, unsigned long *interval_us);
+
+// time to first count: [us] since boot, when the first GM pulse was counted (0 = none yet)
+unsigned long first_count_us(void);
+
+// HV charging control, e.g. to make sure the FET is off while sleeping
+void hv_pause(bool pause);
+bool hv_is_charging(void);
+void hv_recharge_now(void);
+
+// count GM pulses with the ULP coprocessor (for low power mode)
+void tube_use_ulp(void);
 
 #endif // _TUBE_H_
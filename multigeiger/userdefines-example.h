@@ -23,12 +23,18 @@
 #include "log_data.h"
 
 // your serial logging style:
+// Serial_Binary_Log outputs binary data only (no text log), decode it with misc/decode_binary_log.py.
 #define SERIAL_DEBUG Serial_Logging
 
 // Server transmission debugging:
 // if set to true, print debug info on serial (USB) interface while sending to servers (madavi or sensor.community)
 #define DEBUG_SERVER_SEND true
 
+// Measurement interval [sec]
+// Every this many seconds, the measured data is transmitted to the servers.
+// Can be changed later on the config page (or, for LoRa, via TTN downlink).
+#define MEASUREMENT_INTERVAL 150
+
 // Speaker Ticks with every pulse?
 #define SPEAKER_TICK true
 
@@ -38,6 +44,10 @@
 // Enable display?
 #define SHOW_DISPLAY true
 
+// Show a sparkline of the count rate history of the last 48 minutes next to smaller CPM digits?
+// (only available on the 128x64 display, not on the LoRa board)
+#define SHOW_SPARKLINE false
+
 // Play a start sound at boot/reboot time?
 #define PLAY_SOUND true
 
@@ -56,6 +66,17 @@
 // Note: The TTN configuration needs to be done in lorawan.cpp (starting at line 65).
 #define SEND2LORA false
 
+// LoRa batching factor: only send every LORA_BATCH measurement intervals via LoRa (1 = send every interval).
+// The GM counts of these intervals are accumulated, so no counts get lost, just the time resolution gets worse.
+#define LORA_BATCH 1
+
+// LoRa data rate (EU868): 0 = SF12 (slow, long range) .. 5 = SF7 (fast, short range)
+#define LORA_DATARATE 5
+
+// Send data to a MQTT broker?
+// The broker, credentials and topic need to be configured on the config page.
+#define SEND2MQTT false
+
 // Send data via BLE?
 // Device provides "Heart Rate Service" (0x180D) and these characteristics.
 // 0x2A37: Heart Rate Measurement
@@ -64,6 +85,12 @@
 // 0x2A39: Heart Rate Control Point --> allows to reset "energy expenditure", as required by service definition
 #define SEND2BLE false
 
+// Low power mode for battery powered LoRa deployments?
+// 5 minutes after boot (so you can still use the config page), WiFi, display and ticks get switched off,
+// the GM pulses get counted by the ULP coprocessor and the CPU sleeps between the (1s) loop runs.
+// Data is only sent via LoRa then. Also disable BLE (config page / DIP switch) to save more power.
+#define LOW_POWER_MODE false
+
 // Play an alarm sound when radiation level is too high?
 // Activates when either accumulated dose rate reaches the set threshold (see below)
 // or when the current dose rate is higher than the accumulated dose rate by the set factor (see below).
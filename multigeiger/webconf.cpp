@@ -3,11 +3,15 @@
 
 #include "log.h"
 #include "speaker.h"
+#include "metrics.h"
+#include "stream.h"
+#include "history.h"
 
 #include "IotWebConf.h"
 #include "IotWebConfTParameter.h"
 #include <IotWebConfESP32HTTPUpdateServer.h>
 #include "userdefines.h"
+#include "dashboard.h"
 
 // Checkboxes have 'selected' if checked, so we need 9 byte for this string.
 #define CHECKBOX_LEN 9
@@ -16,20 +20,24 @@ bool speakerTick = SPEAKER_TICK;
 bool playSound = PLAY_SOUND;
 bool ledTick = LED_TICK;
 bool showDisplay = SHOW_DISPLAY;
+bool showSparkline = SHOW_SPARKLINE;
 bool sendToCommunity = SEND2SENSORCOMMUNITY;
 bool sendToMadavi = SEND2MADAVI;
 bool sendToLora = SEND2LORA;
 bool sendToBle = SEND2BLE;
+bool sendToMqtt = SEND2MQTT;
 bool soundLocalAlarm = LOCAL_ALARM_SOUND;
 
 char speakerTick_c[CHECKBOX_LEN];
 char playSound_c[CHECKBOX_LEN];
 char ledTick_c[CHECKBOX_LEN];
 char showDisplay_c[CHECKBOX_LEN];
+char showSparkline_c[CHECKBOX_LEN];
 char sendToCommunity_c[CHECKBOX_LEN];
 char sendToMadavi_c[CHECKBOX_LEN];
 char sendToLora_c[CHECKBOX_LEN];
 char sendToBle_c[CHECKBOX_LEN];
+char sendToMqtt_c[CHECKBOX_LEN];
 char soundLocalAlarm_c[CHECKBOX_LEN];
 
 char appeui[17] = "";
@@ -40,6 +48,19 @@ static bool isLoraBoard;
 float localAlarmThreshold = LOCAL_ALARM_THRESHOLD;
 int localAlarmFactor = (int)LOCAL_ALARM_FACTOR;
 
+int measurementInterval = MEASUREMENT_INTERVAL;
+int loraBatch = LORA_BATCH;
+int loraDataRate = LORA_DATARATE;
+
+// MQTT broker URIs and topics might be longer than the usual IOTWEBCONF_WORD_LEN
+#define MQTT_STR_LEN 65
+#define MQTT_TOPIC_DEFAULT "multigeiger/{id}"
+char mqttBroker[MQTT_STR_LEN] = "";
+char mqttUser[IOTWEBCONF_WORD_LEN] = "";
+char mqttPassword[IOTWEBCONF_WORD_LEN] = "";
+char mqttTopic[MQTT_STR_LEN] = MQTT_TOPIC_DEFAULT;
+int mqttBatch = 1;
+
 iotwebconf::ParameterGroup grpMisc = iotwebconf::ParameterGroup("misc", "Misc. Settings");
 iotwebconf::CheckboxParameter startSoundParam = iotwebconf::CheckboxParameter("Start sound", "startSound", playSound_c, CHECKBOX_LEN, playSound);
 iotwebconf::CheckboxParameter speakerTickParam = iotwebconf::CheckboxParameter("Speaker tick", "speakerTick", speakerTick_c, CHECKBOX_LEN, speakerTick);
@@ -71,6 +92,44 @@ iotwebconf::IntTParameter<int16_t> localAlarmFactorParam =
   min(2).max(100).
   step(1).placeholder("2..100").build();
 
+iotwebconf::ParameterGroup grpMeasurement = iotwebconf::ParameterGroup("measurement", "Measurement Settings");
+iotwebconf::IntTParameter<int16_t> measurementIntervalParam =
+  iotwebconf::Builder<iotwebconf::IntTParameter<int16_t>>("measurementInterval").
+  label("Measurement interval (s)").
+  defaultValue(measurementInterval).
+  min(30).max(3600).
+  step(1).placeholder("30..3600").build();
+
+iotwebconf::ParameterGroup grpLoRaTx = iotwebconf::ParameterGroup("loratx", "LoRa Transmission Settings");
+iotwebconf::IntTParameter<int16_t> loraBatchParam =
+  iotwebconf::Builder<iotwebconf::IntTParameter<int16_t>>("loraBatch").
+  label("Send every N measurement intervals").
+  defaultValue(loraBatch).
+  min(1).max(16).
+  step(1).placeholder("1..16").build();
+iotwebconf::IntTParameter<int16_t> loraDataRateParam =
+  iotwebconf::Builder<iotwebconf::IntTParameter<int16_t>>("loraDataRate").
+  label("Data rate (0 = SF12 .. 5 = SF7)").
+  defaultValue(loraDataRate).
+  min(0).max(5).
+  step(1).placeholder("0..5").build();
+
+iotwebconf::ParameterGroup grpMqtt = iotwebconf::ParameterGroup("mqtt", "MQTT Settings");
+iotwebconf::CheckboxParameter sendToMqttParam = iotwebconf::CheckboxParameter("Send to MQTT broker", "send2mqtt", sendToMqtt_c, CHECKBOX_LEN, sendToMqtt);
+iotwebconf::TextParameter mqttBrokerParam = iotwebconf::TextParameter("Broker URI", "mqttBroker", mqttBroker, MQTT_STR_LEN, NULL, "mqtt://host:1883");
+iotwebconf::TextParameter mqttUserParam = iotwebconf::TextParameter("User", "mqttUser", mqttUser, IOTWEBCONF_WORD_LEN);
+iotwebconf::PasswordParameter mqttPasswordParam = iotwebconf::PasswordParameter("Password", "mqttPassword", mqttPassword, IOTWEBCONF_WORD_LEN);
+iotwebconf::TextParameter mqttTopicParam = iotwebconf::TextParameter("Topic ({id} = chip ID)", "mqttTopic", mqttTopic, MQTT_STR_LEN, MQTT_TOPIC_DEFAULT);
+iotwebconf::IntTParameter<int16_t> mqttBatchParam =
+  iotwebconf::Builder<iotwebconf::IntTParameter<int16_t>>("mqttBatch").
+  label("Publish every N measurements").
+  defaultValue(mqttBatch).
+  min(1).max(10).
+  step(1).placeholder("1..10").build();
+
+iotwebconf::ParameterGroup grpDisplay = iotwebconf::ParameterGroup("display", "Display Settings");
+iotwebconf::CheckboxParameter showSparklineParam = iotwebconf::CheckboxParameter("Show count rate history", "showSparkline", showSparkline_c, CHECKBOX_LEN, showSparkline);
+
 // This only needs to be changed if the layout of the configuration is changed.
 // Appending new variables does not require a new version number here.
 // If this value is changed, ALL configuration variables must be re-entered,
@@ -112,27 +171,25 @@ char *buildSSID() {
   return ssid;
 }
 
-void handleRoot(void) {  // Handle web requests to "/" path.
+void handleRoot(void) {  // Handle web requests to "/" path: the web dashboard.
   // -- Let IotWebConf test and handle captive portal requests.
   if (iotWebConf.handleCaptivePortal()) {
     // -- Captive portal requests were already served.
     return;
   }
-  const char *index =
-    "<!DOCTYPE html>"
-    "<html lang='en'>"
-    "<head>"
-    "<meta name='viewport' content='width=device-width, initial-scale=1, user-scalable=no' />"
-    "<title>MultiGeiger Configuration</title>"
-    "</head>"
-    "<body>"
-    "<h1>Configuration</h1>"
-    "<p>"
-    "Go to the <a href='config'>config page</a> to change settings or update firmware."
-    "</p>"
-    "</body>"
-    "</html>\n";
-  server.send(200, "text/html;charset=UTF-8", index);
+  // the dashboard is static and pre-compressed, browsers revalidate their cached copy via the ETag.
+  server.sendHeader("ETag", DASHBOARD_ETAG);
+  server.sendHeader("Cache-Control", "no-cache");
+  if (server.header("If-None-Match") == DASHBOARD_ETAG) {
+    server.send(304);
+    return;
+  }
+  server.sendHeader("Content-Encoding", "gzip");
+  server.send_P(200, "text/html;charset=UTF-8", (const char *)dashboard_html_gz, sizeof(dashboard_html_gz));
+}
+
+void handleConfig(void) {  // Handle web requests to "/config" path.
+  iotWebConf.handleConfig();
   // looks like user wants to do some configuration or maybe flash firmware.
   // while accessing the flash, we need to turn ticking off to avoid exceptions.
   // user needs to save the config (or flash firmware + reboot) to turn it on again.
@@ -141,12 +198,94 @@ void handleRoot(void) {  // Handle web requests to "/" path.
   tick_enable(false);
 }
 
+// the status JSON polled by the dashboard, rendered into a static buffer like the metrics.
+#define STATUS_LEN 1024
+
+void handleStatus(void) {  // Handle web requests to "/status" path.
+  static char status[STATUS_LEN];
+  int len = render_status(status, STATUS_LEN);
+  server.sendHeader("Cache-Control", "no-store");
+  server.send_P(200, "application/json", status, len);
+}
+
+// the metrics text is rendered into a static buffer, so scraping does not need heap memory.
+#define METRICS_LEN 8192
+
+void handleMetrics(void) {  // Handle web requests to "/metrics" path.
+  static char metrics[METRICS_LEN];
+  int len = render_metrics(metrics, METRICS_LEN);
+  server.send_P(200, "text/plain; version=0.0.4", metrics, len);
+}
+
+void handleEvents(void) {  // Handle web requests to "/events" path (Server-Sent Events).
+  bool pulses = server.arg("pulses") == "1";
+  WiFiClient client = server.client();
+  if (!stream_add_client(client, pulses))
+    server.send(503, "text/plain", "Too many stream clients.\n");
+}
+
+// history range query, e.g. /history?tier=hours&from=1700000000&to=1700086400 (times: [s] since epoch).
+// the JSON is streamed in chunks, with up to HISTORY_QUERY_MAX records. if there are more,
+// "continue" gives the seq to continue with (/history?...&seq=...), else it is null.
+// this runs in the loop task, so every request reads at most HISTORY_QUERY_MAX records
+// (~50 filesystem reads) and larger ranges need several requests.
+#define HISTORY_QUERY_MAX (8 * HISTORY_READ_CHUNK)
+#define HISTORY_CHUNK_LEN 1024
+
+static void append_value(char *buf, int *len, float value) {
+  *len += isnan(value) ? snprintf(buf + *len, 16, ",null") : snprintf(buf + *len, 16, ",%.2f", value);
+}
+
+void handleHistory(void) {  // Handle web requests to "/history" path.
+  static const char *tier_names[HISTORY_TIERS] = {"seconds", "minutes", "hours"};
+  int tier = HISTORY_MINUTES;
+  for (int i = 0; i < HISTORY_TIERS; i++)
+    if (server.arg("tier") == tier_names[i])
+      tier = i;
+  uint32_t from = server.hasArg("from") ? strtoul(server.arg("from").c_str(), NULL, 10) : 0;
+  uint32_t to = server.hasArg("to") ? strtoul(server.arg("to").c_str(), NULL, 10) : UINT32_MAX;
+  uint32_t seq = server.hasArg("seq") ? strtoul(server.arg("seq").c_str(), NULL, 10) : history_first_seq(tier);
+
+  char buf[HISTORY_CHUNK_LEN];
+  static HistoryRecord records[HISTORY_READ_CHUNK];
+  int len = snprintf(buf, sizeof(buf), "{\"tier\":\"%s\",\"first\":%u,\"next\":%u,\"records\":[",
+                     tier_names[tier], history_first_seq(tier), history_next_seq(tier));
+  server.setContentLength(CONTENT_LENGTH_UNKNOWN);
+  server.send(200, "application/json", "");
+  int total = 0;
+  while (total < HISTORY_QUERY_MAX) {
+    int max_count = (HISTORY_QUERY_MAX - total < HISTORY_READ_CHUNK) ? HISTORY_QUERY_MAX - total : HISTORY_READ_CHUNK;
+    int count = history_query(tier, from, to, &seq, records, max_count);
+    if (!count)
+      break;
+    for (int i = 0; i < count; i++) {
+      if (len > HISTORY_CHUNK_LEN - 100) {
+        server.sendContent_P(buf, len);
+        len = 0;
+      }
+      len += snprintf(buf + len, 32, "%s[%u,%u", (total + i) ? "," : "", records[i].time, records[i].counts);
+      append_value(buf, &len, records[i].temperature);
+      append_value(buf, &len, records[i].humidity);
+      append_value(buf, &len, records[i].pressure);
+      buf[len++] = ']';
+    }
+    total += count;
+  }
+  if (seq < history_next_seq(tier) && (total >= HISTORY_QUERY_MAX))
+    len += snprintf(buf + len, 40, "],\"continue\":%u}\n", seq);
+  else
+    len += snprintf(buf + len, 40, "],\"continue\":null}\n");
+  server.sendContent_P(buf, len);
+  server.sendContent("");
+}
+
 static char lastWiFiSSID[IOTWEBCONF_WORD_LEN] = "";
 
 void loadConfigVariables(void) {
   // check if WiFi SSID has changed. If so, restart cpu. Otherwise, the program will not use the new SSID
   if ((strcmp(lastWiFiSSID, "") != 0) && (strcmp(lastWiFiSSID, iotWebConf.getWifiSsidParameter()->valueBuffer) != 0)) {
     log(INFO, "Doing restart...");
+    log_flush();
     ESP.restart();
   }
   strcpy(lastWiFiSSID, iotWebConf.getWifiSsidParameter()->valueBuffer);
@@ -162,6 +301,38 @@ void loadConfigVariables(void) {
   soundLocalAlarm = soundLocalAlarmParam.isChecked();
   localAlarmThreshold = localAlarmThresholdParam.value();
   localAlarmFactor = localAlarmFactorParam.value();
+  measurementInterval = measurementIntervalParam.value();
+  loraBatch = loraBatchParam.value();
+  loraDataRate = loraDataRateParam.value();
+  // parameters appended to an existing config are not initialized yet, use the defaults then:
+  if ((measurementInterval < 30) || (measurementInterval > 3600))
+    measurementInterval = MEASUREMENT_INTERVAL;
+  if ((loraBatch < 1) || (loraBatch > 16))
+    loraBatch = LORA_BATCH;
+  if ((loraDataRate < 0) || (loraDataRate > 5))
+    loraDataRate = LORA_DATARATE;
+  sendToMqtt = sendToMqttParam.isChecked();
+  mqttBatch = mqttBatchParam.value();
+  if ((mqttBatch < 1) || (mqttBatch > 10))
+    mqttBatch = 1;
+  // erased flash reads as 0xFF, so the text parameters need some care, too:
+  char *texts[] = {mqttBroker, mqttUser, mqttPassword, mqttTopic};
+  int lengths[] = {MQTT_STR_LEN, IOTWEBCONF_WORD_LEN, IOTWEBCONF_WORD_LEN, MQTT_STR_LEN};
+  for (int i = 0; i < 4; i++) {
+    texts[i][lengths[i] - 1] = '\0';
+    if (texts[i][0] == '\xFF')
+      texts[i][0] = '\0';
+  }
+  showSparkline = !isLoraBoard && showSparklineParam.isChecked();
+}
+
+void store_webconf(void) {
+  localAlarmThresholdParam.value() = localAlarmThreshold;
+  localAlarmFactorParam.value() = localAlarmFactor;
+  measurementIntervalParam.value() = measurementInterval;
+  loraBatchParam.value() = loraBatch;
+  loraDataRateParam.value() = loraDataRate;
+  iotWebConf.saveConfig();
 }
 
 void configSaved(void) {
@@ -205,6 +376,25 @@ void setup_webconf(bool loraHardware) {
   grpAlarm.addItem(&localAlarmThresholdParam);
   grpAlarm.addItem(&localAlarmFactorParam);
   iotWebConf.addParameterGroup(&grpAlarm);
+  // new parameter groups must be appended here, so the stored config layout stays compatible
+  grpMeasurement.addItem(&measurementIntervalParam);
+  iotWebConf.addParameterGroup(&grpMeasurement);
+  if (isLoraBoard) {
+    grpLoRaTx.addItem(&loraBatchParam);
+    grpLoRaTx.addItem(&loraDataRateParam);
+    iotWebConf.addParameterGroup(&grpLoRaTx);
+  }
+  grpMqtt.addItem(&sendToMqttParam);
+  grpMqtt.addItem(&mqttBrokerParam);
+  grpMqtt.addItem(&mqttUserParam);
+  grpMqtt.addItem(&mqttPasswordParam);
+  grpMqtt.addItem(&mqttTopicParam);
+  grpMqtt.addItem(&mqttBatchParam);
+  iotWebConf.addParameterGroup(&grpMqtt);
+  if (!isLoraBoard) {  // the LoRa board display is too small
+    grpDisplay.addItem(&showSparklineParam);
+    iotWebConf.addParameterGroup(&grpDisplay);
+  }
 
   // if we don't have LoRa hardware, do not send to LoRa
   if (!isLoraBoard)
@@ -216,8 +406,14 @@ void setup_webconf(bool loraHardware) {
 
   // -- Set up required URL handlers on the web server.
   server.on("/", handleRoot);
-  server.on("/config", [] { iotWebConf.handleConfig(); });
+  server.on("/config", handleConfig);
+  server.on("/status", handleStatus);
+  server.on("/metrics", handleMetrics);
+  server.on("/events", handleEvents);
+  server.on("/history", handleHistory);
   server.onNotFound([]() {
     iotWebConf.handleNotFound();
   });
+  static const char *headers[] = {"If-None-Match"};
+  server.collectHeaders(headers, 1);
 }
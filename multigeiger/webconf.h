@@ -10,22 +10,37 @@ extern bool speakerTick;
 extern bool playSound;
 extern bool ledTick;
 extern bool showDisplay;
+extern bool showSparkline;
 extern bool sendToCommunity;
 extern bool sendToMadavi;
 extern bool sendToLora;
 extern bool sendToBle;
+extern bool sendToMqtt;
 extern bool soundLocalAlarm;
 
 extern char appeui[];
 extern char deveui[];
 extern char appkey[];
 
+extern char mqttBroker[];
+extern char mqttUser[];
+extern char mqttPassword[];
+extern char mqttTopic[];
+extern int mqttBatch;
+
 extern float localAlarmThreshold;
 extern int localAlarmFactor;
 
+extern int measurementInterval;
+extern int loraBatch;
+extern int loraDataRate;
+
 extern char ssid[];
 extern IotWebConf iotWebConf;
 
 void setup_webconf(bool loraHardware);
 
+// store the current values of the config variables into the configuration (e.g. after remote changes)
+void store_webconf(void);
+
 #endif // _WEBCONF_H_
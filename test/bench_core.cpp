@@ -0,0 +1,97 @@
+// host benchmark of the measurement core: host time per ISR / rate computation call and the
+// speed of the virtual time simulation. compare the results before and after a change, the
+// absolute numbers depend on the host (the ESP32 is much slower, see the ISR profile metrics).
+
+#include <stdio.h>
+#include <time.h>
+
+#include "platform.h"
+#include "tube.h"
+#include "rates.h"
+
+static unsigned long fet_pulses;
+
+static void hv_model(int pin, int level) {
+  // the capacitor is full after each charge pulse
+  if (pin == PIN_HV_FET_OUTPUT) {
+    if (level)
+      fet_pulses++;
+    hal_sim_set_pin(PIN_HV_CAP_FULL_INPUT, level);
+  }
+}
+
+static double now_s(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void power_on(void) {
+  hal_sim_reset();
+  hal_sim_write_hook(hv_model);
+  hal_sim_set_pin(PIN_GMC_COUNT_INPUT, HIGH);
+  setup_tube();
+}
+
+static void report(const char *name, double seconds, double calls, const char *unit) {
+  printf("%-28s %12.0f %-10s %10.1f ns/call\n", name, calls, unit, seconds * 1e9 / calls);
+}
+
+// GM pulses at 1000 cps: cost of isr_GMC_count incl. the edge detection of the HAL and the
+// HV timer ISR calls in between
+static void bench_gm_pulses(void) {
+  const int pulses = 2000000;
+  power_on();
+  hal_sim_advance(1000);
+  unsigned long counts = 0, timestamp;
+  unsigned int between;
+  double start = now_s();
+  for (int i = 0; i < pulses; i++) {
+    hal_sim_set_pin(PIN_GMC_COUNT_INPUT, LOW);
+    hal_sim_set_pin(PIN_GMC_COUNT_INPUT, HIGH);
+    hal_sim_advance(1000);
+    if (i % 1000 == 999)
+      read_GMC(&counts, &timestamp, &between);
+  }
+  double elapsed = now_s() - start;
+  read_GMC(&counts, &timestamp, &between);
+  report("GM pulse (incl. HV timer)", elapsed, pulses, "pulses");
+  if (counts != (unsigned long)pulses)
+    printf("  warning: counted %lu of %d pulses\n", counts, pulses);
+}
+
+// HV timer ISR (called every 100us) in virtual time, no GM pulses
+static void bench_recharge(void) {
+  const double virtual_s = 3600;
+  power_on();
+  double start = now_s();
+  hal_sim_advance((uint64_t)(virtual_s * 1e6));
+  double elapsed = now_s() - start;
+  report("isr_recharge", elapsed, virtual_s * 10000, "calls");
+  printf("%-28s %12.0f x real time\n", "  simulation speed", virtual_s / elapsed);
+}
+
+// rate computation and alarm decision, like publish() does it
+static void bench_rates(void) {
+  const int calls = 20000000;
+  Rates r;
+  int alarms = 0;
+  init_rates(&r, 0, 100, 10000, tubes[3].cps_to_uSvph);
+  double start = now_s();
+  for (int i = 1; i <= calls; i++) {
+    update_rates(&r, i * 10UL, i * 2UL, i * 10UL);
+    alarms += check_alarm(&r, 1.0, 3) != ALARM_NONE;
+  }
+  double elapsed = now_s() - start;
+  report("update_rates + check_alarm", elapsed, calls, "calls");
+  if (alarms < 0)
+    printf("%d\n", alarms);  // keep the result used
+}
+
+int main(void) {
+  printf("%-28s %12s %-10s %10s\n", "benchmark", "count", "", "host time");
+  bench_gm_pulses();
+  bench_recharge();
+  bench_rates();
+  return 0;
+}
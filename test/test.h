@@ -0,0 +1,48 @@
+// minimal helpers for the host tests (see Makefile), no test framework needed.
+
+#ifndef _TEST_H_
+#define _TEST_H_
+
+#include <math.h>
+#include <stdio.h>
+
+static int test_checks, test_failures;
+
+#define CHECK(cond) do { \
+    test_checks++; \
+    if (!(cond)) { \
+      test_failures++; \
+      fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+    } \
+  } while (0)
+
+#define CHECK_EQ(a, b) do { \
+    long long _a = (long long)(a), _b = (long long)(b); \
+    test_checks++; \
+    if (_a != _b) { \
+      test_failures++; \
+      fprintf(stderr, "%s:%d: CHECK_EQ(%s, %s) failed: %lld != %lld\n", __FILE__, __LINE__, #a, #b, _a, _b); \
+    } \
+  } while (0)
+
+#define CHECK_NEAR(a, b, eps) do { \
+    double _a = (a), _b = (b); \
+    test_checks++; \
+    if (!(fabs(_a - _b) <= (eps))) { \
+      test_failures++; \
+      fprintf(stderr, "%s:%d: CHECK_NEAR(%s, %s) failed: %g != %g\n", __FILE__, __LINE__, #a, #b, _a, _b); \
+    } \
+  } while (0)
+
+#define RUN_TEST(fn) do { \
+    printf("  %s\n", #fn); \
+    fn(); \
+  } while (0)
+
+// print the summary, returns the exit code for main()
+static inline int test_result(void) {
+  printf("%d checks, %d failed\n", test_checks, test_failures);
+  return test_failures ? 1 : 0;
+}
+
+#endif // _TEST_H_
@@ -0,0 +1,252 @@
+// host test of the measurement core (tube.cpp, timers.cpp, rates.cpp) in virtual time:
+// GM pulse counting, HV charging and the rate / local alarm computation.
+
+#include "platform.h"
+#include "tube.h"
+#include "rates.h"
+#include "test.h"
+
+#define SI22G 3  // index into tubes[]
+
+// HV hardware model: the capacitor is full after hv_pulses_needed charge pulses (0 = never)
+static int hv_pulses_needed;
+static int hv_pulses;
+static unsigned long fet_pulses;
+
+static void hv_model(int pin, int level) {
+  if ((pin != PIN_HV_FET_OUTPUT) || !level)
+    return;
+  fet_pulses++;
+  if (hv_pulses_needed && (++hv_pulses >= hv_pulses_needed)) {
+    hal_sim_set_pin(PIN_HV_CAP_FULL_INPUT, LOW);
+    hal_sim_set_pin(PIN_HV_CAP_FULL_INPUT, HIGH);  // rising edge: isr_GMC_capacitor_full
+    hv_pulses = 0;
+  }
+}
+
+static void power_on(int pulses_needed) {
+  hv_pulses_needed = pulses_needed;
+  hv_pulses = 0;
+  hal_sim_reset();
+  hal_sim_write_hook(hv_model);
+  hal_sim_set_pin(PIN_GMC_COUNT_INPUT, HIGH);  // idle level
+  setup_tube();
+}
+
+static void advance_ms(unsigned long ms) {
+  hal_sim_advance((uint64_t)ms * 1000);
+}
+
+// one GM pulse: the input is low for 20us, isr_GMC_count runs on the falling edge
+static void gm_pulse(void) {
+  hal_sim_set_pin(PIN_GMC_COUNT_INPUT, LOW);
+  hal_sim_advance(20);
+  hal_sim_set_pin(PIN_GMC_COUNT_INPUT, HIGH);
+}
+
+static void test_counting(void) {
+  power_on(1);
+  advance_ms(1000);
+  for (int i = 0; i < 100; i++) {
+    gm_pulse();
+    hal_sim_advance(10000 - 20);
+  }
+  unsigned long counts = 0, timestamp;
+  unsigned int between;
+  read_GMC(&counts, &timestamp, &between);
+  CHECK_EQ(counts, 100);
+  CHECK_EQ(timestamp, 1990);  // [ms] of the last pulse
+  CHECK_EQ(between, 10000);
+  CHECK_EQ(first_count_us(), 1000000);
+
+  // counts accumulate, a second read only adds the new ones
+  gm_pulse();
+  read_GMC(&counts, &timestamp, &between);
+  CHECK_EQ(counts, 101);
+  read_GMC(&counts, &timestamp, &between);
+  CHECK_EQ(counts, 101);
+}
+
+static void test_dead_time(void) {
+  power_on(1);
+  advance_ms(1000);
+  unsigned long counts = 0, timestamp;
+  unsigned int between;
+  gm_pulse();
+  hal_sim_advance(GMC_DEAD_TIME - 50);  // ringing within the dead time is not counted
+  gm_pulse();
+  hal_sim_advance(200);  // > GMC_DEAD_TIME after the first pulse
+  gm_pulse();
+  read_GMC(&counts, &timestamp, &between);
+  CHECK_EQ(counts, 2);
+  CHECK_EQ(between, GMC_DEAD_TIME - 50 + 20 + 200 + 20);
+}
+
+static void test_pulse_timestamps(void) {
+  power_on(1);
+  advance_ms(1000);
+  unsigned int position = 0, dropped;
+  unsigned long timestamps[256];
+  for (int i = 0; i < 10; i++) {
+    gm_pulse();
+    hal_sim_advance(1000 - 20);
+  }
+  int n = read_GMC_pulses(&position, timestamps, 256, &dropped);
+  CHECK_EQ(n, 10);
+  CHECK_EQ(dropped, 0);
+  CHECK_EQ(timestamps[0], 1000000);
+  CHECK_EQ(timestamps[9], 1009000);
+  // more pulses than the ring buffer holds: the oldest are reported as dropped
+  for (int i = 0; i < 200; i++) {
+    gm_pulse();
+    hal_sim_advance(1000 - 20);
+  }
+  n = read_GMC_pulses(&position, timestamps, 256, &dropped);
+  CHECK_EQ(n, 128);
+  CHECK_EQ(dropped, 72);
+  CHECK_EQ(timestamps[127], 1209000);
+  CHECK_EQ(read_GMC_pulses(&position, timestamps, 256, &dropped), 0);
+}
+
+static void test_hv_charging(void) {
+  bool error;
+  unsigned long pulses, charges, interval_us;
+  unsigned int cycle_max;
+
+  // 1 pulse is always enough: the recharge interval grows up to the max. of 10s
+  power_on(1);
+  advance_ms(600000);
+  read_hv(&error, &pulses);
+  CHECK(!error);
+  CHECK(pulses > 0);
+  read_hv_stats(&charges, &cycle_max, &interval_us);
+  CHECK_EQ(charges, pulses);
+  CHECK_EQ(cycle_max, 1);
+  CHECK_EQ(interval_us, 10000000);
+
+  // a leaky capacitor needs 3 pulses: the interval shrinks down to the min. of 1ms
+  hv_pulses_needed = 3;
+  advance_ms(120000);
+  read_hv(&error, &pulses);
+  CHECK(!error);
+  read_hv_stats(&charges, &cycle_max, &interval_us);
+  CHECK_EQ(cycle_max, 3);
+  CHECK_EQ(interval_us, 1000);
+
+  // paused: no new charge cycles
+  hv_pause(true);
+  advance_ms(1000);
+  unsigned long fet = fet_pulses;
+  advance_ms(20000);
+  CHECK_EQ(fet_pulses, fet);
+  CHECK(!hv_is_charging());
+  hv_pause(false);
+  advance_ms(1000);
+  CHECK(fet_pulses > fet);
+}
+
+static void test_hv_error(void) {
+  bool error;
+  unsigned long pulses;
+
+  // the capacitor never gets full: error after MAX_CHARGE_PULSES (~8.3s of charging)
+  power_on(0);
+  advance_ms(2000);
+  read_hv(&error, &pulses);
+  CHECK(!error);
+  advance_ms(10000);
+  read_hv(&error, &pulses);
+  CHECK(error);
+  CHECK_EQ(pulses, 3333);
+  // no charging while waiting for the retry (60s)
+  unsigned long fet = fet_pulses;
+  advance_ms(50000);
+  CHECK_EQ(fet_pulses, fet);
+
+  // fixed again: the retry clears the error
+  hv_pulses_needed = 1;
+  advance_ms(11000);
+  read_hv(&error, &pulses);
+  CHECK(!error);
+}
+
+static void test_rates(void) {
+  Rates r;
+  init_rates(&r, 0, 100, 10000, tubes[SI22G].cps_to_uSvph);
+  CHECK_EQ(update_rates(&r, 5000, 50, 5000), RATES_WAIT);  // < min_counts and < refresh_ms
+  CHECK_EQ(update_rates(&r, 10000, 0, 0), RATES_NO_PULSES);
+  CHECK_EQ(update_rates(&r, 10000, 100, 10000), RATES_UPDATED);  // 100 counts within 10s
+  CHECK_EQ(r.counts, 100);
+  CHECK_EQ(r.dt, 10000);
+  CHECK_NEAR(r.count_rate, 10.0, 1e-4);
+  CHECK_NEAR(r.dose_rate, 10.0 / 12.2792, 1e-4);
+  CHECK_NEAR(r.accumulated_count_rate, 10.0, 1e-4);
+  // min_counts reached before refresh_ms: update early
+  CHECK_EQ(update_rates(&r, 12000, 200, 12000), RATES_UPDATED);  // 100 counts within 2s
+  CHECK_NEAR(r.count_rate, 50.0, 1e-4);
+  CHECK_NEAR(r.accumulated_count_rate, 200 / 12.0, 1e-3);
+}
+
+static void test_alarm(void) {
+  Rates r;
+  // 1 cps for 100s, then a burst of 20 cps for 5s
+  init_rates(&r, 0, 100, 10000, tubes[SI22G].cps_to_uSvph);
+  update_rates(&r, 100000, 100, 100000);
+  CHECK_EQ(check_alarm(&r, 1.0, 3), ALARM_NONE);
+  update_rates(&r, 105000, 200, 105000);
+  CHECK_EQ(check_alarm(&r, 1.0, 3), ALARM_FACTOR);  // 20 cps > 3 * 1.9 cps
+  CHECK_EQ(check_alarm(&r, 0.1, 3), ALARM_THRESHOLD);  // accumulated 0.155 uSv/h
+  CHECK_EQ(check_alarm(&r, 1.0, 20), ALARM_NONE);
+
+  // 0.1 cps background: 3 pulses within 0.5s are no reason for a factor alarm
+  init_rates(&r, 0, 100, 10000, tubes[SI22G].cps_to_uSvph);
+  update_rates(&r, 1000000, 100, 1000000);
+  update_rates(&r, 1010000, 103, 1000500);
+  CHECK_NEAR(r.count_rate, 6.0, 1e-4);
+  CHECK_EQ(check_alarm(&r, 1.0, 3), ALARM_NONE);
+  update_rates(&r, 1020000, 100 + 3 + ALARM_FACTOR_MIN_COUNTS, 1011000);
+  CHECK_EQ(check_alarm(&r, 1.0, 3), ALARM_FACTOR);
+
+  // unknown tube: no dose rates, no alarms
+  init_rates(&r, 0, 100, 10000, tubes[0].cps_to_uSvph);
+  update_rates(&r, 100000, 100, 100000);
+  update_rates(&r, 105000, 200, 105000);
+  CHECK_EQ(check_alarm(&r, 0.0, 1), ALARM_NONE);
+}
+
+static void test_alarm_end_to_end(void) {
+  // GM pulses at 100 cps (Si22G: 8.1 uSv/h), the main loop runs every second
+  power_on(1);
+  Rates r;
+  init_rates(&r, hal_millis(), 100, 10000, tubes[SI22G].cps_to_uSvph);
+  unsigned long counts = 0, timestamp;
+  unsigned int between;
+  int updates = 0, alarm = ALARM_NONE;
+  for (int s = 0; s < 20; s++) {
+    for (int i = 0; i < 100; i++) {
+      gm_pulse();
+      hal_sim_advance(10000 - 20);
+    }
+    read_GMC(&counts, &timestamp, &between);
+    if (update_rates(&r, hal_millis(), counts, timestamp) == RATES_UPDATED) {
+      updates++;
+      alarm = check_alarm(&r, 0.5, 3);
+    }
+  }
+  CHECK_EQ(counts, 2000);
+  CHECK_EQ(updates, 20);
+  CHECK_NEAR(r.accumulated_count_rate, 100.0, 1.0);
+  CHECK_EQ(alarm, ALARM_THRESHOLD);
+}
+
+int main(void) {
+  RUN_TEST(test_counting);
+  RUN_TEST(test_dead_time);
+  RUN_TEST(test_pulse_timestamps);
+  RUN_TEST(test_hv_charging);
+  RUN_TEST(test_hv_error);
+  RUN_TEST(test_rates);
+  RUN_TEST(test_alarm);
+  RUN_TEST(test_alarm_end_to_end);
+  return test_result();
+}
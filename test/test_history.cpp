@@ -0,0 +1,291 @@
+// host test of the measurement history (history.cpp), with the in-memory filesystem of the
+// Linux HAL: downsampling, ring buffers, reads racing with writes, range queries, reopening
+// and the tier sizing for small (and too small) filesystems.
+//
+// history.cpp keeps its state in statics (like on the device), so the tests build on each other.
+
+#include <math.h>
+
+#include "platform.h"
+#include "history.h"
+#include "test.h"
+
+#define HOUR 1700002800UL  // an hour end, [s] since epoch
+#define CPS 2
+
+static unsigned long now_ms, total_counts;
+static uint32_t clock_s;  // 0: clock not set
+static bool have_thp = true;
+
+// the main loop, once per second
+static void run(unsigned long seconds) {
+  for (unsigned long i = 0; i < seconds; i++) {
+    now_ms += 1000;
+    total_counts += CPS;
+    if (clock_s)
+      clock_s++;
+    float temperature = 20.0 + (now_ms / 1000) % 2;  // mean 20.5
+    history_sample(now_ms, clock_s, total_counts, have_thp, temperature, 50.0, 101320.0);
+  }
+}
+
+// the clock gets set 30s after boot, so that the first minute record ends 30 min before HOUR
+static uint32_t minute_time(uint32_t seq) {
+  return HOUR - 1800 + 60 * seq;
+}
+
+static void test_seconds(void) {
+  setup_history();
+  history_sample(now_ms, 0, total_counts, have_thp, 0, 0, 0);  // first call, nothing recorded
+  run(30);
+  CHECK_EQ(history_first_seq(HISTORY_SECONDS), 0);
+  CHECK_EQ(history_next_seq(HISTORY_SECONDS), 30);
+  HistoryRecord r[40];
+  uint32_t seq = 0;
+  CHECK_EQ(history_read(HISTORY_SECONDS, &seq, r, 40), 30);
+  CHECK_EQ(r[0].time, 0);  // clock not set
+  CHECK_EQ(r[29].counts, CPS);
+  CHECK(isnan(r[0].temperature));  // seconds: counts only
+
+  // clock set: the seconds get their times
+  clock_s = HOUR - 1800 - 30;
+  run(5);
+  seq = 30;
+  CHECK_EQ(history_read(HISTORY_SECONDS, &seq, r, 40), 5);
+  CHECK_EQ(r[4].time, clock_s);
+  CHECK_EQ(r[0].time, clock_s - 4);
+  // the seconds only store counts, their times follow from the time of the last one
+  seq = 0;
+  CHECK_EQ(history_query(HISTORY_SECONDS, clock_s - 34, clock_s - 33, &seq, r, 40), 1);
+  CHECK_EQ(r[0].time, clock_s - 34);
+
+  // a late loop: the counts get spread over the missed seconds
+  now_ms += 2000;
+  clock_s += 2;
+  total_counts += 7;
+  history_sample(now_ms, clock_s, total_counts, have_thp, 20.5, 50.0, 101320.0);
+  seq = 35;
+  CHECK_EQ(history_read(HISTORY_SECONDS, &seq, r, 40), 2);
+  CHECK_EQ(r[0].counts + r[1].counts, 7);
+  CHECK_EQ(r[1].time, clock_s);
+  run(23);  // complete the first minute
+}
+
+static void test_downsampling(void) {
+  HistoryRecord r[4];
+  uint32_t seq = 0;
+  CHECK_EQ(history_next_seq(HISTORY_MINUTES), 1);
+  CHECK_EQ(history_read(HISTORY_MINUTES, &seq, r, 4), 1);
+  CHECK_EQ(r[0].time, minute_time(0));
+  CHECK_EQ(r[0].counts, 60 * CPS + 7 - 2 * CPS);  // the late loop brought 7 instead of 2 * CPS
+  CHECK_NEAR(r[0].temperature, 20.5, 0.02);
+  CHECK_NEAR(r[0].humidity, 50.0, 0.01);
+  CHECK_NEAR(r[0].pressure, 101320.0, 10.0);
+  uint32_t counts[HISTORY_RECENT_MINUTES + 1];
+  CHECK_EQ(history_recent_minutes(counts, HISTORY_RECENT_MINUTES), 1);  // the RAM copy for the display
+  CHECK_EQ(counts[0], r[0].counts);
+
+  // no THP sensor: no values
+  have_thp = false;
+  run(60);
+  have_thp = true;
+  seq = 1;
+  CHECK_EQ(history_read(HISTORY_MINUTES, &seq, r, 4), 1);
+  CHECK_EQ(r[0].time, minute_time(1));
+  CHECK_EQ(r[0].counts, 60 * CPS);
+  CHECK(isnan(r[0].temperature) && isnan(r[0].humidity) && isnan(r[0].pressure));
+
+  // the first (partial) hour ends at HOUR, not 60 minutes after boot
+  run(29 * 60);
+  CHECK_EQ(history_next_seq(HISTORY_MINUTES), 31);
+  CHECK_EQ(history_next_seq(HISTORY_HOURS), 0);  // the hour is closed by its first minute after HOUR
+  run(60);
+  CHECK_EQ(history_next_seq(HISTORY_HOURS), 1);
+  seq = 0;
+  CHECK_EQ(history_read(HISTORY_HOURS, &seq, r, 4), 1);
+  CHECK_EQ(r[0].time, HOUR);
+  CHECK_EQ(r[0].minutes, 31);
+  CHECK_EQ(r[0].counts, 31 * 60 * CPS + 7 - 2 * CPS);
+  CHECK_NEAR(r[0].temperature, 20.5, 0.02);  // mean of the minutes with THP data
+
+  // full hours
+  run(2 * 3600);
+  CHECK_EQ(history_next_seq(HISTORY_HOURS), 3);
+  seq = 1;
+  CHECK_EQ(history_read(HISTORY_HOURS, &seq, r, 4), 2);
+  CHECK_EQ(r[0].time, HOUR + 3600);
+  CHECK_EQ(r[1].time, HOUR + 7200);
+  CHECK_EQ(r[1].minutes, 60);
+  CHECK_EQ(r[1].counts, 3600 * CPS);
+  CHECK_EQ(history_recent_minutes(counts, HISTORY_RECENT_MINUTES + 1), HISTORY_RECENT_MINUTES);  // the newest only
+  CHECK_EQ(counts[HISTORY_RECENT_MINUTES - 1], 60 * CPS);
+}
+
+static int fs_reads;
+
+static void count_reads(const char *path) {
+  fs_reads++;
+}
+
+static void test_query(void) {
+  HistoryRecord r[20];
+  uint32_t seq = history_first_seq(HISTORY_MINUTES);
+  // from is inclusive, to exclusive
+  CHECK_EQ(history_query(HISTORY_MINUTES, HOUR, HOUR + 600, &seq, r, 20), 10);
+  CHECK_EQ(r[0].time, HOUR);
+  CHECK_EQ(r[9].time, HOUR + 540);
+  seq = history_first_seq(HISTORY_MINUTES);
+  CHECK_EQ(history_query(HISTORY_MINUTES, HOUR + 1, HOUR + 601, &seq, r, 20), 10);
+  CHECK_EQ(r[0].time, HOUR + 60);
+  CHECK_EQ(r[9].time, HOUR + 600);
+  seq = history_first_seq(HISTORY_MINUTES);
+  CHECK_EQ(history_query(HISTORY_MINUTES, HOUR, HOUR, &seq, r, 20), 0);
+  seq = history_first_seq(HISTORY_MINUTES);
+  CHECK_EQ(history_query(HISTORY_MINUTES, 1, minute_time(0), &seq, r, 20), 0);  // before the data
+  CHECK_EQ(seq, history_next_seq(HISTORY_MINUTES));  // all scanned
+  seq = history_first_seq(HISTORY_MINUTES);
+  CHECK_EQ(history_query(HISTORY_MINUTES, minute_time(0), minute_time(1), &seq, r, 20), 1);  // first record
+  seq = history_first_seq(HISTORY_MINUTES);
+  uint32_t last = minute_time(history_next_seq(HISTORY_MINUTES) - 1);
+  CHECK_EQ(history_query(HISTORY_MINUTES, last, UINT32_MAX, &seq, r, 20), 1);  // last record
+  CHECK_EQ(r[0].time, last);
+
+  // continuation with max_count
+  seq = history_first_seq(HISTORY_MINUTES);
+  CHECK_EQ(history_query(HISTORY_MINUTES, HOUR, HOUR + 540, &seq, r, 4), 4);
+  CHECK_EQ(r[3].time, HOUR + 180);
+  CHECK_EQ(history_query(HISTORY_MINUTES, HOUR, HOUR + 540, &seq, r, 4), 4);
+  CHECK_EQ(r[0].time, HOUR + 240);
+  CHECK_EQ(history_query(HISTORY_MINUTES, HOUR, HOUR + 540, &seq, r, 4), 1);
+  CHECK_EQ(r[0].time, HOUR + 480);
+  CHECK_EQ(history_query(HISTORY_MINUTES, HOUR, HOUR + 540, &seq, r, 4), 0);
+
+  // batches of HISTORY_READ_CHUNK (like /history): every chunk is read once, the time column
+  // for the scan plus the 5 columns of the matching records
+  static HistoryRecord batch[HISTORY_READ_CHUNK];
+  uint32_t records = history_next_seq(HISTORY_MINUTES) - history_first_seq(HISTORY_MINUTES), total = 0;
+  fs_reads = 0;
+  hal_sim_fs_read_hook(count_reads);
+  seq = history_first_seq(HISTORY_MINUTES);
+  int n;
+  while ((n = history_query(HISTORY_MINUTES, 0, UINT32_MAX, &seq, batch, HISTORY_READ_CHUNK)) > 0)
+    total += n;
+  hal_sim_fs_read_hook(NULL);
+  CHECK_EQ(total, records);
+  CHECK_EQ(fs_reads, (int)(records + HISTORY_READ_CHUNK - 1) / HISTORY_READ_CHUNK * 6);
+
+  // hours tier
+  seq = 0;
+  CHECK_EQ(history_query(HISTORY_HOURS, HOUR, HOUR + 3601, &seq, r, 20), 2);
+
+  // invalid tiers
+  seq = 0;
+  CHECK_EQ(history_query(HISTORY_TIERS, 0, UINT32_MAX, &seq, r, 20), 0);
+  CHECK_EQ(history_query(-1, 0, UINT32_MAX, &seq, r, 20), 0);
+  CHECK_EQ(history_read(HISTORY_TIERS, &seq, r, 20), 0);
+  CHECK_EQ(history_first_seq(HISTORY_TIERS), 0);
+  CHECK_EQ(history_next_seq(-1), 0);
+}
+
+static void test_reopen(void) {
+  HistoryRecord before[2], after[2];
+  uint32_t minutes = history_next_seq(HISTORY_MINUTES), hours = history_next_seq(HISTORY_HOURS);
+  uint32_t seq = minutes - 2;
+  history_read(HISTORY_MINUTES, &seq, before, 2);
+  setup_history();  // e.g. after a reboot: continues from /hist/meta
+  CHECK_EQ(history_next_seq(HISTORY_MINUTES), minutes);
+  CHECK_EQ(history_next_seq(HISTORY_HOURS), hours);
+  seq = minutes - 2;
+  CHECK_EQ(history_read(HISTORY_MINUTES, &seq, after, 2), 2);
+  CHECK_EQ(after[1].time, before[1].time);
+  CHECK_EQ(after[1].counts, before[1].counts);
+  CHECK_NEAR(after[1].temperature, before[1].temperature, 1e-6);
+  run(60);
+  CHECK_EQ(history_next_seq(HISTORY_MINUTES), minutes + 1);
+
+  // invalid meta data: the flash tiers start over
+  uint32_t magic = 0;
+  hal_fs_write("/hist/meta", 0, &magic, sizeof(magic));
+  setup_history();
+  CHECK_EQ(history_next_seq(HISTORY_MINUTES), 0);
+  CHECK_EQ(history_next_seq(HISTORY_HOURS), 0);
+}
+
+static int reads_until_overwrite;
+
+static void writer_hook(const char *path) {
+  // another task adds records while history_read() is busy
+  if (--reads_until_overwrite == 0) {
+    hal_sim_fs_read_hook(NULL);
+    run(40 * 60);
+  }
+}
+
+static void test_small_fs_and_wraparound(void) {
+  // "Minimal SPIFFS": both flash tiers get shrunk by the same factor
+  hal_sim_fs_size(169000);
+  setup_history();
+  CHECK_EQ(history_next_seq(HISTORY_MINUTES), 0);  // resized: the flash tiers start over
+  uint32_t start_seq = 0, start_time = clock_s + 60;  // next minute record (the accumulator was just emptied)
+  uint32_t capacity = 10080UL * (169000 * 70 / 100) / (10080 * 14 + 8760 * 15) - 1;  // 1 record is kept free
+  CHECK_EQ(capacity, 4374);
+
+  // fill the minutes tier beyond its capacity
+  run((capacity + 100) * 60);
+  uint32_t next = history_next_seq(HISTORY_MINUTES);
+  CHECK_EQ(next, capacity + 100);
+  CHECK_EQ(history_first_seq(HISTORY_MINUTES), next - capacity);
+  CHECK(history_next_seq(HISTORY_HOURS) > 70);
+
+  // reading across the wrap point of the ring buffer
+  static HistoryRecord r[256];
+  uint32_t seq = start_seq;  // overwritten already: starts with the oldest one
+  int n = history_read(HISTORY_MINUTES, &seq, r, 256);
+  CHECK_EQ(seq, next - capacity);
+  CHECK_EQ(n, 256);
+  bool consecutive = true;
+  for (int i = 0; i < n; i++)
+    consecutive = consecutive && (r[i].time == start_time + 60 * (seq + i - start_seq)) && (r[i].counts == 60 * CPS);
+  CHECK(consecutive);
+
+  // records overwritten while reading (here: after the first chunk of 32) are dropped
+  uint32_t first = history_first_seq(HISTORY_MINUTES);
+  reads_until_overwrite = 5 + 1;  // 5 columns per chunk
+  hal_sim_fs_read_hook(writer_hook);
+  seq = first;
+  n = history_read(HISTORY_MINUTES, &seq, r, 64);
+  CHECK_EQ(reads_until_overwrite, 0);
+  CHECK_EQ(seq, first + 40);
+  CHECK_EQ(n, 64 - 40);
+  consecutive = true;
+  for (int i = 0; i < n; i++)
+    consecutive = consecutive && (r[i].time == start_time + 60 * (seq + i - start_seq));
+  CHECK(consecutive);
+
+  // too small for any useful flash tier: the seconds (and the recent minutes) only
+  hal_sim_fs_size(30);  // not even 1 record per tier
+  setup_history();
+  CHECK_EQ(history_first_seq(HISTORY_MINUTES), history_next_seq(HISTORY_MINUTES));
+  CHECK_EQ(history_first_seq(HISTORY_HOURS), history_next_seq(HISTORY_HOURS));
+  run(2 * 3600);
+  seq = 0;
+  CHECK_EQ(history_read(HISTORY_HOURS, &seq, r, 4), 0);
+  uint32_t counts[4];
+  CHECK_EQ(history_recent_minutes(counts, 4), 4);
+  CHECK_EQ(counts[3], 60 * CPS);
+  seq = 0;
+  CHECK_EQ(history_read(HISTORY_SECONDS, &seq, r, 4), 4);
+
+  hal_sim_fs_size(0x180000);
+  setup_history();
+  CHECK_EQ(history_next_seq(HISTORY_MINUTES), 0);
+}
+
+int main(void) {
+  RUN_TEST(test_seconds);
+  RUN_TEST(test_downsampling);
+  RUN_TEST(test_query);
+  RUN_TEST(test_reopen);
+  RUN_TEST(test_small_fs_and_wraparound);
+  return test_result();
+}
@@ -0,0 +1,200 @@
+// host test of the sound sequencer (sequencer.cpp) with a fake clock: order and timing of the
+// steps, alarms preempting melodies, GM ticks during melodies / alarms and the alarm holdoff.
+
+#include <limits.h>
+#include <stddef.h>
+
+#include "sequencer.h"
+#include "test.h"
+
+// steps: frequency_mHz, volume, LED, duration_ms (== 0: last step)
+static const int melody[] = {
+  440000, 1, 0, 100,
+  0, 0, 0, 100,  // pause: ticks allowed
+  523000, 1, 0, 100,
+  0, 0, 0, 0
+};
+
+static const int alarm[] = {
+  3000000, 2, 1, 400,
+  0, 0, 0, 400,  // pause: still no ticks
+  3000000, 2, 1, 400,
+  0, 0, 0, 0
+};
+
+static Sequencer seq;
+static unsigned long now_ms;
+
+// poll like the speaker task does, returns the number of steps started at now_ms
+static int poll(const int **last_step, unsigned long *wait_ms) {
+  const int *step;
+  int n = 0;
+  while ((step = sequencer_poll(&seq, now_ms, wait_ms)) != NULL) {
+    *last_step = step;
+    n++;
+  }
+  return n;
+}
+
+// poll every 100ms until the current sequence ended
+static void play_to_end(const int **last_step, unsigned long *wait_ms) {
+  do {
+    now_ms += 100;
+    poll(last_step, wait_ms);
+  } while (*wait_ms != SEQUENCER_IDLE);
+}
+
+static void test_melody(void) {
+  sequencer_init(&seq);
+  now_ms = 1000;
+  const int *step = NULL;
+  unsigned long wait_ms;
+  CHECK_EQ(poll(&step, &wait_ms), 0);
+  CHECK_EQ(wait_ms, SEQUENCER_IDLE);
+  CHECK(sequencer_ticks_allowed(&seq));
+
+  CHECK(sequencer_request(&seq, melody, SOUND_MELODY));
+  CHECK_EQ(poll(&step, &wait_ms), 1);
+  CHECK(step == &melody[0]);
+  CHECK_EQ(wait_ms, 100);
+  CHECK(!sequencer_ticks_allowed(&seq));  // no ticks during a tone
+  now_ms += 50;
+  CHECK_EQ(poll(&step, &wait_ms), 0);  // not due yet
+  CHECK_EQ(wait_ms, 50);
+  now_ms += 50;
+  CHECK_EQ(poll(&step, &wait_ms), 1);
+  CHECK(step == &melody[4]);
+  CHECK(sequencer_ticks_allowed(&seq));  // but in the pauses of a melody
+  now_ms += 100;
+  CHECK_EQ(poll(&step, &wait_ms), 1);
+  CHECK(step == &melody[8]);
+  // a late poll: the last step (silence) gets played, then the sequencer is idle
+  now_ms += 130;
+  CHECK_EQ(poll(&step, &wait_ms), 1);
+  CHECK(step == &melody[12]);
+  CHECK_EQ(wait_ms, SEQUENCER_IDLE);
+  CHECK(sequencer_ticks_allowed(&seq));
+}
+
+static void test_alarm_preempts_melody(void) {
+  sequencer_init(&seq);
+  now_ms = 1000;
+  const int *step = NULL;
+  unsigned long wait_ms;
+  sequencer_request(&seq, melody, SOUND_MELODY);
+  poll(&step, &wait_ms);
+  now_ms += 150;
+  poll(&step, &wait_ms);
+  CHECK(step == &melody[4]);
+  CHECK(sequencer_ticks_allowed(&seq));
+
+  // the alarm starts immediately, in the middle of the melody
+  now_ms += 20;
+  sequencer_request(&seq, alarm, SOUND_ALARM);
+  CHECK_EQ(poll(&step, &wait_ms), 1);
+  CHECK(step == &alarm[0]);
+  CHECK_EQ(wait_ms, 400);
+
+  // no ticks during the whole alarm, also not in its pauses
+  bool ticks = false;
+  for (int i = 0; i < 11; i++) {
+    now_ms += 100;
+    poll(&step, &wait_ms);
+    ticks = ticks || sequencer_ticks_allowed(&seq);
+  }
+  CHECK(!ticks);
+  CHECK(step == &alarm[8]);
+  now_ms += 100;
+  poll(&step, &wait_ms);
+  CHECK(step == &alarm[12]);  // the alarm ended
+  CHECK_EQ(wait_ms, SEQUENCER_IDLE);  // the preempted melody is not continued
+  CHECK(sequencer_ticks_allowed(&seq));
+
+  // a melody requested during an alarm is played after it
+  now_ms += 20000;
+  sequencer_request(&seq, alarm, SOUND_ALARM);
+  poll(&step, &wait_ms);
+  now_ms += 100;
+  sequencer_request(&seq, melody, SOUND_MELODY);
+  CHECK_EQ(poll(&step, &wait_ms), 0);
+  CHECK(!sequencer_ticks_allowed(&seq));
+  for (int i = 0; i < 11; i++) {
+    now_ms += 100;
+    poll(&step, &wait_ms);
+  }
+  CHECK(step == &melody[0]);  // directly after the end of the alarm
+  CHECK_EQ(wait_ms, 100);
+}
+
+static void test_alarm_holdoff(void) {
+  sequencer_init(&seq);
+  now_ms = 5000;
+  const int *step = NULL;
+  unsigned long wait_ms;
+  sequencer_request(&seq, alarm, SOUND_ALARM);
+  CHECK_EQ(poll(&step, &wait_ms), 1);
+
+  // repeated alarms while one is playing are dropped, not queued
+  now_ms += 400;
+  sequencer_request(&seq, alarm, SOUND_ALARM);
+  CHECK_EQ(poll(&step, &wait_ms), 1);
+  CHECK(step == &alarm[4]);
+  now_ms += 400;
+  poll(&step, &wait_ms);
+  now_ms += 400;
+  CHECK_EQ(poll(&step, &wait_ms), 1);
+  CHECK(step == &alarm[12]);
+  CHECK_EQ(wait_ms, SEQUENCER_IDLE);
+
+  // and after it ended, until ALARM_HOLDOFF_MS after its start
+  now_ms = 5000 + ALARM_HOLDOFF_MS - 1;
+  sequencer_request(&seq, alarm, SOUND_ALARM);
+  CHECK_EQ(poll(&step, &wait_ms), 0);
+  CHECK_EQ(wait_ms, SEQUENCER_IDLE);
+  CHECK(sequencer_ticks_allowed(&seq));
+  now_ms++;
+  sequencer_request(&seq, alarm, SOUND_ALARM);
+  CHECK_EQ(poll(&step, &wait_ms), 1);
+  CHECK(step == &alarm[0]);
+
+  // melodies are not rate limited
+  play_to_end(&step, &wait_ms);
+  sequencer_request(&seq, melody, SOUND_MELODY);
+  CHECK_EQ(poll(&step, &wait_ms), 1);
+  CHECK(step == &melody[0]);
+
+  // the holdoff also works across the wraparound of the millis() counter
+  sequencer_init(&seq);
+  now_ms = ULONG_MAX - 1000;
+  sequencer_request(&seq, alarm, SOUND_ALARM);
+  poll(&step, &wait_ms);
+  play_to_end(&step, &wait_ms);
+  CHECK(now_ms < 1000);
+  sequencer_request(&seq, alarm, SOUND_ALARM);
+  CHECK_EQ(poll(&step, &wait_ms), 0);
+  now_ms = ULONG_MAX - 1000 + ALARM_HOLDOFF_MS;
+  sequencer_request(&seq, alarm, SOUND_ALARM);
+  CHECK_EQ(poll(&step, &wait_ms), 1);
+  CHECK(step == &alarm[0]);
+}
+
+static void test_queue(void) {
+  sequencer_init(&seq);
+  // one slot of the queue stays free
+  for (int i = 0; i < SOUND_QUEUE_LEN - 1; i++)
+    CHECK(sequencer_request(&seq, melody, SOUND_MELODY));
+  CHECK(!sequencer_request(&seq, melody, SOUND_MELODY));
+  const int *step = NULL;
+  unsigned long wait_ms;
+  now_ms = 0;
+  poll(&step, &wait_ms);
+  CHECK(sequencer_request(&seq, alarm, SOUND_ALARM));
+}
+
+int main(void) {
+  RUN_TEST(test_melody);
+  RUN_TEST(test_alarm_preempts_melody);
+  RUN_TEST(test_alarm_holdoff);
+  RUN_TEST(test_queue);
+  return test_result();
+}
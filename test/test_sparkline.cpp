@@ -0,0 +1,132 @@
+// host test of the sparkline renderer (sparkline.cpp): renders fixed value series into a
+// display frame like display.cpp and compares the pixels with the bitmaps in test/golden/.
+//
+// after an intended change of the rendering, check the differences and update the bitmaps:
+//   cd test && UPDATE_GOLDEN=1 build/test_sparkline
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sparkline.h"
+#include "test.h"
+
+// the layout of display.cpp: 16x8 tiles of 8x8 pixels, the sparkline area is 6x5 tiles
+#define TILE_COLS 16
+#define TILE_ROWS 8
+#define SPARKLINE_COL 10
+#define SPARKLINE_ROW 2
+#define SPARKLINE_WIDTH ((TILE_COLS - SPARKLINE_COL) * 8)
+#define SPARKLINE_PAGES 5
+#define SPARKLINE_HEIGHT (SPARKLINE_PAGES * 8)
+
+#define GOLDEN_DIR "golden/"
+
+static uint8_t frame[TILE_ROWS][TILE_COLS][8];
+
+static bool get_pixel(int x, int y) {
+  return (frame[y / 8][x / 8][x % 8] >> (y % 8)) & 1;
+}
+
+// the sparkline area as text, one line per pixel row: '#' set, '.' clear
+static void area_to_text(char *text) {
+  for (int y = 0; y < SPARKLINE_HEIGHT; y++) {
+    for (int x = 0; x < SPARKLINE_WIDTH; x++)
+      *text++ = get_pixel(SPARKLINE_COL * 8 + x, SPARKLINE_ROW * 8 + y) ? '#' : '.';
+    *text++ = '\n';
+  }
+  *text = '\0';
+}
+
+// render into a frame filled with a pattern, the pixels outside the area must stay untouched
+static void render(const uint32_t *values, int count, char *text) {
+  memset(frame, 0x5A, sizeof(frame));
+  render_sparkline(values, count, frame[SPARKLINE_ROW][SPARKLINE_COL], SPARKLINE_WIDTH, SPARKLINE_PAGES,
+                   sizeof(frame[0]));
+  bool outside_ok = true;
+  for (int ty = 0; ty < TILE_ROWS; ty++)
+    for (int tx = 0; tx < TILE_COLS; tx++) {
+      bool inside = (ty >= SPARKLINE_ROW) && (ty < SPARKLINE_ROW + SPARKLINE_PAGES) && (tx >= SPARKLINE_COL);
+      for (int i = 0; i < 8; i++)
+        outside_ok = outside_ok && (inside || (frame[ty][tx][i] == 0x5A));
+    }
+  CHECK(outside_ok);
+  area_to_text(text);
+}
+
+static void compare_golden(const char *name, const char *text) {
+  char path[64];
+  snprintf(path, sizeof(path), GOLDEN_DIR "sparkline_%s.txt", name);
+  if (getenv("UPDATE_GOLDEN")) {
+    FILE *f = fopen(path, "w");
+    CHECK(f != NULL);
+    if (f) {
+      fputs(text, f);
+      fclose(f);
+      printf("    updated %s\n", path);
+    }
+    return;
+  }
+  static char golden[(SPARKLINE_WIDTH + 1) * SPARKLINE_HEIGHT + 1];
+  FILE *f = fopen(path, "r");
+  CHECK(f != NULL);
+  if (!f)
+    return;
+  size_t n = fread(golden, 1, sizeof(golden) - 1, f);
+  golden[n] = '\0';
+  fclose(f);
+  bool same = strcmp(text, golden) == 0;
+  CHECK(same);
+  if (!same)
+    printf("    %s differs, rendered:\n%s", path, text);
+}
+
+static void check_render(const char *name, const uint32_t *values, int count) {
+  static char text[(SPARKLINE_WIDTH + 1) * SPARKLINE_HEIGHT + 1];
+  render(values, count, text);
+  compare_golden(name, text);
+}
+
+static void test_empty(void) {
+  check_render("empty", NULL, 0);
+}
+
+static void test_flat(void) {
+  uint32_t values[SPARKLINE_WIDTH];
+  for (int i = 0; i < SPARKLINE_WIDTH; i++)
+    values[i] = 25;
+  check_render("flat", values, SPARKLINE_WIDTH);
+}
+
+static void test_single_spike(void) {
+  uint32_t values[SPARKLINE_WIDTH];
+  for (int i = 0; i < SPARKLINE_WIDTH; i++)
+    values[i] = 20;
+  values[30] = 400;
+  check_render("spike", values, SPARKLINE_WIDTH);
+}
+
+static void test_partial(void) {
+  // fewer values than pixels: right aligned, the newest value at the right edge
+  uint32_t values[12];
+  for (int i = 0; i < 12; i++)
+    values[i] = 10 + 5 * i;
+  check_render("partial", values, 12);
+}
+
+static void test_full_width(void) {
+  // more values than pixels: only the newest SPARKLINE_WIDTH are shown (and scaled)
+  uint32_t values[SPARKLINE_WIDTH + 12];
+  for (int i = 0; i < SPARKLINE_WIDTH + 12; i++)
+    values[i] = (i < 12) ? 100000 : 50 + 10 * abs((i % 24) - 12);
+  check_render("full_width", values, SPARKLINE_WIDTH + 12);
+}
+
+int main(void) {
+  RUN_TEST(test_empty);
+  RUN_TEST(test_flat);
+  RUN_TEST(test_single_spike);
+  RUN_TEST(test_partial);
+  RUN_TEST(test_full_width);
+  return test_result();
+}